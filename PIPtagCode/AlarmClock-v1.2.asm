@@ -136,8 +136,14 @@
 ;      for setting the alarm clock has already passed.  For example, if the CPU has
 ;      been awake 64 or more ACLK cycles, but less than 128 ACLK cycles, the argument
 ;      must be >=132+64, and so on.
+;   -- An interrupt handler can end the sleep early: set AlarmAbort to a
+;      nonzero value and clear the LPM3 bits.  SleepLPM3 returns at once, or at
+;      the next WDT interrupt if the CPU was not asleep yet, clears AlarmAbort
+;      and counts the next sleep from that moment.  The time slept is unknown
+;      to the alarm clock, the caller has to measure it if it needs it.
 			.global SleepLPM3				;entry point from C
 			.global AlrmClkStrt				;entry point from C
+			.global AlarmAbort				;set from C to end the sleep early
 			.cdecls C,LIST,  "msp430.h"
 ;------------------------------------------------------------------------------
             .text                           ; Flash Memory
@@ -187,6 +193,8 @@ SleepLPM3:	;  ---------  Subroutine to set the alarm clock ---------
 			mov		Counter,R14				;get the value of Counter
 			mov		#1,Counter				;and ask to be woken up at next interrupt
             bis		#LPM3+GIE,SR            ;enter LPM3 sleep, enable interrupts
+			tst		AlarmAbort				;did an interrupt end the sleep?
+			jnz		AlarmStop				;if so, return now
             ;we were just woken up by a WDT interrupt.
 			;here we calculate how many ACLK cycles we need to wait, after the next
 			;interrupt, before we return to the calling program.  Then we implement
@@ -241,19 +249,27 @@ SleepLPM3:	;  ---------  Subroutine to set the alarm clock ---------
 			;now we implement the counting sequences specified by the various pieces
 			jz		No8192					;if =0, we won't need to do /8192
 			bis		#LPM3+GIE,SR            ;but if we do, wait for the end of /64
+			tst		AlarmAbort				;did an interrupt end the sleep?
+			jnz		AlarmStop				;if so, return now
 			mov		#WDT_ADLY_250,&WDTCTL	;reset and start WDT with ratio=8192
 			mov 	R12,Counter				;do the prescribed number of /8192
 No8192		tst		R14						;will we need to do /512
 			jz		No512					;if =0, we won't need to do /512
 			bis		#LPM3+GIE,SR            ;but if we do, wait to end this counting
+			tst		AlarmAbort				;did an interrupt end the sleep?
+			jnz		AlarmStop				;if so, return now
 			mov		#WDT_ADLY_16,&WDTCTL	;reset and start WDT with ratio=512
 			mov 	R14,Counter				;do the prescribed number of /512
 No512		tst		R13						;will we need to do /32768
 			jz		No32768					;if =0, we won't need to do /32768
 			bis		#LPM3+GIE,SR            ;but if we do, wait to end this counting
+			tst		AlarmAbort				;did an interrupt end the sleep?
+			jnz		AlarmStop				;if so, return now
 			mov		#WDT_ADLY_1000,&WDTCTL	;reset and start WDT with ratio=32768
 			mov 	R13,Counter				;do the prescribed number of /32768
 No32768		bis		#LPM3+GIE,SR            ;wait till the end of WDT counting
+			tst		AlarmAbort				;did an interrupt end the sleep?
+			jnz		AlarmStop				;if so, return now
 			mov		#WDTPW+WDTHOLD,&WDTCTL	;Stop WDT
 			bis		#MC_2,&TACTL			;start Timer-A, contmode
 			bis		#LPM3+GIE,SR            ;go to sleep, wait for Timer-A interrupt
@@ -266,6 +282,14 @@ No32768		bis		#LPM3+GIE,SR            ;wait till the end of WDT counting
 			;and the interrupt handler will keep decrementing it, which will tell us
 			;how much time has elapsed when this program is called next time.
 			ret								;go back to the calling program
+AlarmStop	;  ---------  An interrupt handler set AlarmAbort ---------
+			;stop counting and leave the WDT running with /64 as at the final
+			;wake-up, so that the next call counts from now
+			bic		#MC_3,&TACTL			;stop Timer-A if it was counting
+			mov		#WDT_ADLY_1_9,&WDTCTL	;reset and start the WDT with ratio=64
+			clr		Counter					;count how long the CPU is awake
+			clr		AlarmAbort				;the early return is done
+			ret
 ;---------------------------------------------------------------------------			
 WDT_ISR:	;  ---------  Interrupt handler for Watchdog Timer ---------
 ;  This handler simply counts how many interrupts have occured and, at the end
@@ -286,6 +310,7 @@ TA0_ISR:	;  ---------  Interrupt handler for TimerA ---------
 ;			RAM variables
             .data                          
  			.bss	Counter,2,2             ;For counting interrupts
+ 			.bss	AlarmAbort,2,2          ;Nonzero to end the sleep early
 ;------------------------------------------------------------------------------
 ;           Interrupt Vectors
             .sect   WDT_VECTOR				;WDT Vector
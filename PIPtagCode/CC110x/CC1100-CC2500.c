@@ -15,6 +15,7 @@
 #include "CC1100-CC2500.h"
 #include "TI_CC_spi.h"
 #include "TI_CC_CC1100-CC2500.h"
+#include "radio_config.h"
 
 
 //------------------------------------------------------------------------------
@@ -33,10 +34,10 @@
 // Crystal accuracy = 40 ppm
 // X-tal frequency = 26 MHz
 // RF output power = 0 dBm
-// RX filterbandwidth = 540.000000 kHz
+// RX filterbandwidth = 540.000000 kHz (812.5 kHz at 500 kbps)
 // Deviation = 0.000000
 // Return state:  Return to RX state upon leaving either TX or RX
-// Datarate = 250.000000 kbps
+// Datarate = 250.000000 kbps, or 500 kbps with RADIO_PROFILE_500K
 // Modulation = (7) MSK
 // Manchester enable = (0) Manchester disabled
 // RF Frequency = 915.000000 MHz
@@ -49,7 +50,7 @@
 // Forward Error Correction = (0) FEC disabled
 // Length configuration = (1) Variable length packets, packet length configured by the first received byte after sync word.
 // Packetlength = 255
-// Preamble count = (2)  4 bytes
+// Preamble count = (RADIO_NUM_PREAMBLE) 4 bytes by default
 // Append status = 1
 // Address check = (0) No address check
 // FIFO autoflush = 0
@@ -59,32 +60,32 @@
 void writeRFSettings(void)
 {
     // Write register settings
-    TI_CC_SPIWriteReg(TI_CCxxx0_FSCTRL1,  0x0B); // Freq synthesizer control.
+    TI_CC_SPIWriteReg(TI_CCxxx0_FSCTRL1,  RADIO_FSCTRL1); // Freq synthesizer control.
     TI_CC_SPIWriteReg(TI_CCxxx0_FSCTRL0,  0x00); // Freq synthesizer control.
     TI_CC_SPIWriteReg(TI_CCxxx0_FREQ2,    0x21); // Freq control word, high byte
     TI_CC_SPIWriteReg(TI_CCxxx0_FREQ1,    0x62); // Freq control word, mid byte.
     TI_CC_SPIWriteReg(TI_CCxxx0_FREQ0,    0xD6); // Freq control word, low byte.
-    TI_CC_SPIWriteReg(TI_CCxxx0_MDMCFG4,  0x2D); // Modem configuration.
-    TI_CC_SPIWriteReg(TI_CCxxx0_MDMCFG3,  0x3B); // Modem configuration.
-    TI_CC_SPIWriteReg(TI_CCxxx0_MDMCFG2,  0x73); // Modem configuration.
-    TI_CC_SPIWriteReg(TI_CCxxx0_MDMCFG1,  0x22); // Modem configuration.
-    											 // CHANSPC_E=4
-    											 // Number of preamble bytes=4
+    TI_CC_SPIWriteReg(TI_CCxxx0_MDMCFG4,  RADIO_MDMCFG4); // Modem configuration.
+    TI_CC_SPIWriteReg(TI_CCxxx0_MDMCFG3,  RADIO_MDMCFG3); // Modem configuration.
+    TI_CC_SPIWriteReg(TI_CCxxx0_MDMCFG2,  RADIO_MDMCFG2); // Modem configuration.
+    TI_CC_SPIWriteReg(TI_CCxxx0_MDMCFG1,  RADIO_MDMCFG1); // Modem configuration.
+    											 // CHANSPC_E=2
+    											 // Number of preamble bytes from RADIO_NUM_PREAMBLE
     											 // FEC Disabled
-    TI_CC_SPIWriteReg(TI_CCxxx0_MDMCFG0,  0xF8); // Modem configuration.
-    TI_CC_SPIWriteReg(TI_CCxxx0_CHANNR,   0x00); // Channel number.
-    TI_CC_SPIWriteReg(TI_CCxxx0_DEVIATN,  0x00); // Modem dev (when FSK mod en)
-    TI_CC_SPIWriteReg(TI_CCxxx0_FREND1,   0xB6); // Front end RX configuration.
-    TI_CC_SPIWriteReg(TI_CCxxx0_FREND0,   0x10); // Front end RX configuration.
+    TI_CC_SPIWriteReg(TI_CCxxx0_MDMCFG0,  RADIO_MDMCFG0); // Modem configuration.
+    TI_CC_SPIWriteReg(TI_CCxxx0_CHANNR,   getRadioChannel() * RADIO_CHANNEL_STEP); // Channel number.
+    TI_CC_SPIWriteReg(TI_CCxxx0_DEVIATN,  RADIO_DEVIATN); // Modem dev (when FSK mod en)
+    TI_CC_SPIWriteReg(TI_CCxxx0_FREND1,   RADIO_FREND1); // Front end RX configuration.
+    TI_CC_SPIWriteReg(TI_CCxxx0_FREND0,   RADIO_FREND0); // Front end RX configuration.
     TI_CC_SPIWriteReg(TI_CCxxx0_MCSM1 ,   0x00); //MainRadio Cntrl State Machine
     											 // Go into IDLE mode after TX
     TI_CC_SPIWriteReg(TI_CCxxx0_MCSM0 ,   0x08); //MainRadio Cntrl State Machine
     											 // Shortest timeout for XOSC stabilized voltage
-    TI_CC_SPIWriteReg(TI_CCxxx0_FOCCFG,   0x1D); // Freq Offset Compens. Config											 
-    TI_CC_SPIWriteReg(TI_CCxxx0_BSCFG,    0x1C); //  Bit synchronization config.
-    TI_CC_SPIWriteReg(TI_CCxxx0_AGCCTRL2, 0xC7); // AGC control.
-    TI_CC_SPIWriteReg(TI_CCxxx0_AGCCTRL1, 0x00); // AGC control.
-    TI_CC_SPIWriteReg(TI_CCxxx0_AGCCTRL0, 0xB2); // AGC control.
+    TI_CC_SPIWriteReg(TI_CCxxx0_FOCCFG,   RADIO_FOCCFG); // Freq Offset Compens. Config											 
+    TI_CC_SPIWriteReg(TI_CCxxx0_BSCFG,    RADIO_BSCFG); //  Bit synchronization config.
+    TI_CC_SPIWriteReg(TI_CCxxx0_AGCCTRL2, RADIO_AGCCTRL2); // AGC control.
+    TI_CC_SPIWriteReg(TI_CCxxx0_AGCCTRL1, RADIO_AGCCTRL1); // AGC control.
+    TI_CC_SPIWriteReg(TI_CCxxx0_AGCCTRL0, RADIO_AGCCTRL0); // AGC control.
     TI_CC_SPIWriteReg(TI_CCxxx0_FSCAL3,   0xEA); // Frequency synthesizer cal.
     TI_CC_SPIWriteReg(TI_CCxxx0_FSCAL2,   0x0A); // Frequency synthesizer cal.
     TI_CC_SPIWriteReg(TI_CCxxx0_FSCAL1,   0x00); // Frequency synthesizer cal.
@@ -99,7 +100,7 @@ void writeRFSettings(void)
     TI_CC_SPIWriteReg(TI_CCxxx0_IOCFG0,   0x0A); // GDO0 output pin config.
     
     TI_CC_SPIWriteReg(TI_CCxxx0_PKTCTRL1, 0x04); // Packet automation control. Unknown settings value, set by TI.
-#if PROTOCOL_VERSION == 2
+#if PROTOCOL_VERSION >= 2
     TI_CC_SPIWriteReg(TI_CCxxx0_PKTCTRL0, TI_CCxxx0_PKT_LEN_VAR|TI_CCxxx0_PKT_CRC_EN|TI_CCxxx0_PKT_DAT_WHT); // Data whitening, CRC enabled, variable-length packets
 #else // version 1
     TI_CC_SPIWriteReg(TI_CCxxx0_PKTCTRL0, TI_CCxxx0_PKT_LEN_VAR|TI_CCxxx0_PKT_DAT_WHT); // Data whitening,variable-length packets
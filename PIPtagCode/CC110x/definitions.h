@@ -6,6 +6,7 @@ enum {false = 0, true = 1};
 
 typedef unsigned char uint8_t;
 typedef unsigned short uint16_t;
+typedef short int16_t;
 typedef unsigned long uint32_t;
 typedef char sint8_t;
 
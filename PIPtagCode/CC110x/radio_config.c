@@ -0,0 +1,74 @@
+/*******************************************************************************************************
+ *  Register configuration of the CC1101 for the tag, written in bursts.                              *
+ ******************************************************************************************************/
+#include "radio_config.h"
+
+uint8_t radioLostRegs[RADIO_LOST_SIZE] = {
+	0x59, // FSTEST Frequency synthesizer cal.  Needs to be set.  Undocumented--see SWRA359A
+	0x7F, // PTEST reset value.
+	0x3F, // AGCTEST reset value.
+	0x88, // TEST2 Various test settings.
+	0x31, // TEST1 Various test settings.
+	0x0B  // TEST0 Various test settings.
+};
+
+//Registers IOCFG2 to FSCTRL0, up to the FREQ registers
+static uint8_t radioConfigLow[] = {
+	0x29, // IOCFG2 reset value.
+	0x2E, // IOCFG1 reset value.
+	0x2E, // IOCFG0 GDO0 output pin to high impedance 3-state
+	0x07, // FIFOTHR reset value.
+	0xD3, // SYNC1 reset value.
+	0x91, // SYNC0 reset value.
+	0x03, // PKTLEN Packet length.	Not relevant if PKTCTRL0 set for variable length (01)
+	0x04, // PKTCTRL1 Packet automation control.
+#if PROTOCOL_VERSION >= 2
+	TI_CCxxx0_PKT_LEN_VAR | TI_CCxxx0_PKT_CRC_EN | TI_CCxxx0_PKT_DAT_WHT, // PKTCTRL0 Data whitening, CRC enabled, variable-length packets
+#else // version 1
+	TI_CCxxx0_PKT_LEN_VAR | TI_CCxxx0_PKT_DAT_WHT, // PKTCTRL0 Data whitening,variable-length packets
+#endif
+	0x00, // ADDR Device address.
+	0x00, // CHANNR Channel number.  Set by setRadioChannel().
+	RADIO_FSCTRL1, // FSCTRL1 Freq synthesizer control.
+	0x00  // FSCTRL0 Freq synthesizer control.
+};
+
+//Registers MDMCFG4 to FREND0, between the FREQ and FSCAL registers
+static const uint8_t radioConfigHigh[] = {
+	RADIO_MDMCFG4, // MDMCFG4 Modem configuration.  Receive bandwidth and DRATE_E.
+	RADIO_MDMCFG3, // MDMCFG3 Modem configuration.  DRATE_M = 59.
+	RADIO_MDMCFG2, // MDMCFG2 Modem configuration.  30/32 Sync word bits detected. No Manchester. MSK.
+	RADIO_MDMCFG1, // MDMCFG1 Modem configuration.  Number of preamble bytes.  CHANSPC_E=2.  FEC Disabled
+	RADIO_MDMCFG0, // MDMCFG0 Modem configuration.  CHANSPC_M=248.
+	RADIO_DEVIATN, // DEVIATN For MSK, fraction of period for phase change.
+	0x07, // MCSM2 reset value.
+	RADIO_MCSM1, // MCSM1 Go into IDLE mode after TX.
+	0x08, // MCSM0 Manual calibration. Shortest timeout for XOSC stabilized voltage before CHP_RDY_N goes low.
+	RADIO_FOCCFG, // FOCCFG Freq Offset Compens. Config
+	RADIO_BSCFG, // BSCFG Bit synchronization config.
+	RADIO_AGCCTRL2, // AGCCTRL2 AGC control.
+	RADIO_AGCCTRL1, // AGCCTRL1 AGC control.
+	RADIO_AGCCTRL0, // AGCCTRL0 AGC control.
+	0x87, // WOREVT1 reset value.
+	0x6B, // WOREVT0 reset value.
+	0xF8, // WORCTRL reset value.
+	RADIO_FREND1, // FREND1 Front end RX configuration.
+	RADIO_FREND0  // FREND0 Front end TX configuration. Set current in TX LO buffer.  Use PATABLE index zero.
+};
+
+void writeRadioConfig(void) {
+	TI_CC_SPIWriteBurstReg(TI_CCxxx0_IOCFG2, (char*) radioConfigLow, sizeof(radioConfigLow));
+	TI_CC_SPIWriteBurstReg(TI_CCxxx0_MDMCFG4, (char*) radioConfigHigh, sizeof(radioConfigHigh));
+}
+
+void setRadioChannel(uint8_t channel) {
+	radioConfigLow[TI_CCxxx0_CHANNR - TI_CCxxx0_IOCFG2] = channel * RADIO_CHANNEL_STEP;
+}
+
+uint8_t getRadioChannel(void) {
+	return radioConfigLow[TI_CCxxx0_CHANNR - TI_CCxxx0_IOCFG2] / RADIO_CHANNEL_STEP;
+}
+
+void restoreRadioConfig(void) {
+	TI_CC_SPIWriteBurstReg(RADIO_LOST_FIRST, (char*) radioLostRegs, RADIO_LOST_SIZE);
+}
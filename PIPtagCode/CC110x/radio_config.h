@@ -0,0 +1,79 @@
+/*******************************************************************************************************
+ *  Register configuration of the CC1101 for the tag, written in bursts.                              *
+ *                                                                                                     *
+ *  In SLEEP the CC1101 keeps its configuration registers except FSTEST, PTEST, AGCTEST and TEST2-0    *
+ *  (0x29-0x2E) and the PATABLE entries after the first. Only those are written after every wake-up,   *
+ *  the retained registers are written with every recalibration to undo any upset. The FREQ and FSCAL  *
+ *  registers are left to tuning.c.                                                                    *
+ ******************************************************************************************************/
+#ifndef _RADIO_CONFIG_H
+#define _RADIO_CONFIG_H
+
+#include "TI_CC_spi.h"
+#include "TI_CC_CC1100-CC2500.h"
+#include "definitions.h"
+// Configurable settings for the tag
+#include "../settings.h"
+
+/*
+ * Modem profile selected with RADIO_PROFILE in settings.h. A reader has to be
+ * set up with the same MDMCFG4-0, DEVIATN, FOCCFG, BSCFG, AGCCTRL and FREND
+ * values to hear the tags. Both are MSK without Manchester coding, 30/32 sync
+ * word bits detected and a channel spacing (CHANSPC_E=2, CHANSPC_M=248) of
+ * 199.95 kHz. RADIO_CHANNEL_STEP is the number of those channels between the
+ * channels of the channel plan, wide enough for the receive bandwidth.
+ */
+#if RADIO_PROFILE == RADIO_PROFILE_500K
+// 500 kbps, 812 kHz receive bandwidth
+#define RADIO_FSCTRL1 0x0E		// IF 355 kHz
+#define RADIO_MDMCFG4 0x0E		// CHANBW_E=0, CHANBW_M=0, DRATE_E=14
+#define RADIO_AGCCTRL0 0xB0
+#define RADIO_CHANNEL_STEP 8	// 1.6 MHz
+#else
+// 250 kbps, 541 kHz receive bandwidth
+#define RADIO_FSCTRL1 0x0B		// IF 279 kHz
+#define RADIO_MDMCFG4 0x2D		// CHANBW_E=0, CHANBW_M=2, DRATE_E=13
+#define RADIO_AGCCTRL0 0xB2
+#define RADIO_CHANNEL_STEP 4	// 800 kHz
+#endif
+//The top channel of the plan and half a channel step above it stay in the band
+#if DEFAULT_FREQ + (2 * NUM_CHANNELS - 1) * RADIO_CHANNEL_STEP * 199951L / 2 > 928000000
+#error "NUM_CHANNELS channels above DEFAULT_FREQ go past 928 MHz"
+#endif
+#define RADIO_MDMCFG3 0x3B		// DRATE_M=59
+#define RADIO_MDMCFG2 0x73		// MSK, no Manchester, 30/32 sync word bits
+#define RADIO_MDMCFG1 ((RADIO_NUM_PREAMBLE << 4) | 0x02)	// FEC off, CHANSPC_E=2
+#define RADIO_MDMCFG0 0xF8		// CHANSPC_M=248
+#define RADIO_DEVIATN 0x00		// For MSK, fraction of period for phase change
+#define RADIO_FOCCFG 0x1D
+#define RADIO_BSCFG 0x1C
+#define RADIO_AGCCTRL2 0xC7
+#define RADIO_AGCCTRL1 0x00
+#define RADIO_FREND1 0xB6
+#define RADIO_FREND0 0x10		// PATABLE index zero
+#define RADIO_MCSM1 0x00		// IDLE after TX and RX
+
+//Registers from here to TEST0 are lost in SLEEP
+#define RADIO_LOST_FIRST TI_CCxxx0_FSTEST
+#define RADIO_LOST_SIZE (TI_CCxxx0_TEST0 - TI_CCxxx0_FSTEST + 1)
+
+//Shadow of the registers lost in SLEEP, FSTEST to TEST0. The TEST values are
+//the ones read after the last calibration.
+extern uint8_t radioLostRegs[RADIO_LOST_SIZE];
+#define RADIO_TEST2 (TI_CCxxx0_TEST2 - RADIO_LOST_FIRST)
+#define RADIO_TEST1 (TI_CCxxx0_TEST1 - RADIO_LOST_FIRST)
+#define RADIO_TEST0 (TI_CCxxx0_TEST0 - RADIO_LOST_FIRST)
+
+//Write the retained registers that the tag configures, except FREQ and FSCAL
+void writeRadioConfig(void);
+
+//Write the registers lost in SLEEP from their shadow
+void restoreRadioConfig(void);
+
+//Channel of the channel plan, written to CHANNR as channel * RADIO_CHANNEL_STEP
+//with the configuration. The synthesizer has to be calibrated again after it
+//changes.
+void setRadioChannel(uint8_t channel);
+uint8_t getRadioChannel(void);
+
+#endif
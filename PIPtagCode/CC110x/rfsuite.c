@@ -99,7 +99,8 @@ bool rfReceiveFixedTimeout(uint8_t *rxBuffer, uint8_t *status, uint8_t length, u
     TI_CC_SPIStrobe(TI_CCxxx0_SRX);
 
     // Wait for GDO0 to be set -> sync received
-    while (!(TI_CC_GDO0_PxIN&TI_CC_GDO0_PIN) && *cur_time - start_time <= wait);
+    while (!(TI_CC_GDO0_PxIN&TI_CC_GDO0_PIN) && *cur_time - start_time <= wait)
+        ;
 
     {
 	    unsigned long rx_start = *cur_time;
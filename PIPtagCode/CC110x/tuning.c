@@ -11,11 +11,7 @@ int highchange;
 unsigned int step; // How much we change the frequency by each step.
 unsigned long cur_freq = 0;
 
-/* Copying the following register values from CC1150 */
-uint8_t CC1150RegTEST0 = 0;
-uint8_t CC1150RegTEST1 = 0;
-uint8_t CC1150RegTEST2 = 0;
-
+/* Copying the following register values from CC1150, TEST0-2 go to radioLostRegs */
 uint8_t CC1150RegFSCAL0 = 0;
 uint8_t CC1150RegFSCAL1 = 0;
 uint8_t CC1150RegFSCAL2 = 0;
@@ -23,6 +19,30 @@ uint8_t CC1150RegFSCAL3 = 0;
 
 sint8_t paTable[PA_TBL_SIZE];
 
+#if FSCAL_CACHE_SIZE
+//Bucket of an unused cache entry
+#define FSCAL_NO_BUCKET 0xFF
+
+//Calibration registers stored at one temperature
+typedef struct {
+	uint8_t bucket;
+	uint8_t test0;
+	uint8_t test1;
+	uint8_t test2;
+	uint8_t fscal0;
+	uint8_t fscal1;
+	uint8_t fscal2;
+	uint8_t fscal3;
+	//Time of the calibration in ms
+	uint32_t time;
+} FscalCacheEntry;
+
+FscalCacheEntry fscalCache[FSCAL_CACHE_SIZE];
+//Frequency and channel the cached calibrations are for
+unsigned long fscalCacheFreq = 0;
+uint8_t fscalCacheChannel = 0;
+#endif
+
 //Return the current frequency value.
 unsigned long curFreq() {
 	return cur_freq;
@@ -88,54 +108,11 @@ void Wake_up_CC1101() {
 	return;
 }
 
-void ReWriteCC1101Registers(void) {
-	/* write the default RF settings from CC1100-CC2500.c */
-	// Write register settings
-	TI_CC_SPIWriteReg(TI_CCxxx0_FSCTRL1, 0x0B); // Freq synthesizer control.
-	TI_CC_SPIWriteReg(TI_CCxxx0_FSCTRL0, 0x00); // Freq synthesizer control.
-	TI_CC_SPIWriteReg(TI_CCxxx0_MDMCFG4, 0x2D); // Modem configuration.  DRATE_E = 45.  Calculate symbol rate.
-	TI_CC_SPIWriteReg(TI_CCxxx0_MDMCFG3, 0x3B); // Modem configuration.  DRATE_M = 59.  Calculate symbol rate.
-	TI_CC_SPIWriteReg(TI_CCxxx0_MDMCFG2, 0x73); // Modem configuration.  30/32 Sync word bits detected. No Manchester. MSK.
-	TI_CC_SPIWriteReg(TI_CCxxx0_MDMCFG1, 0x22); // Modem configuration.  CHANSPC_E=4.  Number of preamble bytes=4.  FEC Disabled
-	TI_CC_SPIWriteReg(TI_CCxxx0_MDMCFG0, 0xF8); // Modem configuration.  CHANSPC_M=248.
-	TI_CC_SPIWriteReg(TI_CCxxx0_CHANNR, 0x00); // Channel number.
-	TI_CC_SPIWriteReg(TI_CCxxx0_DEVIATN, 0x00); // For MSK, fraction of period for phase change.
-	TI_CC_SPIWriteReg(TI_CCxxx0_FREND1, 0xB6); // Front end RX configuration.
-	TI_CC_SPIWriteReg(TI_CCxxx0_FREND0, 0x10); // Front end TX configuration. Set current in TX LO buffer.  Use PATABLE index zero.
-	TI_CC_SPIWriteReg(TI_CCxxx0_MCSM1, 0x00); // Go into IDLE mode after TX.
-	TI_CC_SPIWriteReg(TI_CCxxx0_MCSM0, 0x08); // Manual calibration. Shortest timeout for XOSC stabilized voltage before CHP_RDY_N goes low.
-	TI_CC_SPIWriteReg(TI_CCxxx0_FOCCFG, 0x1D); // Freq Offset Compens. Config
-	TI_CC_SPIWriteReg(TI_CCxxx0_BSCFG, 0x1C); //  Bit synchronization config.
-	TI_CC_SPIWriteReg(TI_CCxxx0_AGCCTRL2, 0xC7); // AGC control.
-	TI_CC_SPIWriteReg(TI_CCxxx0_AGCCTRL1, 0x00); // AGC control.
-	TI_CC_SPIWriteReg(TI_CCxxx0_AGCCTRL0, 0xB2); // AGC control.
-	TI_CC_SPIWriteReg(TI_CCxxx0_FSTEST, 0x59); // Frequency synthesizer cal.  Needs to be set.  Undocumented--see SWRA359A
-
-	//TI_CC_SPIWriteReg(TI_CCxxx0_IOCFG2,   0x0B); // GDO2 output pin config. Serial clock
-	//TI_CC_SPIWriteReg(TI_CCxxx0_IOCFG0,   0x06); // GDO0 output pin config. Assert when sync sent/received
-	/* Using ATEST to check PLL Status */
-	//TI_CC_SPIWriteReg(TI_CCxxx0_IOCFG0,   0x0A); // GDO0 output pin config. Lock detector output
-	TI_CC_SPIWriteReg(TI_CCxxx0_IOCFG0, 0x2E); // GDO0 output pin to high impedance 3-state
-
-	//TI_CC_SPIWriteReg(TI_CCxxx0_IOCFG0,   0x29); // GDO0 output pin to CHIP_RDYn
-
-	TI_CC_SPIWriteReg(TI_CCxxx0_PKTCTRL1, 0x04); // Packet automation control.
-#if PROTOCOL_VERSION == 2
-    TI_CC_SPIWriteReg(TI_CCxxx0_PKTCTRL0, TI_CCxxx0_PKT_LEN_VAR|TI_CCxxx0_PKT_CRC_EN|TI_CCxxx0_PKT_DAT_WHT); // Data whitening, CRC enabled, variable-length packets
-#else // version 1
-    TI_CC_SPIWriteReg(TI_CCxxx0_PKTCTRL0, TI_CCxxx0_PKT_LEN_VAR|TI_CCxxx0_PKT_DAT_WHT); // Data whitening,variable-length packets
-#endif
-	TI_CC_SPIWriteReg(TI_CCxxx0_ADDR, 0x00); // Device address.
-	TI_CC_SPIWriteReg(TI_CCxxx0_PKTLEN, 0x03); // Packet length.	Not relevant if PKTCTRL0 set for variable length (01)
-
-	return;
-}
-
 void storeCC11xxRegs() {
 
-	CC1150RegTEST0 = TI_CC_SPIReadReg(TI_CCxxx0_TEST0);
-	CC1150RegTEST1 = TI_CC_SPIReadReg(TI_CCxxx0_TEST1);
-	CC1150RegTEST2 = TI_CC_SPIReadReg(TI_CCxxx0_TEST2);
+	radioLostRegs[RADIO_TEST0] = TI_CC_SPIReadReg(TI_CCxxx0_TEST0);
+	radioLostRegs[RADIO_TEST1] = TI_CC_SPIReadReg(TI_CCxxx0_TEST1);
+	radioLostRegs[RADIO_TEST2] = TI_CC_SPIReadReg(TI_CCxxx0_TEST2);
 	CC1150RegFSCAL0 = TI_CC_SPIReadReg(TI_CCxxx0_FSCAL0);
 	CC1150RegFSCAL1 = TI_CC_SPIReadReg(TI_CCxxx0_FSCAL1);
 	CC1150RegFSCAL2 = TI_CC_SPIReadReg(TI_CCxxx0_FSCAL2);
@@ -143,18 +120,19 @@ void storeCC11xxRegs() {
 }
 
 void restoreCC11xxRegs() {
-	TI_CC_SPIWriteReg(TI_CCxxx0_TEST0, CC1150RegTEST0);
-	TI_CC_SPIWriteReg(TI_CCxxx0_TEST1, CC1150RegTEST1);
-	TI_CC_SPIWriteReg(TI_CCxxx0_TEST2, CC1150RegTEST2);
-
-	TI_CC_SPIWriteReg(TI_CCxxx0_FSCAL0, CC1150RegFSCAL0);
-	TI_CC_SPIWriteReg(TI_CCxxx0_FSCAL1, CC1150RegFSCAL1);
-	TI_CC_SPIWriteReg(TI_CCxxx0_FSCAL2, CC1150RegFSCAL2);
-	TI_CC_SPIWriteReg(TI_CCxxx0_FSCAL3, CC1150RegFSCAL3);
-
-	TI_CC_SPIWriteReg(TI_CCxxx0_FREQ0, cur_freq % 0x100); //lowest byte of FREQ[]
-	TI_CC_SPIWriteReg(TI_CCxxx0_FREQ1, (cur_freq / 0x100) % 0x100); //middle byte of FREQ[]
-	TI_CC_SPIWriteReg(TI_CCxxx0_FREQ2, (cur_freq / 0x10000) % 0x40); //upper byte of FREQ[]
+	char regs[4];
+	restoreRadioConfig();
+
+	regs[0] = CC1150RegFSCAL3;
+	regs[1] = CC1150RegFSCAL2;
+	regs[2] = CC1150RegFSCAL1;
+	regs[3] = CC1150RegFSCAL0;
+	TI_CC_SPIWriteBurstReg(TI_CCxxx0_FSCAL3, regs, 4);
+
+	regs[0] = (cur_freq / 0x10000) % 0x40; //upper byte of FREQ[]
+	regs[1] = (cur_freq / 0x100) % 0x100; //middle byte of FREQ[]
+	regs[2] = cur_freq % 0x100; //lowest byte of FREQ[]
+	TI_CC_SPIWriteBurstReg(TI_CCxxx0_FREQ2, regs, 3);
 }
 
 void recalibrateCC11xx(unsigned long desired) {
@@ -170,6 +148,56 @@ void recalibrateCC11xx(unsigned long desired) {
 	storeCC11xxRegs();
 }
 
+bool recalibrateCC11xxCached(unsigned long desired, uint8_t bucket, uint32_t now, bool force) {
+#if FSCAL_CACHE_SIZE
+	uint8_t i;
+	if (desired != fscalCacheFreq || getRadioChannel() != fscalCacheChannel) {
+		fscalCacheFreq = desired;
+		fscalCacheChannel = getRadioChannel();
+		for (i = 0; i < FSCAL_CACHE_SIZE; ++i) {
+			fscalCache[i].bucket = FSCAL_NO_BUCKET;
+		}
+	}
+	//Find the bucket, or else the entry to replace: an unused or the oldest one
+	FscalCacheEntry* entry = fscalCache;
+	for (i = 0; i < FSCAL_CACHE_SIZE; ++i) {
+		if (bucket == fscalCache[i].bucket) {
+			entry = fscalCache + i;
+			break;
+		}
+		if (FSCAL_NO_BUCKET == fscalCache[i].bucket
+				|| (FSCAL_NO_BUCKET != entry->bucket && now - fscalCache[i].time > now - entry->time)) {
+			entry = fscalCache + i;
+		}
+	}
+	if (!force && bucket == entry->bucket && now - entry->time < FSCAL_CACHE_MAX_AGE) {
+		cur_freq = (desired / 396.7);
+		radioLostRegs[RADIO_TEST0] = entry->test0;
+		radioLostRegs[RADIO_TEST1] = entry->test1;
+		radioLostRegs[RADIO_TEST2] = entry->test2;
+		CC1150RegFSCAL0 = entry->fscal0;
+		CC1150RegFSCAL1 = entry->fscal1;
+		CC1150RegFSCAL2 = entry->fscal2;
+		CC1150RegFSCAL3 = entry->fscal3;
+		restoreCC11xxRegs();
+		return false;
+	}
+	recalibrateCC11xx(desired);
+	entry->bucket = bucket;
+	entry->time = now;
+	entry->test0 = radioLostRegs[RADIO_TEST0];
+	entry->test1 = radioLostRegs[RADIO_TEST1];
+	entry->test2 = radioLostRegs[RADIO_TEST2];
+	entry->fscal0 = CC1150RegFSCAL0;
+	entry->fscal1 = CC1150RegFSCAL1;
+	entry->fscal2 = CC1150RegFSCAL2;
+	entry->fscal3 = CC1150RegFSCAL3;
+#else
+	recalibrateCC11xx(desired);
+#endif
+	return true;
+}
+
 void setupAndPowerDownCC11xx() {
 	paTable[0] = DEFAULT_PATABLE;
 
@@ -16,6 +16,8 @@
 #include "TI_CC_hardware_board_2553.h"
 //Definitions for interface between CC1101 and MSP430
 #include "CC1100-CC2500.h"
+//Register configuration written in bursts
+#include "radio_config.h"
 // Configurable settings for the tag
 #include "../settings.h"
 // The amount we've raised or lowered the frequency during tuning.
@@ -39,10 +41,14 @@ void recal(unsigned long change);
 
 void Wake_up_CC1101();
 
-void ReWriteCC1101Registers(void);
-
 void recalibrateCC11xx(unsigned long desired);
 
+//Calibrate for the desired frequency, or restore the calibration cached for
+//the temperature bucket if it is fresh and for the same channel. With force set the radio is always
+//calibrated and the cache refreshed. now is in milliseconds.
+//Returns true if the radio was calibrated.
+bool recalibrateCC11xxCached(unsigned long desired, uint8_t bucket, uint32_t now, bool force);
+
 void restoreCC11xxRegs();
 
 void storeCC11xxRegs();
@@ -0,0 +1,53 @@
+#include "batch.h"
+#include "scheduler.h"
+
+uint8_t batchFrame[BATCH_MAX_SIZE];
+
+//Number of samples in the batch
+uint8_t batchCount = 0;
+//Scheduler time of each sample
+uint32_t batchTimes[BATCH_SIZE];
+//Sensed fields of each sample, the same for the whole batch
+uint8_t sampleSize;
+
+//Offset of a sample's age byte in batchFrame
+#define SAMPLE(i) (BATCH_SAMPLES + (i) * (1 + sampleSize))
+
+void batchAdd(uint8_t header) {
+	if (BATCH_SIZE <= batchCount) {
+		return;
+	}
+	if (0 == batchCount) {
+		sampleSize = copyFields(batchFrame + BATCH_SAMPLES + 1, header);
+	} else {
+		copyFields(batchFrame + SAMPLE(batchCount) + 1, header);
+	}
+	batchTimes[batchCount] = getSchedulerTime();
+	++batchCount;
+}
+
+bool batchFull() {
+	return BATCH_SIZE <= batchCount;
+}
+
+uint8_t finishBatch(uint8_t frameSize) {
+	uint32_t now = getSchedulerTime();
+	uint8_t i = 0;
+	//Length, ID and headers
+	for (; i < FRAME_TEMP7; ++i) {
+		batchFrame[i] = txFrame[i];
+	}
+	batchFrame[BATCH_COUNT] = batchCount;
+	for (i = 0; i < batchCount; ++i) {
+		uint32_t age = (now - batchTimes[i]) >> BATCH_AGE_SHIFT;
+		batchFrame[SAMPLE(i)] = age < 0xFF ? age : 0xFF;
+	}
+	//History and battery
+	uint8_t size = SAMPLE(batchCount);
+	for (i = FRAME_HISTORY; i < frameSize; ++i) {
+		batchFrame[size++] = txFrame[i];
+	}
+	batchFrame[FRAME_LENGTH] = size - 1;
+	batchCount = 0;
+	return size;
+}
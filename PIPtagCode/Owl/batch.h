@@ -0,0 +1,59 @@
+#ifndef TPIP_BATCH_H_
+#define TPIP_BATCH_H_
+
+/*******************************************************************************
+ * Batches of samples for tags that can wait for their data. The sensed fields
+ * of txFrame (see frame.h) are one sample. A batch keeps up to BATCH_SIZE of
+ * them and sends them in one packet, each with its age.
+ * A batch packet is the length, ID, DataHeader and ExtHeader of txFrame, then
+ * the number of samples, then the samples from oldest to newest, each an age
+ * byte followed by the sensed fields flagged in the DataHeader, and finally any history and battery
+ * fields of txFrame.
+ * TLDR:
+ * 1. Call 'batchAdd()' once the fields of a sample are in txFrame.
+ * 2. Transmit when 'batchFull()' or the sample cannot wait.
+ * 3. Finish txFrame, then send 'finishBatch(size)' bytes from batchFrame.
+ ******************************************************************************/
+
+#include "../CC110x/definitions.h"
+#include "../settings.h"
+#include "frame.h"
+
+//Ages are in units of 2^BATCH_AGE_SHIFT ms, about a second, up to 255 units
+#define BATCH_AGE_SHIFT 10
+
+//Sensed fields of one sample, at most
+#define BATCH_SAMPLE_SIZE (FRAME_HISTORY - FRAME_TEMP7)
+#define BATCH_COUNT FRAME_TEMP7
+#define BATCH_SAMPLES (BATCH_COUNT + 1)
+#define BATCH_MAX_SIZE (BATCH_SAMPLES + BATCH_SIZE * (1 + BATCH_SAMPLE_SIZE) \
+		+ FRAME_MAX_SIZE - FRAME_HISTORY)
+
+//The radio takes 61 bytes after the length byte
+#if 1 < BATCH_SIZE && 62 < BATCH_MAX_SIZE
+#error "BATCH_SIZE samples do not fit in one packet"
+#endif
+#if 1 < BATCH_SIZE && ENABLE_REPORT_ON_CHANGE
+#error "Batches and report by exception cannot be used together"
+#endif
+
+extern uint8_t batchFrame[BATCH_MAX_SIZE];
+
+/*
+ * Add the sensed fields of txFrame flagged in the header to the batch as a
+ * sample taken now. The header must not change until the batch is sent.
+ */
+void batchAdd(uint8_t header);
+
+/*
+ * Returns true if the batch holds BATCH_SIZE samples.
+ */
+bool batchFull(void);
+
+/*
+ * Build the batch packet in batchFrame around the finished txFrame of the
+ * given size, empty the batch and return the number of bytes to send.
+ */
+uint8_t finishBatch(uint8_t frameSize);
+
+#endif /* TPIP_BATCH_H_ */
@@ -0,0 +1,60 @@
+#include "downlink.h"
+#include "scheduler.h"
+#include "../CC110x/rfsuite.h"
+
+//Transmissions since the last receive window
+static uint8_t transmissions = 0;
+
+bool downlinkDue() {
+	if (++transmissions < DOWNLINK_EVERY) {
+		return false;
+	}
+	transmissions = 0;
+	return true;
+}
+
+void prepareDownlink() {
+	TI_CC_SPIWriteReg(TI_CCxxx0_MCSM1, DOWNLINK_MCSM1);
+}
+
+//True if the command is addressed to the tag or to every tag
+static bool addressed(const uint8_t* frame, unsigned long boardID) {
+	unsigned long id = ((unsigned long) frame[0] << 16)
+			+ ((uint16_t) frame[1] << 8) + frame[2];
+	return id == (boardID & 0xFFFFFFUL) || DOWNLINK_BROADCAST_ID == id;
+}
+
+bool receiveCommand(volatile TagParameters* params) {
+	uint8_t frame[DOWNLINK_MAX_BYTES];
+	uint8_t status[2];
+	bool changed = false;
+
+	//The radio is in TX or RX all along, LPM3 keeps the MCU out of the way
+	sleepMs(DOWNLINK_WINDOW_MS);
+
+	//A command still coming in is cut off, the reader sends it again
+	uint8_t received = TI_CC_SPIReadStatus(TI_CCxxx0_RXBYTES) & BYTES_IN_RXFIFO;
+	TI_CC_SPIStrobe(TI_CCxxx0_SIDLE);
+	if (received > 3) {
+		uint8_t length = TI_CC_SPIReadReg(TI_CCxxx0_RXFIFO);
+		//Length byte, ID, at least one key and the two status bytes
+		if (length > 3 && length <= DOWNLINK_MAX_BYTES && length + 3 <= received) {
+			TI_CC_SPIReadBurstReg(TI_CCxxx0_RXFIFO, (char*) frame, length);
+			TI_CC_SPIReadBurstReg(TI_CCxxx0_RXFIFO, (char*) status, 2);
+			if ((status[LQI] & CRC_OK) && addressed(frame, params->boardID)) {
+				//Parse into a copy so that a bad command changes nothing
+				TagParameters update = *params;
+				if (parseTagParameters(frame + 3, length - 3, &update)) {
+					*params = update;
+					changed = true;
+				}
+			}
+		}
+	}
+	TI_CC_SPIStrobe(TI_CCxxx0_SFRX);
+	TI_CC_SPIWriteReg(TI_CCxxx0_MCSM1, RADIO_MCSM1);
+
+	/*Power down CC1101 when Csn goes high*/
+	TI_CC_SPIStrobe(TI_CCxxx0_SPWD);
+	return changed;
+}
@@ -0,0 +1,50 @@
+#ifndef TPIP_DOWNLINK_H_
+#define TPIP_DOWNLINK_H_
+
+/*******************************************************************************
+ * Short receive window after a transmission, so that a reader can change the
+ * TagParameters of a tag that is already deployed. The radio turns around to
+ * RX by itself when the frame is out (TXOFF_MODE in MCSM1), so a reader that
+ * heard the frame can answer right away while the tag sleeps in LPM3.
+ *
+ * A command frame has the format of the tag's own frames: the length byte,
+ * the 24 bit ID of the tag it is for, or DOWNLINK_BROADCAST_ID for every tag
+ * that hears it, then the key-value pairs of the optical link (optical_conn.h).
+ * The radio CRC has to be good. A reader cannot know which transmissions a tag
+ * listens after, so it answers every frame of the tag until it sees the change.
+ * TLDR:
+ * 1. Before a transmission, 'downlinkDue()' says whether to listen after it.
+ * 2. If so, call 'prepareDownlink()' before STX and leave the radio on.
+ * 3. 'receiveCommand(&params)' waits out the window and powers the radio down.
+ *    If it returns true, the TagParameters changed.
+ ******************************************************************************/
+
+#include "../CC110x/definitions.h"
+#include "../settings.h"
+#include "../optical_conn.h"
+
+//Address of a command for every tag
+#define DOWNLINK_BROADCAST_ID 0xFFFFFFUL
+//Longest command frame, length byte not included: ID and every key
+#define DOWNLINK_MAX_BYTES (3 + 15)
+//MCSM1 while listening: RX after TX, IDLE after RX
+#define DOWNLINK_MCSM1 0x03
+
+/*
+ * Count a transmission, returns true for every DOWNLINK_EVERY-th one.
+ */
+bool downlinkDue(void);
+
+/*
+ * Have the radio turn to RX once the next frame is sent.
+ */
+void prepareDownlink(void);
+
+/*
+ * Listen until DOWNLINK_WINDOW_MS after the start of the transmission, then
+ * power the radio down. Returns true if a command for this tag changed the
+ * parameters. A command with an unknown key changes none of them.
+ */
+bool receiveCommand(volatile TagParameters* params);
+
+#endif /* TPIP_DOWNLINK_H_ */
@@ -0,0 +1,68 @@
+#include "frame.h"
+
+uint8_t txFrame[FRAME_MAX_SIZE];
+uint8_t plainFrame[FRAME_MAX_SIZE];
+
+//Offsets and sizes of the sensed fields, in the order of the DataHeader bits
+static const uint8_t fieldOffsets[] = { FRAME_TEMP7, FRAME_TEMP16, FRAME_LIGHT,
+		FRAME_HTU_TEMP, FRAME_MOISTURE };
+static const uint8_t fieldSizes[] = { 1, 2, 1, 4, 2 };
+
+void putFrame16(uint8_t offset, uint16_t value) {
+	txFrame[offset] = value >> 8;
+	txFrame[offset + 1] = value & 0xFF;
+}
+
+uint8_t finishFrame(uint8_t header, uint8_t extHeader) {
+	bool withHistory = 0 != (header & HEADER_HISTORY);
+	uint8_t size = withHistory ? FRAME_BATTERY(true) : FRAME_HISTORY;
+	if (header & HEADER_BATTERY) {
+		size = FRAME_BATTERY(withHistory) + FRAME_BATTERY_SIZE;
+	}
+	if (FRAME_TEMP7 == size) {
+		size = FRAME_HEADER;
+	}
+	if (FRAME_EXTENDED) {
+		header |= HEADER_EXTENDED;
+		txFrame[FRAME_EXT_HEADER] = extHeader;
+	}
+	txFrame[FRAME_HEADER] = header;
+	txFrame[FRAME_LENGTH] = size - 1;
+	return size;
+}
+
+uint8_t copyFields(uint8_t* dest, uint8_t header) {
+	header &= HEADER_SENSED;
+	uint8_t size = 0;
+	uint8_t field = 0;
+	for (; field < sizeof(fieldOffsets); ++field) {
+		if (header & (1 << field)) {
+			uint8_t i = 0;
+			for (; i < fieldSizes[field]; ++i) {
+				dest[size++] = txFrame[fieldOffsets[field] + i];
+			}
+		}
+	}
+	return size;
+}
+
+uint8_t compactFrame(uint8_t frameSize) {
+	uint8_t i = 0;
+	//Length, ID and headers
+	for (; i < FRAME_TEMP7; ++i) {
+		plainFrame[i] = txFrame[i];
+	}
+	if (frameSize < FRAME_TEMP7) {
+		return frameSize;
+	}
+	uint8_t size = FRAME_TEMP7 + copyFields(plainFrame + FRAME_TEMP7, txFrame[FRAME_HEADER]);
+	//History and battery
+	for (i = FRAME_HISTORY; i < frameSize; ++i) {
+		plainFrame[size++] = txFrame[i];
+	}
+	if (FRAME_TEMP7 == size) {
+		size = FRAME_HEADER;
+	}
+	plainFrame[FRAME_LENGTH] = size - 1;
+	return size;
+}
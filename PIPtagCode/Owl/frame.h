@@ -0,0 +1,98 @@
+#ifndef TPIP_FRAME_H_
+#define TPIP_FRAME_H_
+
+/*******************************************************************************
+ * Layout of the transmitted frame. The sensors are enabled at build time in
+ * settings.h, so every field has a fixed offset in one buffer that holds the
+ * length byte, the ID, the DataHeader and the sensed data. Sensing functions
+ * write their fields in place and the finished frame goes to the radio in a
+ * single burst.
+ * The fields follow the order of the DataHeader bits, which is the order the
+ * receiver decodes them in. Builds that send change reports, batches, packed
+ * frames or the power level put an ExtHeader byte between the DataHeader and
+ * the fields. History and battery are not sent in every frame, so the battery
+ * field moves up when no history is sent.
+ * The DataHeader can turn off sensors at run time. Their fields keep their
+ * offsets in txFrame, and only then is the frame copied without them.
+ * TLDR:
+ * 1. Write each field at 'txFrame + FRAME_<field>'.
+ * 2. Call 'finishFrame(header)' and send that many bytes from 'txFrame'.
+ * 3. If the header does not flag all of HEADER_SENSED, send
+ *    'compactFrame(size)' bytes from plainFrame instead.
+ ******************************************************************************/
+
+#include "../CC110x/definitions.h"
+#include "../settings.h"
+
+//Length of the rest of the frame
+#define FRAME_LENGTH 0
+//24 bit ID, or 21 bits and parity in protocol version 1
+#define FRAME_ID 1
+#define FRAME_HEADER 4
+//Protocol version 3 sends the fields bit packed, see packed.h
+#define FRAME_PACKED (PROTOCOL_VERSION >= 3)
+//ExtHeader, only in builds that can send change reports, batches, packed fields
+//or the power level
+#define FRAME_EXTENDED (ENABLE_REPORT_ON_CHANGE || BATCH_SIZE > 1 || FRAME_PACKED || ENABLE_POWER_POLICY)
+#define FRAME_EXT_HEADER 5
+#define FRAME_TEMP7 (FRAME_HEADER + (FRAME_EXTENDED ? 2 : 1))
+#define FRAME_TEMP16 (FRAME_TEMP7 + (ENABLE_BINARY ? 1 : 0))
+#define FRAME_LIGHT (FRAME_TEMP16 + (ENABLE_TEMP16 ? 2 : 0))
+#define FRAME_HTU_TEMP (FRAME_LIGHT + (ENABLE_AMBIENT_LIGHT ? 1 : 0))
+#define FRAME_HTU_RH (FRAME_HTU_TEMP + 2)
+#define FRAME_MOISTURE (FRAME_HTU_TEMP + (ENABLE_HTU_SENSING ? 4 : 0))
+#define FRAME_HISTORY (FRAME_MOISTURE + (ENABLE_MOISTURE ? 2 : 0))
+//History slot index followed by one HistoryUnit
+#define FRAME_HISTORY_SIZE 6
+//Offset of the battery field, which follows the history if it is sent
+#define FRAME_BATTERY(withHistory) (FRAME_HISTORY + ((withHistory) ? FRAME_HISTORY_SIZE : 0))
+#define FRAME_BATTERY_SIZE 4
+#define FRAME_MAX_SIZE (FRAME_BATTERY(ENABLE_HISTORY) + FRAME_BATTERY_SIZE)
+
+//DataHeader bits, see main.h
+#define HEADER_TEMP7 0x01
+#define HEADER_TEMP16 0x02
+#define HEADER_LIGHT 0x04
+#define HEADER_HTU 0x08
+#define HEADER_MOISTURE 0x10
+#define HEADER_HISTORY 0x20
+#define HEADER_BATTERY 0x40
+//An ExtHeader follows the DataHeader
+#define HEADER_EXTENDED 0x80
+//Sensed fields this build has offsets for
+#define HEADER_SENSED ((ENABLE_BINARY ? HEADER_TEMP7 : 0) \
+		| (ENABLE_TEMP16 ? HEADER_TEMP16 : 0) \
+		| (ENABLE_AMBIENT_LIGHT ? HEADER_LIGHT : 0) \
+		| (ENABLE_HTU_SENSING ? HEADER_HTU : 0) \
+		| (ENABLE_MOISTURE ? HEADER_MOISTURE : 0))
+
+extern uint8_t txFrame[FRAME_MAX_SIZE];
+extern uint8_t plainFrame[FRAME_MAX_SIZE];
+
+/*
+ * Store a 16 bit value big endian at the given offset.
+ */
+void putFrame16(uint8_t offset, uint16_t value);
+
+/*
+ * Set the headers and the length byte for the fields flagged in the header
+ * and return the number of bytes to send, length byte included. The
+ * extHeader is only sent in builds with FRAME_EXTENDED.
+ * A frame without sensed data is only the length and the ID.
+ */
+uint8_t finishFrame(uint8_t header, uint8_t extHeader);
+
+/*
+ * Copy the sensed fields flagged in the header from txFrame to dest, one
+ * after the other, and return the number of bytes copied.
+ */
+uint8_t copyFields(uint8_t* dest, uint8_t header);
+
+/*
+ * Copy the finished txFrame of the given size into plainFrame without the
+ * fields its header does not flag, and return the number of bytes to send.
+ * Only needed if the header turns off a sensor of HEADER_SENSED.
+ */
+uint8_t compactFrame(uint8_t frameSize);
+
+#endif /* TPIP_FRAME_H_ */
@@ -1,9 +1,10 @@
 #include "history.h"
+#include "scheduler.h"
 
 /* History ring buffer of values */
 HistoryUnit history[MAX_HISTORY_VALUES];
 /* Index for "head" of history ring buffer */
-char historyHead = MAX_HISTORY_VALUES-1;
+uint8_t historyHead = MAX_HISTORY_VALUES-1;
 
 void initHistory() {
 	int i = 0;
@@ -18,12 +19,9 @@ void initHistory() {
 	}
 }
 
-/* Number of radio transmissions since power-on */
-extern uint32_t numRadio;
-
 /*
  * The "hour" of the head of the history buffer.
- * Based on how many transmissions made since power-on.
+ * Based on the uptime kept by the scheduler.
  */
 uint32_t historyHeadHour = 0;
 
@@ -45,16 +43,16 @@ uint8_t historyRegValue = 1;
 void addHistory(const signed char temp, const signed char humidity,
 		const uint8_t light) {
 	/* The current hour since power-on. */
-	uint32_t hourNow = numRadio / RADIO_PER_HOUR;
+	uint32_t hourNow = getUptimeSeconds() / 3600;
 
 	/* Need to "cycle" the history by ejecting oldest, inserting new. */
 	if (historyHeadHour != hourNow) {
 		historyHeadHour = hourNow;
-		historyHead--;
-		/* Reset the head pointer to the front of the buffer */
-		if (historyHead >= MAX_HISTORY_VALUES) {
-			historyHead = MAX_HISTORY_VALUES-1;
+		/* Wrap the head pointer around to the end of the buffer */
+		if (0 == historyHead) {
+			historyHead = MAX_HISTORY_VALUES;
 		}
+		historyHead--;
 
 
 		history[historyHead].maxTemp = temp;
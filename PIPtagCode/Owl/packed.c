@@ -0,0 +1,98 @@
+#include "packed.h"
+
+//A packed frame is never longer than the frame it is packed from
+uint8_t packedFrame[FRAME_MAX_SIZE];
+
+//Next bit to write in packedFrame
+uint16_t packedBit;
+
+//The HTU21D driver sends these instead of a value, see sensing/htu21d.c
+#define HTU_FAIL_CODES 0xFFE
+
+static void putBits(uint16_t value, uint8_t width) {
+	if (width < 16) {
+		value &= (1U << width) - 1;
+	}
+	while (0 < width) {
+		uint8_t* byte = packedFrame + (packedBit >> 3);
+		uint8_t shift = packedBit & 0x07;
+		uint8_t room = 8 - shift;
+		if (0 == shift) {
+			*byte = 0;
+		}
+		*byte |= (uint8_t) (value << shift);
+		if (width <= room) {
+			packedBit += width;
+			return;
+		}
+		value >>= room;
+		width -= room;
+		packedBit += room;
+	}
+}
+
+static uint16_t getFrame16(uint8_t offset) {
+	return (txFrame[offset] << 8) | txFrame[offset + 1];
+}
+
+static uint16_t packHTUTemp(int16_t temp16) {
+	if (HTU_FAIL_CODES <= temp16) {
+		return temp16;
+	}
+	temp16 += PACKED_HTU_TEMP_OFFSET;
+	if (temp16 < 0) {
+		return 0;
+	}
+	return temp16 < HTU_FAIL_CODES ? temp16 : HTU_FAIL_CODES - 1;
+}
+
+static uint8_t packHTURH(int rh16) {
+	if (HTU_FAIL_CODES <= rh16) {
+		//0xFE and 0xFF
+		return rh16 - 0xF00;
+	}
+	if (rh16 < 0) {
+		return 0;
+	}
+	//Round 12.4 to half percent
+	rh16 = (rh16 + 4) >> 3;
+	return rh16 < PACKED_RH_MAX ? rh16 : PACKED_RH_MAX;
+}
+
+uint8_t packFrame(uint8_t frameSize) {
+	uint8_t header = txFrame[FRAME_HEADER];
+	uint8_t i = 0;
+	//Length, ID and headers
+	for (; i < FRAME_TEMP7; ++i) {
+		packedFrame[i] = txFrame[i];
+	}
+	if (frameSize < FRAME_TEMP7) {
+		return frameSize;
+	}
+	packedFrame[FRAME_EXT_HEADER] &= 0x0F;
+	packedBit = FRAME_EXT_HEADER * 8 + 4;
+	if (header & HEADER_TEMP7) {
+		putBits(txFrame[FRAME_TEMP7], 8);
+	}
+	if (header & HEADER_TEMP16) {
+		uint16_t temp16 = getFrame16(FRAME_TEMP16);
+		putBits(temp16 < 0x1000 ? temp16 : 0xFFF, 12);
+	}
+	if (header & HEADER_LIGHT) {
+		putBits(txFrame[FRAME_LIGHT], 8);
+	}
+	if (header & HEADER_HTU) {
+		putBits(packHTUTemp(getFrame16(FRAME_HTU_TEMP)), 12);
+		putBits(packHTURH(getFrame16(FRAME_HTU_RH)), 8);
+	}
+	if (header & HEADER_MOISTURE) {
+		putBits(getFrame16(FRAME_MOISTURE), 16);
+	}
+	//History and battery
+	uint8_t size = (packedBit + 7) >> 3;
+	for (i = FRAME_HISTORY; i < frameSize; ++i) {
+		packedFrame[size++] = txFrame[i];
+	}
+	packedFrame[FRAME_LENGTH] = size - 1;
+	return size;
+}
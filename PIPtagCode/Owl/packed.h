@@ -0,0 +1,44 @@
+#ifndef TPIP_PACKED_H_
+#define TPIP_PACKED_H_
+
+/*******************************************************************************
+ * Bit packed frames for protocol version 3. The sensing functions still fill
+ * txFrame (see frame.h) a byte at a time, and packFrame() copies the sensed
+ * fields into packedFrame at the resolution the sensors actually have.
+ * The fields are packed in DataHeader order, least significant bit first,
+ * starting in the high nibble of the ExtHeader byte. Any history and battery
+ * fields follow byte aligned and unchanged.
+ * Field widths:
+ *   temp7_binary   8 bits, unchanged
+ *   temp16_fixed  12 bits, the 12.4 value offset by 40 C
+ *   relativeLight  8 bits, unchanged
+ *   HTU21D temp   12 bits, the 12.4 value plus PACKED_HTU_TEMP_OFFSET
+ *   HTU21D RH      8 bits, in half percent from 0 to 100%
+ *   moisture      16 bits, unchanged
+ * The HTU21D error codes are sent as the two highest codes of their fields.
+ * TLDR:
+ * 1. Finish txFrame, then send 'packFrame(size)' bytes from packedFrame.
+ ******************************************************************************/
+
+#include "../CC110x/definitions.h"
+#include "../settings.h"
+#include "frame.h"
+
+//Offset that keeps HTU21D temperatures down to -47 C positive, 12.4 fixed point
+#define PACKED_HTU_TEMP_OFFSET (47 * 16)
+//Largest relative humidity code, 100% in half percent
+#define PACKED_RH_MAX 200
+
+#if FRAME_PACKED && 1 < BATCH_SIZE
+#error "Batches are not bit packed, use PROTOCOL_VERSION 2 with BATCH_SIZE"
+#endif
+
+extern uint8_t packedFrame[FRAME_MAX_SIZE];
+
+/*
+ * Pack the finished txFrame of the given size into packedFrame and return
+ * the number of bytes to send, length byte included.
+ */
+uint8_t packFrame(uint8_t frameSize);
+
+#endif /* TPIP_PACKED_H_ */
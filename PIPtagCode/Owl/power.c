@@ -0,0 +1,61 @@
+#include "power.h"
+#include "scheduler.h"
+
+extern sint8_t paTable[PA_TBL_SIZE];
+
+PowerLevel powerLevel = POWER_NORMAL;
+
+//PATABLE setting at the normal level
+sint8_t normalPaSetting = DEFAULT_PATABLE;
+
+//Set when paTable[0] changed and has not been written to the radio
+bool paTableChanged = false;
+
+//Supply voltage below which each level drops to the next one
+const uint16_t levelFloorMv[] = { POWER_LOW_MV, POWER_CRITICAL_MV };
+
+bool updatePowerLevel(uint16_t supply_mv) {
+	if (!ENABLE_POWER_POLICY) {
+		return false;
+	}
+	PowerLevel level = powerLevel;
+	while (POWER_CRITICAL != level && supply_mv < levelFloorMv[level]) {
+		++level;
+	}
+	while (POWER_NORMAL != level
+			&& supply_mv >= levelFloorMv[level - 1] + POWER_HYSTERESIS_MV) {
+		--level;
+	}
+	if (level == powerLevel) {
+		return false;
+	}
+	powerLevel = level;
+	return true;
+}
+
+void applyPowerLevel() {
+	uint8_t shift = 0;
+	sint8_t setting = normalPaSetting;
+	if (POWER_LOW == powerLevel) {
+		shift = POWER_LOW_STRETCH;
+		setting = POWER_LOW_PATABLE;
+	} else if (POWER_CRITICAL == powerLevel) {
+		shift = POWER_CRITICAL_STRETCH;
+		setting = POWER_CRITICAL_PATABLE;
+	}
+	stretchTaskPeriods(shift);
+	if (setting != paTable[0]) {
+		paTable[0] = setting;
+		paTableChanged = true;
+	}
+}
+
+void setNormalPaSetting(sint8_t setting) {
+	normalPaSetting = setting;
+}
+
+bool takePowerSettingsChange() {
+	bool changed = paTableChanged;
+	paTableChanged = false;
+	return changed;
+}
@@ -0,0 +1,55 @@
+#ifndef TPIP_POWER_H_
+#define TPIP_POWER_H_
+
+/*******************************************************************************
+ * Battery-aware power policy. Every battery sense moves the tag between power
+ * levels by its supply voltage. Below the normal level the sensing and
+ * transmit periods are stretched and the radio sends at a lower power, so
+ * that a tag at the end of its battery reports less often instead of browning
+ * out in the middle of a transmission. A level is only left again once the
+ * supply is POWER_HYSTERESIS_MV above its threshold, so a supply that sags
+ * after the radio was on does not flip the level back and forth.
+ * TLDR:
+ * 1. Call 'updatePowerLevel(mV)' with every battery sense.
+ * 2. If it returns true, call 'applyPowerLevel()' once the scheduler is set up.
+ * 3. Write the PATABLE when 'takePowerSettingsChange()' is true.
+ * 4. Set the lowPower ExtHeader bit while 'powerLevel' is not POWER_NORMAL.
+ ******************************************************************************/
+
+#include "../CC110x/definitions.h"
+#include "../settings.h"
+
+typedef enum {
+	POWER_NORMAL,
+	//Below POWER_LOW_MV
+	POWER_LOW,
+	//Below POWER_CRITICAL_MV
+	POWER_CRITICAL
+} PowerLevel;
+
+extern PowerLevel powerLevel;
+
+/*
+ * Move to the level of the given supply voltage in mV. Returns true if the
+ * level changed. Does nothing without ENABLE_POWER_POLICY.
+ */
+bool updatePowerLevel(uint16_t supply_mv);
+
+/*
+ * Stretch the task periods and set the PATABLE entry for the current level.
+ */
+void applyPowerLevel(void);
+
+/*
+ * Change the PATABLE setting of the normal level from DEFAULT_PATABLE, for
+ * example by a radio command. Takes effect with the next applyPowerLevel().
+ */
+void setNormalPaSetting(sint8_t setting);
+
+/*
+ * Returns true once after applyPowerLevel() changed the first PATABLE entry,
+ * which the radio keeps in SLEEP and otherwise is not written again.
+ */
+bool takePowerSettingsChange(void);
+
+#endif /* TPIP_POWER_H_ */
@@ -0,0 +1,52 @@
+#include "report.h"
+
+//Sensed fields as last transmitted, at their offsets in txFrame
+uint8_t reported[FRAME_HISTORY];
+
+//Difference of a 16 bit field from the reported value
+long fieldDiff(uint8_t offset, bool isSigned) {
+	uint16_t now = (txFrame[offset] << 8) | txFrame[offset + 1];
+	uint16_t then = (reported[offset] << 8) | reported[offset + 1];
+	if (isSigned) {
+		return (long) (int16_t) now - (int16_t) then;
+	}
+	return (long) now - then;
+}
+
+//True if the difference is outside of the deadband
+bool outside(long diff, int deadband) {
+	return diff > deadband || diff < -deadband;
+}
+
+bool reportChanged() {
+	bool changed = false;
+#if ENABLE_BINARY
+	//Binary bit in bit 0, whole degrees above it
+	changed |= 0 != ((txFrame[FRAME_TEMP7] ^ reported[FRAME_TEMP7]) & 0x01);
+	changed |= outside(((long) (txFrame[FRAME_TEMP7] >> 1) - (reported[FRAME_TEMP7] >> 1)) * 16,
+			DEADBAND_TEMP16);
+#endif
+#if ENABLE_TEMP16
+	changed |= outside(fieldDiff(FRAME_TEMP16, !TEMP_RAW_MEASUREMENT), DEADBAND_TEMP16);
+#endif
+#if ENABLE_AMBIENT_LIGHT
+	changed |= (txFrame[FRAME_LIGHT] >> LIGHT_BUCKET_SHIFT)
+			!= (reported[FRAME_LIGHT] >> LIGHT_BUCKET_SHIFT);
+#endif
+#if ENABLE_HTU_SENSING
+	//Error codes are far from any reading, so failures are reported too
+	changed |= outside(fieldDiff(FRAME_HTU_TEMP, true), DEADBAND_TEMP16);
+	changed |= outside(fieldDiff(FRAME_HTU_RH, true), DEADBAND_RH16);
+#endif
+#if ENABLE_MOISTURE
+	changed |= outside(fieldDiff(FRAME_MOISTURE, false), DEADBAND_MOISTURE);
+#endif
+	return changed;
+}
+
+void reportSent() {
+	uint8_t i = FRAME_TEMP7;
+	for (; i < FRAME_HISTORY; ++i) {
+		reported[i] = txFrame[i];
+	}
+}
@@ -0,0 +1,29 @@
+#ifndef TPIP_REPORT_H_
+#define TPIP_REPORT_H_
+
+/*******************************************************************************
+ * Report by exception. Keeps the sensed fields of the last transmitted frame
+ * and compares the fields of the frame being built against them, each with
+ * the deadband from settings.h.
+ * TLDR:
+ * 1. After sensing, transmit if 'reportChanged()' is true.
+ * 2. Call 'reportSent()' after every transmission.
+ ******************************************************************************/
+
+#include "../CC110x/definitions.h"
+#include "../settings.h"
+#include "frame.h"
+
+/*
+ * Returns true if a sensed field of the frame moved past its deadband since
+ * the last call to reportSent(). The binary input counts as changed whenever
+ * it differs.
+ */
+bool reportChanged(void);
+
+/*
+ * Remember the sensed fields of the frame that was just transmitted.
+ */
+void reportSent(void);
+
+#endif /* TPIP_REPORT_H_ */
@@ -0,0 +1,239 @@
+#include "scheduler.h"
+#include "../interrupt.h"
+
+extern void SleepLPM3(long ACLKDly);
+extern volatile unsigned long vloMsMult;
+
+//Deadline of a task that is not scheduled
+#define NEVER_DUE 0xFFFFFFFF
+
+typedef struct {
+	//Milliseconds between runs, 0 for tasks that only run once
+	uint32_t period_ms;
+	//Scheduler time when the task is next due, NEVER_DUE if it is not scheduled
+	uint32_t due_ms;
+} Task;
+
+Task tasks[NUM_TASKS];
+
+//Milliseconds since the scheduler started
+uint32_t schedulerNow = 0;
+
+//Uptime in whole seconds and the milliseconds not yet counted
+uint32_t uptimeSeconds = 0;
+uint16_t uptimeMs = 0;
+
+//Milliseconds spent in short sleeps and waits since the last wake-up
+uint16_t roundMs = 0;
+
+//Periods of the tasks before TASK_BATTERY are multiplied by 2^periodShift
+uint8_t periodShift = 0;
+
+//State of the LFSR behind nextRandom()
+uint16_t lfsr = 0xACE1;
+
+/*
+ * Sets up a periodic task, due immediately if it is enabled.
+ */
+void initTask(TaskId task, bool enabled, uint32_t period_ms) {
+	tasks[task].period_ms = period_ms;
+	tasks[task].due_ms = enabled ? schedulerNow : NEVER_DUE;
+}
+
+void initScheduler() {
+	schedulerNow = 0;
+	initTask(TASK_TRANSMIT, true, PACKTINTVL_MS);
+	initTask(TASK_REPEAT, false, 0);
+	initTask(TASK_BINARY, ENABLE_BINARY, BINARY_INTVL);
+	initTask(TASK_TEMP, ENABLE_BINARY || ENABLE_TEMP16, TEMP_INTVL);
+	initTask(TASK_LIGHT, ENABLE_AMBIENT_LIGHT, AMBIENT_LIGHT_INTVL);
+	initTask(TASK_HTU, ENABLE_HTU_SENSING, HTU_INTVL);
+	initTask(TASK_MOISTURE, ENABLE_MOISTURE, MOISTURE_INTVL);
+	initTask(TASK_BATTERY, true, SENSE_BATTERY_INTVL);
+	initTask(TASK_HISTORY, ENABLE_HISTORY, HISTORY_INTVL);
+	initTask(TASK_RECAL, true, RECAL_INTVL);
+}
+
+void setTaskPeriod(TaskId task, uint32_t period_ms) {
+	tasks[task].period_ms = period_ms;
+}
+
+/*
+ * The period of a task with the power policy's stretch applied.
+ */
+static uint32_t taskPeriod(TaskId task) {
+	return task < TASK_BATTERY ? tasks[task].period_ms << periodShift : tasks[task].period_ms;
+}
+
+void restartTask(TaskId task) {
+	tasks[task].due_ms = schedulerNow + taskPeriod(task);
+}
+
+void scheduleTaskOnce(TaskId task, uint32_t delay_ms) {
+	tasks[task].period_ms = 0;
+	tasks[task].due_ms = schedulerNow + delay_ms;
+}
+
+/*
+ * Signed distance from now to a deadline, negative if it has passed.
+ * Correct across wraparound of the clock.
+ */
+long untilDue(const Task* task) {
+	return (long) (task->due_ms - schedulerNow);
+}
+
+void stretchTaskPeriods(uint8_t shift) {
+	periodShift = shift;
+	TaskId task;
+	for (task = TASK_TRANSMIT; task < TASK_BATTERY; ++task) {
+		Task* t = &tasks[task];
+		if (NEVER_DUE == t->due_ms || 0 == t->period_ms) {
+			continue;
+		}
+		//Step back whole periods to keep the phase with the other tasks
+		uint32_t period = taskPeriod(task);
+		while ((long) period < untilDue(t)) {
+			t->due_ms -= period;
+		}
+	}
+}
+
+bool takeTaskIfDue(TaskId task) {
+	Task* t = &tasks[task];
+	if (NEVER_DUE == t->due_ms || 0 < untilDue(t)) {
+		return false;
+	}
+	if (0 == t->period_ms) {
+		t->due_ms = NEVER_DUE;
+	} else {
+		//Keep the phase of the task so that tasks with related periods
+		//stay due at the same wake-up. Skip periods that were missed.
+		uint32_t period = taskPeriod(task);
+		do {
+			t->due_ms += period;
+		} while (untilDue(t) <= 0);
+	}
+	return true;
+}
+
+uint16_t takeDueTasks() {
+	uint16_t due = 0;
+	TaskId task;
+	for (task = TASK_TRANSMIT; task < TASK_HISTORY; ++task) {
+		if (takeTaskIfDue(task)) {
+			due |= TASK_BIT(task);
+		}
+	}
+	return due;
+}
+
+uint32_t msUntilNextTask() {
+	long next = 0x7FFFFFFF;
+	TaskId task;
+	for (task = TASK_TRANSMIT; task < TASK_HISTORY; ++task) {
+		if (NEVER_DUE != tasks[task].due_ms && untilDue(&tasks[task]) < next) {
+			next = untilDue(&tasks[task]);
+		}
+	}
+	return next < 0 ? 0 : next;
+}
+
+//VLO cycles in the given milliseconds. The product is split so that it fits
+//32 bits for sleeps of many minutes.
+static uint32_t msToVlo(uint32_t ms) {
+	return (ms >> 12) * vloMsMult + (((ms & 0xFFF) * vloMsMult) >> 12);
+}
+
+#if BINARY_EDGE_WAKE
+//Milliseconds in the given VLO cycles, split like msToVlo()
+static uint32_t vloToMs(uint32_t cycles) {
+	return ((cycles / vloMsMult) << 12) + ((cycles % vloMsMult) << 12) / vloMsMult;
+}
+#endif
+
+void sleepMs(uint16_t ms) {
+	//Reset the state of the timer
+	TA0CTL |= TACLR;
+
+	//Count up to ms using the VLO.
+	TA0CCR0 = msToVlo(ms);
+	TA0CCR1 = 0;
+
+	//Source from ACLK (VLO) in UP mode with no divider
+	TA0CTL = TASSEL_1 | MC_1 | ID_0 | TAIE;
+	// Sleep until wake-up.
+	timedSleep = true;
+	__bis_SR_register(LPM3_bits + GIE);
+	timedSleep = false;
+	//Shut down the timer
+	TA0CTL &= ~MC_1;
+	TACCR0 = 0;
+	roundMs += ms;
+}
+
+void addRoundTime(uint16_t ms) {
+	roundMs += ms;
+}
+
+uint16_t getRoundTime() {
+	return roundMs;
+}
+
+uint32_t schedulerSleep(uint32_t ms) {
+#if BINARY_EDGE_WAKE
+	//Time the sleep on Timer1 at ACLK/8 in case an edge of the binary input
+	//ends it, the overflows come every 40 seconds or so
+	sleepClockOverflows = 0;
+	TA1CCTL0 = 0;
+	TA1CTL = TASSEL_1 | ID_3 | MC_2 | TACLR | TAIE;
+	SleepLPM3(msToVlo(ms));
+	TA1CTL = 0;
+	if (binaryEdgeSeen) {
+		if (AlarmAbort) {
+			//The edge came after the sleep was over
+			AlarmAbort = 0;
+		} else {
+			//The time awake before the sleep is only known from the waits
+			//of the round, the rest is a few milliseconds at most
+			ms = roundMs + vloToMs((((uint32_t) sleepClockOverflows << 16) | TA1R) << 3);
+		}
+	}
+#else
+	SleepLPM3(msToVlo(ms));
+#endif
+	roundMs = 0;
+	schedulerNow += ms;
+	uptimeSeconds += ms / 1000;
+	uptimeMs += ms % 1000;
+	if (uptimeMs >= 1000) {
+		uptimeMs -= 1000;
+		++uptimeSeconds;
+	}
+	return ms;
+}
+
+void seedRandom(uint32_t seed) {
+	//Multiplicative hash so that neighbouring IDs start far apart
+	lfsr = (seed * 2654435761UL) >> 16;
+	if (0 == lfsr) {
+		lfsr = 0xACE1;
+	}
+}
+
+uint16_t nextRandom() {
+	//Galois LFSR x^16 + x^14 + x^13 + x^11 + 1, period 65535
+	if (lfsr & 1) {
+		lfsr = (lfsr >> 1) ^ 0xB400;
+	} else {
+		lfsr >>= 1;
+	}
+	return lfsr;
+}
+
+uint32_t getUptimeSeconds() {
+	return uptimeSeconds;
+}
+
+uint32_t getSchedulerTime() {
+	return schedulerNow;
+}
@@ -0,0 +1,147 @@
+#ifndef TPIP_SCHEDULER_H_
+#define TPIP_SCHEDULER_H_
+
+/*******************************************************************************
+ * Deadline scheduler for the periodic work of the tag. Each task has its own
+ * period in milliseconds and the time it is next due. Instead of waking up
+ * every fixed interval and counting down, the main loop sleeps exactly until
+ * the earliest deadline, runs every task that is due and sleeps again.
+ * TLDR:
+ * 1. Call 'initScheduler()' once, all enabled tasks are due immediately.
+ * 2. After waking up, call 'takeDueTasks()' to get the tasks to run.
+ * 3. Sleep with 'schedulerSleep(msUntilNextTask())'.
+ * Times are kept in a 32-bit millisecond clock that wraps after 49 days, so
+ * deadlines are only ever compared by their difference from the clock.
+ ******************************************************************************/
+
+#include "../CC110x/definitions.h"
+#include "../settings.h"
+
+typedef enum {
+	TASK_TRANSMIT,
+	TASK_REPEAT,
+	TASK_BINARY,
+	TASK_TEMP,
+	TASK_LIGHT,
+	TASK_HTU,
+	TASK_MOISTURE,
+	TASK_BATTERY,
+	//The tasks below never wake the tag, they run with the next transmission
+	TASK_HISTORY,
+	TASK_RECAL,
+	NUM_TASKS
+} TaskId;
+
+#define TASK_BIT(task) (1 << (task))
+
+//The jitter is nextRandom() masked to TX_JITTER_MS - 1
+#if TX_JITTER_MS & (TX_JITTER_MS - 1)
+#error "TX_JITTER_MS must be 0 or a power of two"
+#endif
+
+/*
+ * Shortest sleep after a round of work, on top of getRoundTime(). SleepLPM3
+ * counts from the previous wake-up, so the work of a round, including a radio
+ * and VLO calibration with a slow VLO, has to be done before this much time
+ * has passed.
+ */
+#define MIN_SLEEP_MS 50
+
+/*
+ * Set up the task table from settings.h. Tasks of disabled sense types are
+ * never due.
+ */
+void initScheduler(void);
+
+/*
+ * Change the period of a task, keeping its current deadline.
+ */
+void setTaskPeriod(TaskId task, uint32_t period_ms);
+
+/*
+ * Multiply the periods of the sensing and transmit tasks by 2^shift, for the
+ * power policy. Battery sensing, history and radio recalibration keep their
+ * periods. Deadlines further away than the new period are brought forward.
+ */
+void stretchTaskPeriods(uint8_t shift);
+
+/*
+ * Restart the period of a task from now, for example to push back a heartbeat
+ * after another transmission.
+ */
+void restartTask(TaskId task);
+
+/*
+ * Make a task due once, the given number of milliseconds from now.
+ */
+void scheduleTaskOnce(TaskId task, uint32_t delay_ms);
+
+/*
+ * Returns a bit (TASK_BIT) for every waking task that is due and moves their
+ * deadlines to the next period.
+ */
+uint16_t takeDueTasks(void);
+
+/*
+ * Returns true if the task is due. If it is, its deadline moves to the next
+ * period.
+ */
+bool takeTaskIfDue(TaskId task);
+
+/*
+ * Milliseconds from now until the earliest deadline of a waking task.
+ */
+uint32_t msUntilNextTask(void);
+
+/*
+ * Sleep in LPM3 until the given number of milliseconds after the last wake-up
+ * and advance the scheduler clock by as much. With BINARY_EDGE_WAKE the sleep
+ * ends early if the binary input closes, and the clock advances by the time
+ * slept. Returns the milliseconds the clock advanced.
+ */
+uint32_t schedulerSleep(uint32_t ms);
+/*
+ * Set by an interrupt to make SleepLPM3() of AlarmClock-v1.2.asm return at
+ * its next wake-up. The routine clears it when it returns early.
+ */
+extern volatile uint16_t AlarmAbort;
+
+/*
+ * Sleep in LPM3 for a few milliseconds on Timer0, for example to wait for a
+ * sensor. The deadline of the next schedulerSleep() is not moved.
+ */
+void sleepMs(uint16_t ms);
+
+/*
+ * Account for a wait of up to the given time that did not use sleepMs().
+ */
+void addRoundTime(uint16_t ms);
+
+/*
+ * Milliseconds spent in sleepMs() and addRoundTime() since the last wake-up.
+ * The next schedulerSleep() must be longer than this.
+ */
+uint16_t getRoundTime(void);
+
+/*
+ * Seed the pseudo-random numbers of nextRandom(), from the ID of the tag so
+ * that every tag draws its own sequence.
+ */
+void seedRandom(uint32_t seed);
+
+/*
+ * Next state of a 16 bit LFSR, never 0. For transmit slots and jitter.
+ */
+uint16_t nextRandom(void);
+
+/*
+ * Whole seconds since the scheduler started, for the energy estimate.
+ */
+uint32_t getUptimeSeconds(void);
+
+/*
+ * The scheduler clock in milliseconds, the time of the last wake-up.
+ */
+uint32_t getSchedulerTime(void);
+
+#endif /* TPIP_SCHEDULER_H_ */
@@ -14,6 +14,9 @@
 bool sensingMoisture = 0;
 bool initializingHTU = 0;
 bool timedSleep = 0;
+bool binaryEdgeArmed = 0;
+bool binaryEdgeSeen = 0;
+uint16_t sleepClockOverflows = 0;
 extern uint8_t ambient_val;
 
 #pragma vector=TIMER1_A0_VECTOR
@@ -22,6 +25,17 @@ __interrupt void TIMER1_A0_ISR(void){
 	TA0CTL = 0;
 	_BIC_SR_IRQ(LPM3_bits);
 }
+
+/*
+ * Overflow of Timer1_A3 while it times a sleep that the binary input may end
+ * early, see schedulerSleep(). The CPU goes back to sleep.
+ */
+#pragma vector=TIMER1_A1_VECTOR
+__interrupt void TIMER1_A1_ISR(void) {
+	if (TA1IV_TAIFG == TA1IV) {
+		++sleepClockOverflows;
+	}
+}
 /*
  * Interrupt Service Request (ISR) for Timer0_A1-3
  * Used for ambient light sensing (Timer0_A3)
@@ -52,7 +66,7 @@ __interrupt void TIMER0_A1_ISR(void) {
 		/*
 		 * Ambient light sensing code
 		 */
-		uint16_t flags = TA0IV;
+		(void) TA0IV;	//Reading TA0IV clears the capture flag
 		uint16_t CCR_val = TA0CCR2;
 		uint16_t tmp_val = 0;
 		// LED discharged "enough" so store the value
@@ -34,5 +34,11 @@ extern bool initializingHTU;
 
 // Set when using the timer for wait for HTU21D reads
 extern bool timedSleep;
+// Set while an edge of the binary input on P1.2 should end the scheduler's sleep
+extern bool binaryEdgeArmed;
+// Set by the port interrupt when that edge came
+extern bool binaryEdgeSeen;
+// Overflows of Timer1_A3 while it times the scheduler's sleep
+extern uint16_t sleepClockOverflows;
 
 #endif /* INTERRUPT_H_ */
@@ -17,10 +17,8 @@ unsigned long boardID = TXER_ID; //Defined in settings.h so can be used as varia
 volatile double freq = DEFAULT_FREQ; //Transmit RF frequency.  Defined in settings.h
 volatile TagParameters params; //Data received via the optical communication link
 
-//Buffer for the non-data portion of the packet
-uint8_t baseBuffer[BASE_TX_BUFF_SIZE];
-
-volatile float vloMsMult = 12; 	// VLO is imprecise.  Estimate an initial value (12kHz) and then
+volatile unsigned long vloMsMult = 12UL << 12; 	// VLO cycles per ms with 12 fraction bits.
+								// VLO is imprecise.  Estimate an initial value (12kHz) and then
 								// Recalibrate with using the crystal on the radio chip.
 
 extern void SleepLPM3(long ACLKDly); //declare extern asm function to implement ACLK delay
@@ -92,25 +90,76 @@ int getBit(int decimal, int index) {
 }
 */
 
-void transmitAndPwrDown(char* baseBuffer, DataHeader header) {
-	/*Load transmit FIFO registers with the packet length */
-	TI_CC_SPIWriteBurstReg(TI_CCxxx0_TXFIFO, baseBuffer, 1);
+/*
+ * Send the frame. With listen set the radio turns to RX afterwards and is left
+ * on for receiveCommand(), otherwise it is powered down.
+ */
+void transmitAndPwrDown(DataHeader header, ExtHeader extHeader, bool listen) {
+	uint8_t* frame = txFrame;
+	extHeader.batch = BATCH_SIZE > 1;
+	extHeader.packed = FRAME_PACKED;
+	extHeader.lowPower = POWER_NORMAL != powerLevel;
+	uint8_t size = finishFrame(*(uint8_t*) (&header), *(uint8_t*) (&extHeader));
+	if (BATCH_SIZE > 1) {
+		size = finishBatch(size);
+		frame = batchFrame;
+	} else if (FRAME_PACKED) {
+		size = packFrame(size);
+		frame = packedFrame;
+	} else if (HEADER_SENSED != (*(uint8_t*) (&header) & HEADER_SENSED)) {
+		//Leave out the fields of the sensors turned off at run time
+		size = compactFrame(size);
+		frame = plainFrame;
+	}
+	if (listen) {
+		prepareDownlink();
+	}
 	/*Transition from idle to transmit mode.*/
 	TI_CC_SPIStrobe(TI_CCxxx0_STX);
-	//Now transfer the rest of the packet (ID+parity and the temperature+binary byte)
-	//Saves a bit of energy since transfer over SPI bus is much faster than transmission over the air.
-	TI_CC_SPIWriteBurstReg(TI_CCxxx0_TXFIFO, baseBuffer + 1,
-	BASE_TX_BUFF_SIZE - 1);
-	//Use mempool to find out how much data there is to send
-	if (0 < getAllSize()) {
-		TI_CC_SPIWriteBurstReg(TI_CCxxx0_TXFIFO, (char*) (&header), 1);
-		TI_CC_SPIWriteBurstReg(TI_CCxxx0_TXFIFO, (char*) getBase(),
-				getAllSize());
+	//Load the whole frame, length byte first, in one burst while the synthesizer
+	//settles and the preamble goes out. The FIFO is filled long before the
+	//modulator reaches the length byte.
+	TI_CC_SPIWriteBurstReg(TI_CCxxx0_TXFIFO, (char*) frame, size);
+
+	if (!listen) {
+		/*Power down CC1101 when Csn goes high*/
+		TI_CC_SPIStrobe(TI_CCxxx0_SPWD);
 	}
+}
 
-	/*Power down CC1101 when Csn goes high*/
-	TI_CC_SPIStrobe(TI_CCxxx0_SPWD);
+/*
+ * Put the ID of params into the frame header.
+ */
+void loadFrameID() {
+#if PROTOCOL_VERSION >= 2
+	// Fill Tx buffer: Load packet information
+	// The ID is 24 bits making the Length 3 bytes.
+	//Hardware generated CRC of 2 bytes is also added, but not counted in the Length.
+	// When the packet is going to be sent, finishFrame() sets the Length
+	// to the ID plus all data to be sent, including the header.
+	/* MAC ID (24 bits) */
+	txFrame[FRAME_ID] = 0xFF & (params.boardID >> 16);
+	txFrame[FRAME_ID + 1] = 0xFF & (params.boardID >> 8);
+	txFrame[FRAME_ID + 2] = 0xFF & (params.boardID);
+#else // Version 1	// Fill Tx buffer: Load packet information	// The ID is 21 bits with 3 bits of parity for a total of 3 bytes	// 3 bytes for the ID plus any extra required for header and data	// When the packet is going to be sent, finishFrame() sets the length.	/* High order bites of packet ID.  Bits 21-13 */	txFrame[FRAME_ID] = 0xFF & (params.boardID >> 13);	txFrame[FRAME_ID + 1] = 0xFF & (params.boardID >> 5);	txFrame[FRAME_ID + 2] = 0xFF & (params.boardID << 3);	//Now count parity	{	int shift;
+	for (shift = 0; shift < 21; shift += 3) {
+		txFrame[FRAME_ID + 2] ^= 0x7 & (params.boardID >> shift);
+	}
+}
+#endif
+}
 
+/*
+ * Set the radio channel of params, working it out from the ID if none was
+ * programmed.
+ */
+void loadChannel() {
+	uint8_t channel = params.channel;
+	if (CHANNEL_FROM_ID == channel) {
+		//The receiver sees the 24 bit ID, it can work out the channel too
+		channel = NUM_CHANNELS > 1 ? (params.boardID & 0xFFFFFFUL) % NUM_CHANNELS : 0;
+	}
+	setRadioChannel(channel);
 }
 
 /*
@@ -165,11 +214,12 @@ void recalibrateVLO(bool controlRadio) {
 	TA0CTL = 0; // Stop crystal clock timer
 	TA1CTL = 0; // Stop VLO clock timer
 
-	// Reset GDO0 to high impedence tri-state as set by ReWriteCC1101Registers() in main.c
+	// Reset GDO0 to high impedence tri-state as set by writeRadioConfig() in CC110x/radio_config.c
 	TI_CC_SPIWriteReg(TI_CCxxx0_IOCFG0, 0x2E); // GDO0 output pin to high impedance 3-state
 
 	uint16_t crystalCount = TA0CCR0;
-	vloMsMult = (135.416 * VLO_CALIB_COUNTS) / crystalCount;
+	//135.416 crystal counts per ms with 12 fraction bits
+	vloMsMult = (554664UL * VLO_CALIB_COUNTS) / crystalCount;
 }
 
 //	Number of times each operation is performed
@@ -182,31 +232,11 @@ uint32_t numRadio = 0;
 uint32_t numLight = 0;
 uint32_t numWakeup = 0;
 uint32_t numHistory = 0;
+uint32_t numDownlink = 0;
 
 //Flag indicating whether temp has been updated
 bool updatedTemp = false;
 
-//Sleep 10 ms to allow the capacitor to recharge
-void sleep10ms() {
-	//Go to LPM3 for 10ms
-	//Reset the state of the timer
-	TA0CTL |= TACLR;
-
-	//Count up to 10ms using the VLO.
-	TA0CCR0 = 10*vloMsMult;
-	TA0CCR1 = 0;
-
-	//Source from ACLK (VLO) in UP mode with no divider
-	TA0CTL = TASSEL_1 | MC_1 | ID_0 | TAIE;
-	// Sleep until wake-up.
-	timedSleep = true;
-	__bis_SR_register(LPM3_bits + GIE);
-	timedSleep = false;
-	//Shut down the timer
-	TA0CTL &= ~MC_1;
-	TACCR0 = 0;
-}
-
 void main(void) {
 	/* Stop the Watchdog Timer (WDT) */
 	WDTCTL = WDTPW + WDTHOLD;
@@ -225,60 +255,28 @@ void main(void) {
 	header.moisture = ENABLE_MOISTURE;// 0 turns off moisture sensing. 1 turns on moisture sensing.
 	header.htuSensing = ENABLE_HTU_SENSING;
 
-	//The total number of sense types that we'll be using
-	//We need to allow enough time for each sensor to
-	//finish and then have a 10ms delay before using the
-	//radio or going to the next sensor so that the
-	//capacitor can recharge.
-	unsigned char enabled_sense_types = ENABLE_BINARY + ENABLE_TEMP16 +
-			ENABLE_AMBIENT_LIGHT + ENABLE_MOISTURE + ENABLE_HTU_SENSING;
-
 	/***  Battery Level ***
-	 * Checking is done NO MATTER WHAT every BATTERY_STEPS
+	 * Checking is done NO MATTER WHAT every SENSE_BATTERY_INTVL
 	 * as defined in settings.h
 	 * Header bit is ONLY set when it will transmit.
 	 */
 
 	params.boardID = boardID;
 	params.freq = freq;
-	params.packet_interval = PACKTINTVL_MS;
+	params.packet_interval = ENABLE_REPORT_ON_CHANGE ? REPORT_HEARTBEAT_MS : PACKTINTVL_MS;
 	params.header = *(uint8_t*) (&header);
+	params.channel = CHANNEL_FROM_ID;
+	params.txPower = DEFAULT_PATABLE;
 
-	//Counter that determines when to recalibrate the radio
-	int recal_counter = 0;  //RECALINTVL / BINARY_INTVL;
-
-	// Number of times to wake-up before sending a BACKGROUND packet
-	int tx_counter = 1;
-
-	//  Number of times to wake up before sensing the binary door/water status
-	int binary_counter = BINARY_STEPS;
-
-	// Number of times to wake up before sensing the temperature
-	int temp_counter = 1;
+	ExtHeader extHeader;
+	*(uint8_t*) (&extHeader) = 0;
 
-	// Attempt to ensure reception of CRITICAL events.
-	int repeat_counter = 0;
 	// Number of remaining "repeats" to send
 	int repeat_tx_remain = 0;
 
-	// Number of times to wake up before checking battery
-	int battery_counter = 1;
-
-	// Number of times to wake up before checking battery
-	int light_counter = 1;
-
-	// Number of times to wake up before checking moisture
-	int moisture_counter = 1;
-
-	// Number of times to wake up before sending history, start with a history broadcast
-	int history_counter = 1;
-
 	// Prepare the temperature-related values
 	initTemperature();
 
-	// Number of times to wake up before doing temperature/relative humidity sensing
-	int htu_counter = 1;
-
 	/*
 	 * For optical transmission of transmitter settings
 	 */
@@ -292,12 +290,20 @@ void main(void) {
 	//If no optical signal is found then this uses default values.
 	//In production code where maximum lifetime is needed, disable LED flashing.
 	//When battery gets low, internal resistance is high enough that flashing shuts down the tag prematurely
-	if (!PRODUCTION) {
+	//The power policy measures the supply first and skips the flashes below its normal level.
+	if (ENABLE_POWER_POLICY) {
+		updatePowerLevel(adcSupplyMillivolts());
+	}
+	if (!PRODUCTION && POWER_NORMAL == powerLevel) {
 			flashLights(2);
 	}
-	//opticalReceive(&params);
+	if (ENABLE_OPTICAL_CONFIG) {
+		opticalReceive(&params);
+	}
 	//Re-assign the header
 	header = *(DataHeader*) (&params.header);
+	loadChannel();
+	setNormalPaSetting(params.txPower);
 
 	/* Configuring the ports: Set unused pins to input */
 	setMSP430Pins();
@@ -307,25 +313,7 @@ void main(void) {
 	AlrmClkStrt();                        //Start the alarm clock
 	SleepLPM3(3277);                    //sleep for 100ms to let the caps charge
 
-#if PROTOCOL_VERSION == 2
-	// Fill Tx buffer: Load packet information
-	// The ID is 24 bits making the Length 3 bytes.
-	//Hardware generated CRC of 2 bytes is also added, but not counted in the Length.
-	// When the packet is going to be sent, use the getAllSize function
-	// from the mem_pool header to see if any sensed data is to be sent.
-	// If it was, modify the value of the Length.
-	// The new Length comprises the ID plus all data to be sent, including the header.
-	baseBuffer[0] = 0x03;
-	/* MAC ID (24 bits) */
-	baseBuffer[1] = 0xFF & (params.boardID >> 16);
-	baseBuffer[2] = 0xFF & (params.boardID >> 8);
-	baseBuffer[3] = 0xFF & (params.boardID);
-#else // Version 1	// Fill Tx buffer: Load packet information	// The ID is 21 bits with 3 bits of parity for a total of 3 bytes	// 3 bytes for the ID plus any extra required for header and data	// When the packet is going to be sent, use the getAllSize function	// from the mem_pool header to see if any sensed data was taken.	// If it was, modify the value of the length.	baseBuffer[0] = 0x03;	/* High order bites of packet ID.  Bits 21-13 */	baseBuffer[1] = 0xFF & (params.boardID >> 13);	baseBuffer[2] = 0xFF & (params.boardID >> 5);	baseBuffer[3] = 0xFF & (params.boardID << 3);	//Now count parity	{	int shift;
-	for (shift = 0; shift < 21; shift += 3) {
-		baseBuffer[3] ^= 0x7 & (params.boardID >> shift);
-	}
-}
-#endif
+	loadFrameID();
 
 	setupAndPowerDownCC11xx();
 
@@ -342,157 +330,193 @@ void main(void) {
 
 	initHistory();
 
+	seedRandom(params.boardID);
+	if (TX_SLOT_OFFSET) {
+		//Wait for the slot of this tag in the transmit period, so that
+		//tags powered on together do not transmit in lockstep. The period
+		//is split in 16 bit halves to scale it without overflow.
+		uint32_t interval = params.packet_interval;
+		uint16_t random = nextRandom();
+		schedulerSleep(MIN_SLEEP_MS + (interval >> 16) * random
+				+ (((interval & 0xFFFF) * random) >> 16));
+	}
+
+	//Every enabled task is due at the first wake-up
+	initScheduler();
+	setTaskPeriod(TASK_TRANSMIT, params.packet_interval);
+	applyPowerLevel();
+
+	//Set when the binary input closing ended the last sleep
+	bool binaryEdge = false;
+	//Set when a command changed the frequency or channel
+	bool radioChanged = false;
+
 	for (;;) {
 
-		// Decrement the various counters
-		--binary_counter;
-		--tx_counter;
-		--temp_counter;
-		--recal_counter;
-		--battery_counter;
-		--light_counter;
-		--moisture_counter;
-		--htu_counter;
-		--history_counter;
 		++numWakeup;
 
-		if (repeat_counter > 0) {
-			repeat_counter--;
+		//Tasks due this round, their deadlines move on to the next period
+		uint16_t due = takeDueTasks();
+		if (binaryEdge) {
+			//Let the contacts settle before the input is read
+			sleepMs(BINARY_DEBOUNCE_MS);
+			due |= TASK_BIT(TASK_BINARY);
 		}
 
 		/*
 		 * Outline of sensing and transmission:
 		 *
-		 * 1. If performing a "repeat", mark doTransmit = 1
-		 * 2. If time to BACKGROUND transmit, mark doTransmit = 1
-		 * 3. Perform any sensing necessary this round
-		 * 4. If any CRITICAL data has changed, mark doTransmit = 1
-		 * 5. If doTransmit==1, transmit
-		 * 6. Sleep in LPM3 for WAKE_INTVL
+		 * 1. If a "repeat" or BACKGROUND transmission is due, mark doTransmit = 1
+		 * 2. Perform the sensing that is due this round and fill in the
+		 *    cached values of the other sense types. The HTU21D converts
+		 *    while the other sensors are read, and the capacitor only gets
+		 *    a recharge gap where drawCharge() finds it needs one.
+		 * 3. If any CRITICAL data has changed, mark doTransmit = 1
+		 * 4. If doTransmit==1, transmit
+		 * 5. Sleep in LPM3 until the next task is due
 		 */
 
 		/*
 		 * Check for a "repeat" transmission or BACKGROUND transmission.
 		 */
-		bool doTransmit = (repeat_tx_remain > 0 && repeat_counter == 0)
-				|| (tx_counter <= 0);
+		bool doTransmit = 0 != (due
+				& (TASK_BIT(TASK_TRANSMIT) | TASK_BIT(TASK_REPEAT)));
+		//Transmissions that cannot wait for a batch to fill up
+		bool urgent = 0 != (due & TASK_BIT(TASK_REPEAT));
 
 		/*
 		 * Check any sensing values appropriate for this round.
 		 */
-		if (!(header.decode)) {
-			/**
-			 * Update actual temperature reading if the counter has expired
-			 */
-			if (temp_counter <= 0) {
-				if (header.temp7_binary) {
-					updateTemp7();
-					updatedTemp = true;
-				}
-				if (header.temp16_fixed) {
-					updateTemp16F(!updatedTemp);
-					updatedTemp = true;
-				}
-				temp_counter = TEMP_STEPS;
-				//Sleep 10 ms to allow the capacitor to recharge
-				sleep10ms();
+		bool htuNow = header.htuSensing && (due & TASK_BIT(TASK_HTU));
+		/**
+		 * A temperature conversion this round also converts the supply
+		 * voltage for the battery sense below, warming the reference once.
+		 */
+		if (due & TASK_BIT(TASK_BATTERY)) {
+			adcShareSession(ADC_SUPPLY);
+		}
+		/**
+		 * Start the HTU21D temperature conversion first so that the
+		 * sensor converts while the sensors below are read. The
+		 * moisture probe shares its pins and runs after it is done.
+		 */
+		if (htuNow) {
+			drawCharge(HTU21D_CHARGE_NC);
+			//Initialize if successful communication did not occur
+			if (!htu_initialized) {
+				initHTU21D();
 			}
+			startHTU21DTemperature();
+		}
+		/**
+		 * Update actual temperature reading if it is due
+		 */
+		if (due & TASK_BIT(TASK_TEMP)) {
+			drawCharge(TEMP_CHARGE_NC);
 			if (header.temp7_binary) {
-				if (doTemp7Binary(!binary_counter)) {
-					repeat_tx_remain = SENSE_TX_REPEAT;
-					doTransmit = true;
-				}
-				if (binary_counter == 0) {
-					binary_counter = BINARY_STEPS;
-				}
-				//Sleep 10 ms to allow the capacitor to recharge
-				sleep10ms();
+				updateTemp7();
+				updatedTemp = true;
 			}
 			if (header.temp16_fixed) {
-				doSenseTemp16F();
-				//Sleep 10 ms to allow the capacitor to recharge
-				sleep10ms();
+				updateTemp16F(!updatedTemp);
+				updatedTemp = true;
 			}
-			if (header.relativeLight) {
-				if (light_counter) {
-					doSenseAmbientLight(false);
-				} else {
-					doSenseAmbientLight(true);
-					light_counter = AMBIENT_LIGHT_STEPS;
-				}
-				//Sleep 10 ms to allow the capacitor to recharge
-				sleep10ms();
+		}
+		if (header.temp7_binary) {
+			//With BINARY_EDGE_WAKE an open input is watched by the port
+			//interrupt, the poll only has to see a closed one open again
+			bool senseNow = 0 != (due & TASK_BIT(TASK_BINARY))
+					&& (binaryEdge || !BINARY_EDGE_WAKE || lastBinary);
+			if (senseNow) {
+				drawCharge(BINARY_CHARGE_NC);
 			}
-			//HTU21D temperature and relative humidity sensor
-			if (header.htuSensing) {
-				//Initialize if successful communication did not occur
-				if (!htu_initialized) {
-					initHTU21D();
-				}
-				//Call the sensing functions even if initialization was not
-				//successfull to fill in the data fields with error codes
-				if (htu_counter) {
-					doSenseHTUTemp16F(false,
-							HTU_ONBOARD
-									&& !(header.temp7_binary
-											|| header.temp16_fixed));
-					doSenseHTURH16F(false);
-				} else {
-					//Counter reached zero so do sensing and reset the counter
-					doSenseHTUTemp16F(true,
-							HTU_ONBOARD
-									&& !(header.temp7_binary
-											|| header.temp16_fixed));
-					doSenseHTURH16F(true);
-					updatedTemp = HTU_ONBOARD && true;
-					htu_counter = HTU_STEPS;
-				}
-				//Sleep 10 ms to allow the capacitor to recharge
-				sleep10ms();
+			if (doTemp7Binary(senseNow)) {
+				repeat_tx_remain = SENSE_TX_REPEAT;
+				doTransmit = true;
+				urgent = true;
 			}
-			if (header.moisture) {
-				// Do 16-bit moisture sensing, leaving the
-				//   data in the dynamic memory pool
-				//Do not do moisture sensing every epoch.
-				//Use moisture_counter (count down) to determine how often.
-				//MOISTURE_STEPS is moisture interval/wake interval in settings.h
-				//doMoistureSense in moisture.c
-				//True does sensing and resets counter
-				//False returns cached value
-				if (moisture_counter) {
-					doMoistureSense(false);
-				} else {
-					moisture_counter = MOISTURE_STEPS;
-					doMoistureSense(true);
-				}
-				//Sleep 10 ms to allow the capacitor to recharge
-				sleep10ms();
+		}
+		if (header.temp16_fixed) {
+			doSenseTemp16F();
+		}
+		if (header.relativeLight) {
+			bool senseNow = 0 != (due & TASK_BIT(TASK_LIGHT));
+			if (senseNow) {
+				drawCharge(LIGHT_CHARGE_NC);
+				//The LED discharge is timed in LPM3 for up to
+				//OPTICAL_DELAY_DURATION cycles of ACLK/4
+				addRoundTime((((OPTICAL_DELAY_DURATION + 1) * 4UL) << 12) / vloMsMult + 1);
+			}
+			doSenseAmbientLight(senseNow);
+		}
+		//HTU21D temperature and relative humidity sensor
+		if (header.htuSensing) {
+			//Call the sensing functions even if initialization was not
+			//successfull to fill in the data fields with error codes
+			doSenseHTU16F(htuNow,
+					HTU_ONBOARD
+							&& !(header.temp7_binary
+									|| header.temp16_fixed));
+			if (htuNow) {
+				++numHTU;
+				updatedTemp = HTU_ONBOARD && true;
 			}
 		}
+		if (header.moisture) {
+			// Do 16-bit moisture sensing, leaving the
+			//   data in the transmit frame
+			//Do not do moisture sensing every round.
+			//MOISTURE_INTVL in settings.h sets how often it is due.
+			//doMoistureSense in moisture.c
+			//True does sensing
+			//False returns cached value
+			bool senseNow = 0 != (due & TASK_BIT(TASK_MOISTURE));
+			if (senseNow) {
+				drawCharge(MOISTURE_CHARGE_NC);
+			}
+			doMoistureSense(senseNow);
+		}
 
-		//After doing the sensing types we need to sleep the rest of
-		//the interval until it is time to transmit the packet
-		SleepLPM3( MAX_SENSE_DELAY * enabled_sense_types * vloMsMult);
+		/*
+		 *  Update history whenever new temperature, humidity or light values were sensed.
+		 */
+		if ((header.htuSensing && (due & TASK_BIT(TASK_HTU)))
+				|| (header.relativeLight && (due & TASK_BIT(TASK_LIGHT)))) {
+			extern int htu_lastTemp, lastRH;
+			extern uint8_t cached_light;
+			//History keeps whole degrees and percent
+			addHistory(htu_lastTemp / 16, lastRH / 16, cached_light);
+		}
 
+		/*
+		 * In report by exception mode, transmit if a sensed value moved
+		 * past its deadband since the last transmission.
+		 */
+		if (ENABLE_REPORT_ON_CHANGE && reportChanged()) {
+			extHeader.changeReport = 1;
+			doTransmit = true;
+		}
 
+		if (due & TASK_BIT(TASK_BATTERY)) {
+			doTransmit = true;
+			urgent = true;
+		}
 
 		/*
-		 *  Update history every time sensing is performed.  This may result is a cached value
-		 *  being "carried over" to the new hour.  Harder to determine if sensing is "fresh"
-		 *  while keeping code simple.
-		 *  TODO: Correct the carry-over problem described above.
+		 * In batch mode every transmission round adds a sample to the batch,
+		 * but the radio only goes on once the batch is full or the sample
+		 * cannot wait.
 		 */
-		if (header.htuSensing || header.relativeLight) {
-			extern float htu_lastTemp, lastRH;
-			extern uint8_t cached_light;
-			addHistory((int) htu_lastTemp, (int) lastRH, cached_light);
+		if (BATCH_SIZE > 1 && doTransmit) {
+			batchAdd(*(uint8_t*) (&header));
+			doTransmit = urgent || batchFull();
 		}
 
-		// Annoying check, but need to know if battery will be added later
-		if (ENABLE_HISTORY && (history_counter < 1 && (doTransmit || battery_counter < 1))) {
+		// History is only sent along with a transmission
+		if (ENABLE_HISTORY && doTransmit && takeTaskIfDue(TASK_HISTORY)) {
 			header.vivaristatHistory = ENABLE_HISTORY; // 0 turns off history, 1 turns on history sensing
 			// Need extra byte for index value
-			uint8_t* historyPtr = malloc(sizeof(HistoryUnit)+1);
+			uint8_t* historyPtr = txFrame + FRAME_HISTORY;
 			historyPtr[0] = historyIndex;
 			HistoryUnit* oldestHistory = getHistory();
 
@@ -501,96 +525,130 @@ void main(void) {
 				historyPtr[i+1] = ((uint8_t*) oldestHistory)[i];
 			}
 			++numHistory;
-			history_counter = HISTORY_STEPS;
 		}
 
-		if (battery_counter < 1) {
-			battery_counter = BATTERY_STEPS;
+		//Force temperature measurement if none are enabled
+		if (doTransmit && !updatedTemp
+				&& !(header.temp7_binary || header.temp16_fixed
+						|| (HTU_ONBOARD && header.htuSensing))) {
+			getTemperature();
+		}
+
+		if (due & TASK_BIT(TASK_BATTERY)) {
 			header.battery = 1;
-			doBatterySense();
-			doTransmit = true;
+			doBatterySense(header.vivaristatHistory);
+			//Stretch or restore the intervals, before this transmission
+			//picks up the PATABLE setting
+			if (updatePowerLevel(cached_battery)) {
+				applyPowerLevel();
+			}
 		}
 
 		if (doTransmit) {
 
 			doTransmit = 0;
-			tx_counter = params.packet_interval / WAKE_INTVL;
 			++numRadio;
 
-			// Reset the repeat-counter
+			//Listen for a command after this transmission
+			bool listen = ENABLE_DOWNLINK && downlinkDue();
+
+			//Let the capacitor recharge from the sensing if the radio
+			//would take it too low
+			drawCharge(listen ? RADIO_CHARGE_NC + DOWNLINK_CHARGE_NC : RADIO_CHARGE_NC);
+
+			// Schedule the next "repeat"
 			if (repeat_tx_remain) {
 				--repeat_tx_remain;
 
 				switch (repeat_tx_remain) {
 				case 2:
-					repeat_counter = SENSE_REPEAT_INTVL_0 / WAKE_INTVL;
+					scheduleTaskOnce(TASK_REPEAT, SENSE_REPEAT_INTVL_0);
 					break;
 				case 1:
-					repeat_counter = SENSE_REPEAT_INTVL_1 / WAKE_INTVL;
+					scheduleTaskOnce(TASK_REPEAT, SENSE_REPEAT_INTVL_1);
 					break;
 				}
 			}
 
-			//Force temperature measurement if none are enabled
-			if (!updatedTemp
-					&& !(header.temp7_binary || header.temp16_fixed
-							|| (HTU_ONBOARD && header.htuSensing))) {
-				getTemperature();
-			}
-
 			/* Wake CC1101 and wait for oscillator to stabilize */
 			Wake_up_CC1101();
 
-			/* Re-write all the control registers */
-			ReWriteCC1101Registers();
+			/* Re-write the registers lost in SLEEP, the rest are retained */
+			restoreRadioConfig();
+			//Only the first PATABLE entry is retained, it changes with the
+			//power level
+			if (PA_TBL_SIZE > 1 || takePowerSettingsChange()) {
+				setPowerSettings();
+			}
 
-			int doRecalibrate = (recal_counter <= 1) || recalRadioFromTemp();
+			bool recalDue = takeTaskIfDue(TASK_RECAL) || radioChanged;
+			radioChanged = false;
+			int doRecalibrate = recalDue || recalRadioFromTemp();
 
 			if (doRecalibrate) {
-				//Recalibrate with the current frequency setting
-				recalibrateCC11xx(params.freq);
+				/* Re-write all the control registers */
+				writeRadioConfig();
+				//Recalibrate with the current frequency setting, a temperature
+				//seen before can reuse its calibration
+				recalibrateCC11xxCached(params.freq, radioTempBucket(), getSchedulerTime(), recalDue);
 
 				recalibrateVLO(false);
-
-				//Reset the calibration counter
-				recal_counter = RECAL_STEPS;
-			} else {
-				/* Re-write all the control registers responsible for setting the PLL */
-				restoreCC11xxRegs();
-			}
-
-			/*
-			 * Load transmit FIFO registers with the packet length, which is
-			 * 3, with possibly a header and sensed data
-			 */
-			if (0 < getAllSize()) {
-				baseBuffer[0] = 3 + 1 + getAllSize();
-			} else {
-				baseBuffer[0] = 3;
 			}
 
-			setPowerSettings();
-
 			/* TODO: Need 150 microseconds for the PLL to settle */
 			/*TI_CC_Wait(100);*/
 			//__delay_cycles(903);
-			transmitAndPwrDown((char*) baseBuffer, header);
+			transmitAndPwrDown(header, extHeader, listen);
+
+			if (listen) {
+				++numDownlink;
+				if (receiveCommand(&params)) {
+					//Take the parameters on as if they came in optically
+					header = *(DataHeader*) (&params.header);
+					loadFrameID();
+					loadChannel();
+					setTaskPeriod(TASK_TRANSMIT, params.packet_interval);
+					setNormalPaSetting(params.txPower);
+					applyPowerLevel();
+					radioChanged = true;
+				}
+			}
+
+			if (ENABLE_REPORT_ON_CHANGE) {
+				reportSent();
+				//The heartbeat is only needed after a silence
+				restartTask(TASK_TRANSMIT);
+			}
 		}
-		//Free the memory pool (which may have sensed data in it,
-		//whether or not we sent the data).
-		freeAll();
 
 		/** Clear the battery header bit **/
 		header.battery = 0;
 		header.vivaristatHistory = 0;
+		extHeader.changeReport = 0;
 		// Clear temp check flag
 		updatedTemp = false;
 
 		/* TODO: turn off the CC1150 supply */
 
-		//Go to sleep for either the default time or the time specified with
-		//optical programming, waking up a bit earlier to do sensing
-		//before the radio trnsmit time
-		SleepLPM3( (WAKE_INTVL - MAX_SENSE_DELAY*enabled_sense_types)* vloMsMult);
+		//Sleep until the next task is due, but at least long enough for
+		//the work of this round to be finished
+		uint32_t sleep_ms = msUntilNextTask();
+		uint32_t min_sleep_ms = MIN_SLEEP_MS + getRoundTime();
+		if (sleep_ms < min_sleep_ms) {
+			sleep_ms = min_sleep_ms;
+		}
+		if (TX_JITTER_MS) {
+			//The deadlines keep their phase, so the jitter does not add up
+			sleep_ms += nextRandom() & (TX_JITTER_MS - 1);
+		}
+		if (header.temp7_binary) {
+			armBinaryEdge();
+		}
+		sleep_ms = schedulerSleep(sleep_ms);
+		binaryEdge = disarmBinaryEdge();
+		//The capacitor recharges while the tag sleeps
+		if (sleep_ms > min_sleep_ms) {
+			rechargeSupply(sleep_ms - min_sleep_ms);
+		}
 	}
 }
@@ -1,7 +1,7 @@
 #ifndef TPIP_SEND_MAIN_H_
 #define TPIP_SEND_MAIN_H_
 
-#include "Owl/mem_pool.h"
+#include "Owl/frame.h"
 //Definitions for spi interface functions
 #include "CC110x/tuning.h"
 //Definitions for tuning functions--B. Firner
@@ -20,12 +20,18 @@
 
 // Code for saving history of temp/humidity/light
 #include "Owl/history.h"
-
-//Settings for the transmit packet buffer
-
-//The size of the base packet is 4
-//1 byte for the length and 3 bytes for ID + parity
-#define BASE_TX_BUFF_SIZE 			4
+// Deadline scheduler for sensing and transmission
+#include "Owl/scheduler.h"
+// Report by exception
+#include "Owl/report.h"
+// Several samples per packet
+#include "Owl/batch.h"
+// Bit packed fields for protocol version 3
+#include "Owl/packed.h"
+// Battery-aware power policy
+#include "Owl/power.h"
+// Commands received after a transmission
+#include "Owl/downlink.h"
 
 typedef struct {
   //7 bits of temperature followed by 1 bit of binary
@@ -36,8 +42,22 @@ typedef struct {
   uint8_t moisture :1;
   uint8_t vivaristatHistory :1;
   uint8_t battery :1;
-  uint8_t decode :1;
+  //An ExtHeader byte follows
+  uint8_t extended :1;
 } __attribute__((packed)) DataHeader;
+
+typedef struct {
+  //Set if the packet was sent because a sensed value changed
+  uint8_t changeReport :1;
+  //The fields hold several samples, see Owl/batch.h
+  uint8_t batch :1;
+  //The fields are bit packed, see Owl/packed.h
+  uint8_t packed :1;
+  //The power policy runs the tag below its normal level, see Owl/power.h
+  uint8_t lowPower :1;
+  //Packed frames start their fields in the high nibble
+  uint8_t reserved :4;
+} __attribute__((packed)) ExtHeader;
 // The packed attribute requires GCC extensions
 //In Code Composer Studio you must enable GCC extensions by going to:
 //Project -> Properties in the menu
@@ -45,8 +65,7 @@ typedef struct {
 //Finally, check the box labeled "Enable support for GCC extensions"
 
 uint8_t extraPacketLen(DataHeader* header);
-void ReWriteCC1101Registers(void);
-void transmitAndPwrDown(char* baseBuffer, DataHeader header);
+void transmitAndPwrDown(DataHeader header, ExtHeader extHeader, bool listen);
 int senseBinary(int isWater);
 void prepBinary(void);
 void finishBinary(void);
@@ -6,8 +6,16 @@
  */
 
 #include "optical_conn.h"
-
-int optBuff[MAX_OPTICAL_BYTES];
+#include "Owl/frame.h"
+#include "Owl/scheduler.h"
+
+uint8_t optBuff[MAX_OPTICAL_BYTES];
+//Bytes of the frame in optBuff, counted from the unlock code
+volatile uint8_t optCount = 0;
+//Offset in optBuff of the next key, where OPTICAL_END can end the frame
+uint8_t optKeyAt = 2;
+//Set once the frame ended, with OPTICAL_END or a key that is not known
+volatile bool optDone = false;
 //extern double freq;
 //extern long packet_interval;
 //extern unsigned long boardID;
@@ -96,6 +104,55 @@ int lightSense(void) {
 	return 1;						// if binary return
 }
 
+/*
+ * Bytes of the value after a key, 0 if the key is not known.
+ */
+static uint8_t keySize(uint8_t key) {
+	switch (key) {
+	case KEY_ID:
+		return 3;
+	case KEY_INTVL:
+		return 2;
+	case KEY_FREQ:
+	case KEY_HDR:
+	case KEY_CHAN:
+	case KEY_POWER:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Receives the optical frame into optBuff. Bytes before the unlock code are
+ * light flicker or the end of a frame and are dropped. The frame ends with
+ * OPTICAL_END in place of a key, so programmers may send any number of keys
+ * up to MAX_OPTICAL_BYTES. Wakes the CPU once the frame is complete.
+ */
+#pragma vector=USCIAB0RX_VECTOR
+__interrupt void USCIAB0RX_ISR(void) {
+	uint8_t byte = UCA0RXBUF;
+	if (optDone || optCount >= MAX_OPTICAL_BYTES) {
+		return;
+	}
+	if (optCount < 2 && byte != (0 == optCount ? OPTICAL_UNLOCK1 : OPTICAL_UNLOCK2)) {
+		//Start over, the byte may begin the unlock code itself
+		optCount = 0;
+		if (OPTICAL_UNLOCK1 != byte) {
+			return;
+		}
+	}
+	if (optCount == optKeyAt) {
+		uint8_t size = keySize(byte);
+		optKeyAt += 1 + size;
+		optDone = OPTICAL_END == byte || 0 == size;
+	}
+	optBuff[optCount++] = byte;
+	if (optDone || MAX_OPTICAL_BYTES == optCount) {
+		_BIC_SR_IRQ(LPM3_bits);
+	}
+}
+
 /**
  * Updates the tag's parameters via optical communication.
  */
@@ -106,13 +163,19 @@ void opticalReceive(volatile TagParameters* params) {
 	 Byte 2 is header
 	 Bytes 3, 4, and 5 are ID
 	 Byte 6 sets frequency:  put 0x16 (22 in decimal) for 922Mhz
-	 Bytes 7 and 8 set packet interval.   packet interval = 600L*((optBuff[7]<<8)+optBuff[8])
+	 Bytes 7 and 8 set packet interval.   packet interval = 50L*((optBuff[7]<<8)+optBuff[8]) ms
 	 The 9th byte is end code
 	 */
 
 	WDTCTL = WDTPW + WDTHOLD; // Stop WDT
+	BCSCTL3 = LFXT1S_2; //ACLK from the VLO for the light readings and sleepMs()
 
-	lightsetup(); //needs to be called to set up light sensing
+	//The programmer shines at the tag from before power-on, without its light
+	//there is nothing to receive. One reading takes under 100 ms in LPM3,
+	//while the radio still idles from its reset.
+	if (relativeLightLevel() < OPTICAL_LIGHT_MIN) {
+		return;
+	}
 
 	UCA0CTL1 |= UCSWRST; //set swrt....will change to ACLK
 	UCA0CTL0 = UCPEN + UCPAR; //parity even, LSB first, 8 bits, asynchronous, UART mode
@@ -139,65 +202,84 @@ void opticalReceive(volatile TagParameters* params) {
 
 	UCA0CTL1 &= ~UCSWRST; // clear SWRT **Initialize USCI state machine**
 
+	//Pull RX up while the light is there
+	P1OUT |= 0x02;
 	P1REN |= 0x02;
 
-	int i = 0;
-	int j = 0;
-
-	for (j = 0; j < MAX_OPTICAL_BYTES; j++) {
-		//TODO FIXME the & in the loop should really be a logical and (&&)
-		//stay in loop until data received, or 5 SEC
-		//~870 iterations per second
-		while (!(IFG2 & UCA0RXIFG)&& (i < TIME_WAIT)){
-
-		if (lightSense())
-		{
-			P1OUT |= 0x02;
-		} else {
-			P1OUT &= ~0x02;
+	//USCIAB0RX_ISR collects the frame. The USCI starts SMCLK for every byte,
+	//so the CPU sleeps in LPM3 between them.
+	optCount = 0;
+	optKeyAt = 2;
+	optDone = false;
+	IE2 |= UCA0RXIE;
+	uint16_t waited = 0;
+	while (!optDone && optCount < MAX_OPTICAL_BYTES && waited < TIME_WAIT) {
+		//Steady light without the unlock code is not a programmer
+		if (0 == optCount && waited >= OPTICAL_DETECT_MS) {
+			break;
 		}
-		i++;
+		sleepMs(OPTICAL_POLL_MS);
+		waited += OPTICAL_POLL_MS;
 	}
-	optBuff[j] = UCA0RXBUF;
-}
+	IE2 &= ~UCA0RXIE;
+	UCA0CTL1 |= UCSWRST; // Set UART Reset - Holds state machine
 
-		//Make sure the unlock code was received and the last byte is the end code
-	if ((optBuff[0] = OPTICAL_UNLOCK1) & (optBuff[1] == OPTICAL_UNLOCK2)
-			& (optBuff[MAX_OPTICAL_BYTES - 1] == OPTICAL_END)) // if unlock and ending codes correct
-			{
+	if (0 == optCount) {
+		return;
+	}
+
+	//Make sure the whole frame was received, up to the end code
+	if (optDone && OPTICAL_END == optBuff[optCount - 1]) {
 		//Start past the unlock code and scan for key-value pairs
-		int index = 2;
-		while (index < MAX_OPTICAL_BYTES && optBuff[index] != OPTICAL_END) {
-			if (KEY_ID == optBuff[index]) {
-				params->boardID = (((unsigned long) optBuff[index + 1]) << 16)
-						+ (optBuff[index + 2] << 8) + optBuff[index + 3]; // sets board ID
-				index += 4;
-			} else if (KEY_FREQ == optBuff[index]) {
-				params->freq = 900000000 + optBuff[index + 1] * 1000000; // sets Frequency
-				index += 2;
-			} else if (KEY_INTVL == optBuff[index]) {
-				// sets packet interval, in multiples of 600 (1/20 of a sec)
-				params->packet_interval = 600L
-						* ((optBuff[index + 1] << 8) + optBuff[index + 2]);
-				index += 3;
-			} else if (KEY_HDR == optBuff[index]) {
-				params->header = optBuff[index + 1];
-				index += 2;
-			} else {
-				//Error -- unrecognized code.
-				//For now just quit
-				return;
-			}
+		if (!parseTagParameters(optBuff + 2, optCount - 2, params)) {
+			//Error -- unrecognized code.
+			//For now just quit
+			return;
 		}
 
 		flashLights(20); //flash several times when received data
 	} else { //else use defaults
-//		freq = DEFAULT_FREQ;
-//		packet_interval = PACKTINTVL;
 		flashLights(2); //flash twice if defaults used
 	}
+}
 
-	UCA0CTL1 |= UCSWRST; // Set UART Reset - Holds state machine
+bool parseTagParameters(const uint8_t* buff, uint8_t length, volatile TagParameters* params) {
+	uint8_t index = 0;
+	while (index < length && buff[index] != OPTICAL_END) {
+		//Bytes of the value after the key
+		uint8_t size = keySize(buff[index]);
+		if (0 == size || index + size >= length) {
+			return false;
+		}
+		const uint8_t* value = buff + index + 1;
+		if (KEY_ID == buff[index]) {
+			params->boardID = ((unsigned long) value[0] << 16)
+					+ ((uint16_t) value[1] << 8) + value[2]; // sets board ID
+		} else if (KEY_FREQ == buff[index]) {
+			params->freq = 900000000 + value[0] * 1000000L; // sets Frequency
+		} else if (KEY_INTVL == buff[index]) {
+			// sets packet interval in ms, in multiples of 1/20 of a sec
+			uint16_t twentieths = ((uint16_t) value[0] << 8) + value[1];
+			if (0 == twentieths) {
+				return false;
+			}
+			params->packet_interval = 50L * twentieths;
+		} else if (KEY_HDR == buff[index]) {
+			//Sensors this build leaves out have no field to send
+			params->header = value[0] & HEADER_SENSED;
+		} else if (KEY_CHAN == buff[index]) {
+			//CHANNR holds channel * RADIO_CHANNEL_STEP, a channel past the
+			//plan would wrap it
+			if (CHANNEL_FROM_ID != value[0] && NUM_CHANNELS <= value[0]) {
+				return false;
+			}
+			params->channel = value[0];
+		} else {
+			params->txPower = value[0];
+		}
+		index += 1 + size;
+	}
+	return true;
 }
 
 void opticalTransmit(void) {
@@ -208,7 +290,7 @@ void opticalTransmit(void) {
 	 Byte 2 is header
 	 Bytes 3, 4, and 5 are ID
 	 Byte 6 sets frequency:  put 0x16 (22 in decimal) for 922Mhz
-	 Bytes 7 and 8 set packet interval.   packet interval = 600* (tbuff[8]*8+ tbuff[7])
+	 Bytes 7 and 8 set packet interval.   packet interval = 50 ms * (tbuff[7]*256 + tbuff[8])
 	 The 9th byte is end code
 	 */
 
@@ -263,6 +345,16 @@ void opticalTransmit(void) {
 		optTxBuff[++count] = KEY_HDR;
 		optTxBuff[++count] = HDRCODE;
 	}
+
+	if (WRITE_CHAN) {
+		optTxBuff[++count] = KEY_CHAN;
+		optTxBuff[++count] = CHANCODE;
+	}
+
+	if (WRITE_POWER) {
+		optTxBuff[++count] = KEY_POWER;
+		optTxBuff[++count] = POWERCODE;
+	}
 	++count;
 
 	//Fill the rest of the buffer with end bytes
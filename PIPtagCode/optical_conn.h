@@ -14,13 +14,17 @@
 //Key values for the key-value transmission
 #define KEY_ID		0x01 //3 Byte; ID (21 bits)
 #define KEY_FREQ	0x02 //1 Byte; Number of MHz frequency offset (900 + byte value)
-#define KEY_INTVL	0x03 //2 Bytes; Packet interval, in multiples of 600 (corresponds to 1/20 of a sec)
+#define KEY_INTVL	0x03 //2 Bytes; Packet interval in units of 50 ms
 #define KEY_HDR		0x04 //1 Byte; Data header setting
+#define KEY_CHAN	0x05 //1 Byte; Radio channel, see NUM_CHANNELS in settings.h
+#define KEY_POWER	0x06 //1 Byte; PATABLE setting at the normal power level, see Owl/power.h
 //Set to true to write these values
 #define WRITE_ID	1
 #define WRITE_FREQ	1
 #define WRITE_INTVL	1
 #define WRITE_HDR	1
+#define WRITE_CHAN	0
+#define WRITE_POWER	0
 
 #define IDCODE1 0x00
 #define IDCODE2 0x55
@@ -29,14 +33,25 @@
 #define INTVL1 0x02 //Upper byte
 #define INTVL2 0x58 //Lower byte
 #define HDRCODE 0x04
+#define CHANCODE 0x00
+#define POWERCODE PWR_6_0_dBm
 
 // Optical transmission constants
-#define MAX_OPTICAL_BYTES  14 //3 framing bytes, 4 keys, 7 total data bytes
+#define MAX_OPTICAL_BYTES  18 //Longest frame: 3 framing bytes, 6 keys, 9 total data bytes
 #define OPTICAL_UNLOCK1 0x11
 #define OPTICAL_UNLOCK2 0x22
 #define OPTICAL_END 0xAA
 
-#define TIME_WAIT 4350						//5 seconds, ~870 iterations per second, with 6Mhz clock
+/*
+ * Timing of opticalReceive(), in ms. Once the programmer's light is seen it
+ * has OPTICAL_DETECT_MS to start the unlock code and TIME_WAIT for the whole
+ * frame. The CPU wakes every OPTICAL_POLL_MS to check.
+ */
+#define OPTICAL_POLL_MS 50
+#define OPTICAL_DETECT_MS 500
+#define TIME_WAIT 5000
+//Lowest relativeLightLevel() taken for the programmer's LED
+#define OPTICAL_LIGHT_MIN 200
 
 // Programmable parameters for the tag
 typedef struct {
@@ -44,8 +59,15 @@ typedef struct {
 	double freq;
 	long packet_interval;
 	uint8_t header;
+	//Radio channel, CHANNEL_FROM_ID until one is programmed
+	uint8_t channel;
+	//PATABLE setting at the normal power level
+	uint8_t txPower;
 }__attribute__((packed)) TagParameters;
 
+//Channel of a tag that was not programmed with one, derived from its ID
+#define CHANNEL_FROM_ID 0xFF
+
 void flashLights(int);
 void lightsetup(void);
 int lightSense();
@@ -53,8 +75,18 @@ void opticalTransmit(void);
 
 /*
  * Perform optical reception to fill in the TagParameters struct.
- * Any fields not sent will be left unchanged.
+ * Any fields not sent will be left unchanged. Sleeps in LPM3 between the
+ * bytes, and returns early without the light of a programmer or without its
+ * unlock code. Expects the DCO and pins as they are after a reset.
  */
 void opticalReceive(volatile TagParameters*);
 
+/*
+ * Fill in the TagParameters struct from the key-value pairs in buff, up to
+ * length bytes or an OPTICAL_END byte. Used for the optical link and for
+ * radio commands, see Owl/downlink.h. Returns false on an unknown key or a
+ * value cut short, the fields before it are already set.
+ */
+bool parseTagParameters(const uint8_t* buff, uint8_t length, volatile TagParameters* params);
+
 #endif /* OPTICAL_CONN_H_ */
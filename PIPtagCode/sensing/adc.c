@@ -0,0 +1,118 @@
+/*
+ * adc.c
+ */
+
+#include "adc.h"
+
+int adc10_value;
+
+//Channels the next session converts as well
+static uint8_t sharedChannels = 0;
+//Supply voltage (mV) converted in a session and not taken yet
+static uint16_t supplyMillivolts = 0;
+static bool supplyFresh = false;
+//Whether the supply is measured against the 2.5V reference (Vcc >= 3V)
+static bool supplyHighRange = false;
+
+void adcShareSession(uint8_t channels) {
+	sharedChannels |= channels;
+}
+
+// ADC10 interrupt service routine so we sleep while waiting for the conversion to finish
+#pragma vector=ADC10_VECTOR
+__interrupt void ADC10_ISR(void) {
+	_BIC_SR_IRQ(CPUOFF);
+}
+
+static void settleReference() {
+	__delay_cycles(100);	//wait for Vref to settle.  30 microseconds needed.
+}
+
+/*
+ * Convert one channel against the reference that is on and return the
+ * count. Sleeps in LPM0 until the conversion is done.
+ */
+static uint16_t convert(uint16_t control1) {
+	ADC10CTL1 = control1;
+	ADC10CTL0 |= ENC | ADC10SC;
+
+	_BIS_SR(CPUOFF + GIE);
+	// LPM0, ADC10_ISR will force exit
+
+	ADC10CTL0 &= ~ENC;
+	return ADC10MEM;
+}
+
+/*
+ * Vcc/2 against the internal reference, after Michal Potrzebicz
+ * URL http://blog.elevendroids.com/2013/06/code-recipe-reading-msp430-power-supply-voltage-level/
+ */
+static uint16_t convertSupply() {
+	return convert(INCH_11 // Input channel select Vcc / 2
+			| SHS_0 // ADC10 source clock
+			| ADC10DIV_0 // ADC Clock divider select 0
+			| ADC10SSEL_0); // ADC10 oscillator
+}
+
+void adcSense(uint8_t channels) {
+	channels |= sharedChannels;
+	sharedChannels = 0;
+
+	//The temperature sensor is calibrated against the 1.5V reference, so
+	//only a session without it can start at 2.5V
+	bool highRange = supplyHighRange && !(channels & ADC_TEMPERATURE);
+	ADC10CTL0 = SREF_1 // R+ = VREF+ and R- = VSS
+			| REFON // Reference generator on
+			| (highRange ? REF2_5V : 0)
+			//64 clocks for the 30 us the temperature sensor needs, the
+			//supply takes 16
+			| ((channels & ADC_TEMPERATURE) ? ADC10SHT_3 : ADC10SHT_2)
+			| ADC10SR // Sampling rate 50ksps
+			| ADC10ON // ADC10 on
+			| ADC10IE; // Enable interrupts when ADC10MEM gets a result
+	settleReference();
+
+	if (channels & ADC_TEMPERATURE) {
+		//Clocked from ADC10OSC/4
+		adc10_value = convert(INCH_10 | ADC10DIV_3);
+	}
+
+	if (channels & ADC_SUPPLY) {
+		if (channels & ADC_TEMPERATURE) {
+			//Reference and sample time can only change while ENC is clear
+			ADC10CTL0 = (ADC10CTL0 & ~ADC10SHT_3) | ADC10SHT_2
+					| (supplyHighRange ? REF2_5V : 0);
+			if (supplyHighRange) {
+				highRange = true;
+				settleReference();
+			}
+		}
+		uint16_t raw_value = convertSupply();
+		if (!highRange && 0x3ff == raw_value) {
+			// switch range - use 2.5V reference (Vcc >= 3V)
+			ADC10CTL0 |= REF2_5V;
+			highRange = true;
+			settleReference();
+			raw_value = convertSupply();
+		}
+		// convert value to mV
+		if (highRange) {
+			supplyMillivolts = ((uint32_t) raw_value * 5000) / 1024;
+			supplyHighRange = ADC_SUPPLY_LOW_RANGE_MV <= supplyMillivolts;
+		} else {
+			supplyMillivolts = ((uint32_t) raw_value * 3000) / 1024;
+		}
+		supplyFresh = true;
+	}
+
+	//turn off Reference and ADC.  Needed for low sleep power
+	ADC10CTL0 &= ~(ADC10IFG | ADC10ON | REFON);
+}
+
+uint16_t adcSupplyMillivolts() {
+	if (!supplyFresh) {
+		adcSense(ADC_SUPPLY);
+	}
+	supplyFresh = false;
+	return supplyMillivolts;
+}
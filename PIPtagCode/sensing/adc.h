@@ -0,0 +1,51 @@
+/*
+ * adc.h
+ *
+ * ADC10 sessions for the on-chip temperature sensor and the supply voltage.
+ */
+
+#ifndef ADC_H_
+#define ADC_H_
+
+#include "../CC110x/definitions.h"
+#include "msp430.h"
+
+/*
+ * Channels converted by adcSense()
+ */
+#define ADC_TEMPERATURE BIT0
+#define ADC_SUPPLY BIT1
+
+/*
+ * Vcc in mV below which the supply is measured against the 1.5V reference
+ * again once a conversion moved it to the 2.5V one. Vcc/2 saturates the 1.5V
+ * reference at about 3000 mV, the gap keeps the range from flapping.
+ */
+#define ADC_SUPPLY_LOW_RANGE_MV 2900
+
+/*
+ * ADC10 count of the last temperature sensor conversion, against the 1.5V
+ * reference the temperature calibration was made with.
+ */
+extern int adc10_value;
+
+/*
+ * Have the next ADC10 session convert these channels as well, so that a
+ * measurement due later in the same wake-up shares its reference warm-up.
+ */
+void adcShareSession(uint8_t channels);
+
+/*
+ * Convert the channels, and any asked for with adcShareSession(), with one
+ * warm-up of the reference. The temperature sensor is converted first at
+ * 1.5V, then Vcc/2 with the reference of the last supply measurement.
+ */
+void adcSense(uint8_t channels);
+
+/*
+ * Supply voltage in mV. Taken from the session that already converted it in
+ * this wake-up, otherwise converted in a session of its own.
+ */
+uint16_t adcSupplyMillivolts(void);
+
+#endif /* ADC_H_ */
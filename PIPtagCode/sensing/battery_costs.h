@@ -0,0 +1,64 @@
+/*
+ * battery_costs.h
+ */
+
+#ifndef BATTERY_COSTS_H_
+#define BATTERY_COSTS_H_
+
+#include "../settings.h"
+
+/*
+ * Energy cost of each operation, used by getUsedJoules() and by the host
+ * simulator in sim/ to compare the estimate with the energy it integrates.
+ */
+
+// 2376 J, 220 mAh at 3.0 V
+#define BATTERY_CAP_UJ 2376000000UL
+
+// 0.38 uJ per binary sense
+#define BIN_COST_X256 97
+// 2.29 uJ per temperature sense
+#define TEMP_COST_X128 293
+// 0.10 uJ per battery voltage cost
+#define BATT_COST_X512 51
+
+/*
+ * Header + Light, HTU21D (Temp/Humid)
+ * Data: 6 bytes
+ * Preamble, Sync, Length, ID, CRC
+ * Overhead: 14 bytes
+ * Total: 20 bytes @ 4usec/bit = 640usec
+ */
+#if RADIO_PROFILE == RADIO_PROFILE_500K
+// Half the time on air @ 2usec/bit, 22 uJ less in TX. Measured in sim/.
+#define RADIO_COST 32
+#else
+#define RADIO_COST 54
+#endif
+/*
+ * Header + Light, HTU21D (Temp/Humid), 1 History (6 bytes)
+ * Data: 12 bytes
+ * Preamble, Sync, Length, ID, CRC
+ * Overhead: 14 bytes
+ * Total: 26 bytes @ 4usec/bit = 832usec
+ * Total Energy: 67 uJ
+ */
+#if RADIO_PROFILE == RADIO_PROFILE_500K
+#define RADIO_COST_HISTORY 7
+#else
+#define RADIO_COST_HISTORY 13
+#endif
+
+// 2uJ to sense light in a dark room, more for warm room (40C -> ~4uJ)
+#define LIGHT_COST 3
+// 2.85uJ to sleep for 1 second
+#define SLEEP_COST_1SECOND_x100 285
+// 23 uJ per temperature and humidity reading, No Hold Master with LPM3 sleep
+// during the conversions. 21.6 uJ of it is the sensor converting at 12 bit
+// temperature and 8 bit RH, the rest is the bit banged IIC. Measured in sim/.
+#define HTU21D_COST 23
+// 108 uJ per downlink receive window of DOWNLINK_WINDOW_MS, the radio in RX
+// until the window closes. Measured in sim/.
+#define DOWNLINK_COST 108
+
+#endif /* BATTERY_COSTS_H_ */
@@ -10,23 +10,27 @@
 #include "htu21d.h"
 #include "sensing.h"
 #include "temperature.h"
-#include "../Owl/mem_pool.h"
+#include "../Owl/frame.h"
 #include "../interrupt.h"
+#include "../Owl/scheduler.h"
 
 //Assembly function defined in AlarmClock-v1.2.asm that implements ACLK delay
 extern void SleepLPM3(long ACLKDly);
 
-//Cached results
-float htu_lastTemp;
-float lastRH;
-uint8_t* htu_temp16_location;
+//Cached results in 12.4 fixed point, or the error code of the last read
+int htu_lastTemp;
+int lastRH;
+//Last temperature with 20 fraction bits for the humidity compensation
+long htu_tempFixed;
 uint16_t htu_cached_temp16F = 0;
-uint8_t* htu_RH16_location;
 uint16_t htu_cached_RH16F = 0;
 
 //Remember if the HTU needs to be initialized
 bool htu_initialized = false;
 
+//Command of the no hold conversion in progress, 0 if there is none
+char htu_pending = 0;
+
 //The clock and data pins for IIC communication
 const char DATA = BIT1;
 const char SCK = BIT2;
@@ -44,16 +48,20 @@ const char ACK = 0x0;
 const char NACK = 0x1;
 
 //Equations from page 15 of the HTU21D sensor datasheet
+//The constants are the float values used before in fixed point. Slopes are
+//applied to the reading without its 2 status bits, which adds 2 fraction bits.
 //Temp = -46.85 + 175.72*Sensed / 2^16
-const double HTU_TEMP_SLOPE = 0.002681; //175.72 / 65536.0;
+const unsigned long HTU_TEMP_SLOPE = 11514807; //0.002681 with 32 fraction bits
 //For Merck want temp offset to read zero at -40C
 //Change temp offset by 40.
-//const double HTU_TEMP_OFFSET = -6.85;  //40.0 C offset so temp range starts at -40C
-const double HTU_TEMP_OFFSET = -46.85;  //Direct temp measurement, but lowest value reported is 0C
+//const long HTU_TEMP_OFFSET = -7182745;  //-6.85, 40.0 C offset so temp range starts at -40C
+const long HTU_TEMP_OFFSET = -49125784;  //-46.85 with 20 fraction bits. Direct temp measurement, but lowest value reported is 0C
 
 //RH = -6 + 125*Sensed / 2^16
-const double HTU_RH_SLOPE = 0.001907349; //125 / 65536.0;
+const unsigned long HTU_RH_SLOPE = 16384003; //0.001907349 with 33 fraction bits
 const int HTU_RH_OFFSET = -6;
+//RH compensation per degree away from 25C
+const unsigned long HTU_RH_TEMP_COEFF = 10066330; //0.15 with 26 fraction bits
 
 //Delay between clock pulses
 //Zero delay with just a function call if sufficient
@@ -62,46 +70,32 @@ const int HTU_RH_OFFSET = -6;
 
 //The number of times to attempt reading from the HTU21D before giving up
 const int read_retries = 3;
+
+//Conversion times (ms) at the 12 bit temperature and 8 bit RH resolution
+//that initHTU21D selects
+#define HTU_TEMP_CONVERSION_MS 13
+#define HTU_RH_CONVERSION_MS 3
+//Poll for the end of a conversion this often, giving up after 50 ms,
+//the longest conversion at any resolution
+#define HTU_POLL_MS 2
+#define HTU_MAX_POLLS 25
 //Constant values used to indicate failure
 #define CRC_FAIL 0xFFF;
 #define READ_FAIL 0xFFE;
 
-void doSenseHTUTemp16F(bool updateCached, bool calibration) {
-	static bool first = true;
-
-	if (updateCached || first) {
-		first = false;
-		uint16_t status = senseHTU21DTemperature(calibration);
-		//Store the error code on failure, convert to fixed point on success
-		if (0 != status) {
-			htu_cached_temp16F = status;
-		} else {
-			htu_cached_temp16F = to16Fixed(htu_lastTemp);
-		}
-	}
-
-	htu_temp16_location = malloc(2);
-	htu_temp16_location[0] = ((uint8_t*) &htu_cached_temp16F)[1];
-	htu_temp16_location[1] = ((uint8_t*) &htu_cached_temp16F)[0];
-}
-
-void doSenseHTURH16F(bool updateCached) {
+void doSenseHTU16F(bool updateCached, bool calibration) {
 	static bool first = true;
 
 	if (updateCached || first) {
 		first = false;
-		uint16_t status = senseHTU21DHumidity();
-		//Store the error code on failure, convert to fixed point on success
-		if (0 != status) {
-			htu_cached_RH16F = status;
-		} else {
-			htu_cached_RH16F = to16Fixed(lastRH);
-		}
+		//Both results hold the error code on failure
+		senseHTU21D(calibration);
+		htu_cached_temp16F = htu_lastTemp;
+		htu_cached_RH16F = lastRH;
 	}
 
-	htu_RH16_location = malloc(2);
-	htu_RH16_location[0] = ((uint8_t*) &htu_cached_RH16F)[1];
-	htu_RH16_location[1] = ((uint8_t*) &htu_cached_RH16F)[0];
+	putFrame16(FRAME_HTU_TEMP, htu_cached_temp16F);
+	putFrame16(FRAME_HTU_RH, htu_cached_RH16F);
 }
 
 //Output the given byte over the IIC pins. Returns the ack bit
@@ -110,7 +104,7 @@ char writeIICByte(char byte) {
 	P1REN &= ~DATA;
 	P1DIR |= DATA;
 
-	volatile unsigned int shift = 0;
+	unsigned int shift = 0;
 	for (; shift < 8; ++shift) {
 		//Set data high or low depending upon the current bit
 		if (0x80 & byte) {
@@ -153,12 +147,19 @@ char writeIICByte(char byte) {
 	return ack;
 }
 
-//Port 1 interrupt so we can sleep while the HTU sensor is sensing
+//Port 1 interrupt so we can sleep while the HTU sensor is sensing.
+//The binary input shares the clock pin, see armBinaryEdge() in sensing.c.
 #pragma vector=PORT1_VECTOR
 __interrupt void p1interrupt() {
 	//Turn off the interrupt, clear the interrupt flag, and exit LPM3
 	P1IE &= ~SCK;
 	P1IFG &= ~SCK;
+	if (binaryEdgeArmed) {
+		//End the scheduler's sleep in the alarm clock
+		binaryEdgeArmed = false;
+		binaryEdgeSeen = true;
+		AlarmAbort = 1;
+	}
 	LPM3_EXIT;
 }
 
@@ -366,42 +367,52 @@ bool initHTU21D() {
 	return true;
 }
 
-//Apply simple CRC algorithm (non-tabular method)
-unsigned char checkCRC(unsigned long msg, unsigned char crc) {
-	//The polynomial is x^8 + x^5 + x^4 + x^0, or 0x131
-	//The polynomial is shifted left to move the x^8 into the upper bit
-	//of the third byte so that we can XOR from the
-	//head of the input data (for convenience), yielding 0x988000
-	unsigned long poly = 0x988000;
-	//The high bit is used to check if we do an XOR
-	unsigned long high_bit = 0x800000;
-	//The last place to check is x^8 (no fractions in bitwise division)
-	unsigned long last_check = 0x100;
-	//Left shift and add in the CRC. After running the polynomial
-	//through we should be left with a 0 remainder
-	msg <<= 8;
-	msg |= crc;
-	while (last_check <= high_bit) {
-		//Check if upper bit is a 1
-		if (high_bit & msg) {
-			msg ^= poly;
-		}
-		//Rotate right
-		poly >>= 1;
-		high_bit >>= 1;
-	}
-	return msg & 0xFF;
+//CRC-8 of the HTU21D, polynomial x^8 + x^5 + x^4 + 1 (0x31), by the value
+//of the byte XORed into the CRC
+static const uint8_t htuCRCTable[256] = {
+	0x00, 0x31, 0x62, 0x53, 0xC4, 0xF5, 0xA6, 0x97,
+	0xB9, 0x88, 0xDB, 0xEA, 0x7D, 0x4C, 0x1F, 0x2E,
+	0x43, 0x72, 0x21, 0x10, 0x87, 0xB6, 0xE5, 0xD4,
+	0xFA, 0xCB, 0x98, 0xA9, 0x3E, 0x0F, 0x5C, 0x6D,
+	0x86, 0xB7, 0xE4, 0xD5, 0x42, 0x73, 0x20, 0x11,
+	0x3F, 0x0E, 0x5D, 0x6C, 0xFB, 0xCA, 0x99, 0xA8,
+	0xC5, 0xF4, 0xA7, 0x96, 0x01, 0x30, 0x63, 0x52,
+	0x7C, 0x4D, 0x1E, 0x2F, 0xB8, 0x89, 0xDA, 0xEB,
+	0x3D, 0x0C, 0x5F, 0x6E, 0xF9, 0xC8, 0x9B, 0xAA,
+	0x84, 0xB5, 0xE6, 0xD7, 0x40, 0x71, 0x22, 0x13,
+	0x7E, 0x4F, 0x1C, 0x2D, 0xBA, 0x8B, 0xD8, 0xE9,
+	0xC7, 0xF6, 0xA5, 0x94, 0x03, 0x32, 0x61, 0x50,
+	0xBB, 0x8A, 0xD9, 0xE8, 0x7F, 0x4E, 0x1D, 0x2C,
+	0x02, 0x33, 0x60, 0x51, 0xC6, 0xF7, 0xA4, 0x95,
+	0xF8, 0xC9, 0x9A, 0xAB, 0x3C, 0x0D, 0x5E, 0x6F,
+	0x41, 0x70, 0x23, 0x12, 0x85, 0xB4, 0xE7, 0xD6,
+	0x7A, 0x4B, 0x18, 0x29, 0xBE, 0x8F, 0xDC, 0xED,
+	0xC3, 0xF2, 0xA1, 0x90, 0x07, 0x36, 0x65, 0x54,
+	0x39, 0x08, 0x5B, 0x6A, 0xFD, 0xCC, 0x9F, 0xAE,
+	0x80, 0xB1, 0xE2, 0xD3, 0x44, 0x75, 0x26, 0x17,
+	0xFC, 0xCD, 0x9E, 0xAF, 0x38, 0x09, 0x5A, 0x6B,
+	0x45, 0x74, 0x27, 0x16, 0x81, 0xB0, 0xE3, 0xD2,
+	0xBF, 0x8E, 0xDD, 0xEC, 0x7B, 0x4A, 0x19, 0x28,
+	0x06, 0x37, 0x64, 0x55, 0xC2, 0xF3, 0xA0, 0x91,
+	0x47, 0x76, 0x25, 0x14, 0x83, 0xB2, 0xE1, 0xD0,
+	0xFE, 0xCF, 0x9C, 0xAD, 0x3A, 0x0B, 0x58, 0x69,
+	0x04, 0x35, 0x66, 0x57, 0xC0, 0xF1, 0xA2, 0x93,
+	0xBD, 0x8C, 0xDF, 0xEE, 0x79, 0x48, 0x1B, 0x2A,
+	0xC1, 0xF0, 0xA3, 0x92, 0x05, 0x34, 0x67, 0x56,
+	0x78, 0x49, 0x1A, 0x2B, 0xBC, 0x8D, 0xDE, 0xEF,
+	0x82, 0xB3, 0xE0, 0xD1, 0x46, 0x77, 0x24, 0x15,
+	0x3B, 0x0A, 0x59, 0x68, 0xFF, 0xCE, 0x9D, 0xAC
+};
+
+//Returns true if the checksum matches the two bytes of a reading
+static bool checkCRC(uint8_t msb, uint8_t lsb, uint8_t checksum) {
+	return checksum == htuCRCTable[htuCRCTable[msb] ^ lsb];
 }
 
-//Get the temperature from the HTU21D sensor over the IIC bus
-uint16_t senseHTU21DTemperature(bool calibration) {
-	if (!htu_initialized) {
-		htu_lastTemp = READ_FAIL
-		;
-		return htu_lastTemp;
-	}
-
-	// Always start with init sequence.
+//Start a no hold conversion with the given command. The sensor converts on
+//its own and the bus is free until readHTU21D is called.
+//Returns 0 on success, an error code on failure
+uint16_t startHTU21D(char command) {
 	IICStart();
 	//Keep trying to contact the chip until it is ready and gives an ACK
 	int attempts = 0;
@@ -411,125 +422,149 @@ uint16_t senseHTU21DTemperature(bool calibration) {
 		++attempts;
 		//Read failure
 		if (read_retries < attempts) {
-			htu_lastTemp = READ_FAIL
-			;
 			//We require re-initialization
 			htu_initialized = false;
-			return htu_lastTemp;
+			return READ_FAIL;
 		}
 	}
-	//Read 12 bit temperature using HOLD master mode
-	if (writeIICByte(HTU_HOLD_TEMP)) {
+	if (writeIICByte(command)) {
 		IICStop();
 		htu_initialized = false;
-		return htu_lastTemp = READ_FAIL;
+		return READ_FAIL;
 	}
+	IICStop();
+	htu_pending = command;
+	return 0;
+}
 
+//Read the result of the conversion started by startHTU21D, polling until
+//the sensor is done. If next is a command, start that conversion with a
+//repeated start in the same session, htu_pending tells if it started.
+//Returns 0 on success, an error code on failure
+uint16_t readHTU21D(unsigned int* reading, char next) {
+	htu_pending = 0;
+	//The sensor does not acknowledge its read address during a conversion
+	int polls = 0;
 	IICStart();
-	if (writeIICByte(HTU_ADDRESS | HTU_READ_FLAG)) {
+	while (NACK == writeIICByte(HTU_ADDRESS | HTU_READ_FLAG)) {
 		IICStop();
-		htu_initialized = false;
-		return htu_lastTemp = READ_FAIL;
+		++polls;
+		if (HTU_MAX_POLLS < polls) {
+			htu_initialized = false;
+			return READ_FAIL;
+		}
+		sleepMs(HTU_POLL_MS);
+		IICStart();
 	}
 	//Storing msb into an int for a future left shift, lsb is safe as a u_char
 	unsigned int msb = readIICByte(ACK);
 	unsigned char lsb = readIICByte(ACK);
-	char checksum = readIICByte(NACK);
+	unsigned char checksum = readIICByte(NACK);
+	//The sensor just answered, so the next command needs no retries
+	if (next) {
+		IICStart();
+		if (ACK == writeIICByte(HTU_ADDRESS) && ACK == writeIICByte(next)) {
+			htu_pending = next;
+		}
+	}
 	IICStop();
 
-	//Lowest 2 bits are just status information
-	unsigned int reading = (msb << 8) | (lsb & 0xFC);
-
-	//Valid temperature range -46.85C to 128C
-	htu_lastTemp = HTU_TEMP_SLOPE * reading + HTU_TEMP_OFFSET;
-
 	//Leave the pins low, but set DATA low first to try and avoid bus errors
 	P1DIR &= ~(DATA);
 	P1OUT &= ~DATA;
 	P1DIR &= ~(SCK);
 	P1OUT &= ~SCK;
 
-	//Check CRC
-	if (0 != checkCRC(msb << 8 | lsb, checksum)) {
-		//Indicate error if the CRC failed
-		htu_lastTemp = CRC_FAIL
-		;
-		return htu_lastTemp;
+	if (!checkCRC(msb, lsb, checksum)) {
+		return CRC_FAIL;
+	}
+	//Lowest 2 bits are just status information
+	*reading = (msb << 8) | (lsb & 0xFC);
+	return 0;
+}
+
+void startHTU21DTemperature() {
+	if (htu_initialized && 0 == htu_pending) {
+		startHTU21D(HTU_TEMP);
 	}
+}
+
+//Convert a temperature reading, keeping it for the humidity compensation
+static void convertHTUTemperature(unsigned int reading, bool calibration) {
+	//Valid temperature range -46.85C to 128C
+	htu_tempFixed = mulFixed(HTU_TEMP_SLOPE, reading >> 2, 10) + HTU_TEMP_OFFSET;
+	htu_lastTemp = to16Fixed(htu_tempFixed, 20);
+
 	//If this is being used for calibration then set the temperature
-	else if (calibration) {
+	if (calibration) {
 		setLastTemp(htu_lastTemp);
 	}
+}
 
-	return 0;
+//Convert a humidity reading, compensated with the last temperature
+static void convertHTUHumidity(unsigned int reading) {
+	//Convert to value with 20 fraction bits
+	long rh = mulFixed(HTU_RH_SLOPE, reading >> 2, 11) + ((long) HTU_RH_OFFSET << 20);
+
+	//Error codes are above 250C
+	if (htu_lastTemp < 250 * 16) {
+		// Compensate for temperatures away from 25C
+		// The difference is cut to 9 fraction bits to fit the multiplication
+		long diff = (htu_tempFixed - (25L << 20)) / (1 << 11);
+		if (diff < 0) {
+			rh -= mulFixed(HTU_RH_TEMP_COEFF, -diff, 15);
+		} else {
+			rh += mulFixed(HTU_RH_TEMP_COEFF, diff, 15);
+		}
+	}
+	lastRH = to16Fixed(rh, 20);
 }
 
-//Get the temperature from the HTU21D sensor over the IIC bus
-uint16_t senseHTU21DHumidity() {
+//Get the temperature and relative humidity from the HTU21D sensor over the IIC bus
+uint16_t senseHTU21D(bool calibration) {
 	if (!htu_initialized) {
-		lastRH = READ_FAIL
+		htu_pending = 0;
+		htu_lastTemp = READ_FAIL
 		;
-		return lastRH;
+		lastRH = htu_lastTemp;
+		return htu_lastTemp;
 	}
-	// Init each time, were previously in crazy state.
-	IICStart();
-	//Keep trying to contact the chip until it is ready and gives an ACK
-	int attempts = 0;
-	while (NACK == writeIICByte(HTU_ADDRESS)) {
-		IICStop();
-		IICStart();
-		++attempts;
-		//Read failure
-		if (read_retries < attempts) {
-			lastRH = READ_FAIL
-			;
-			//We require re-initialization
-			htu_initialized = false;
-			return lastRH;
-		}
 
+	//Start a temperature conversion unless startHTU21DTemperature already did
+	uint16_t status = 0;
+	if (HTU_TEMP != htu_pending) {
+		status = startHTU21D(HTU_TEMP);
+		//Sleep through the conversion
+		if (0 == status) {
+			sleepMs(HTU_TEMP_CONVERSION_MS);
+		}
 	}
-	//Read 12 bit temperature using HOLD master mode
-	if (writeIICByte(HTU_HOLD_RH)) {
-		IICStop();
-		htu_initialized = false;
-		return lastRH = READ_FAIL
+	unsigned int reading = 0;
+	if (0 == status) {
+		//Reading the temperature starts the humidity conversion
+		status = readHTU21D(&reading, HTU_RH);
 	}
-	IICStart();
-	if (writeIICByte(HTU_ADDRESS | HTU_READ_FLAG)) {
-		IICStop();
-		htu_initialized = false;
-		return lastRH = READ_FAIL;
+	if (0 != status) {
+		htu_lastTemp = status;
+	} else {
+		convertHTUTemperature(reading, calibration);
 	}
-	//Storing msb into an int for a future left shift, lsb is safe as a u_char
-	unsigned int msb = readIICByte(ACK);
-	unsigned char lsb = readIICByte(ACK);
-	char checksum = readIICByte(NACK);
-	IICStop();
-
-	//Lowest 2 bits are just status information
-	unsigned int reading = (msb << 8) | (lsb & 0xFC);
-	//Convert to value
-	lastRH = HTU_RH_SLOPE * reading + HTU_RH_OFFSET;
 
-	//Leave the pins low, but set DATA low first to try and avoid bus errors
-	P1DIR &= ~(DATA);
-	P1OUT &= ~DATA;
-	P1DIR &= ~(SCK);
-	P1OUT &= ~SCK;
-
-	//Check CRC
-	if (0 != checkCRC(msb << 8 | lsb, checksum)) {
-		//Indicate error if the CRC failed
-		lastRH = CRC_FAIL
-		;
-		return lastRH;
+	//Start the humidity conversion again if that failed, unless the sensor is lost
+	uint16_t rhStatus = htu_initialized ? 0 : READ_FAIL;
+	if (0 == rhStatus && HTU_RH != htu_pending) {
+		rhStatus = startHTU21D(HTU_RH);
 	}
-	if (htu_lastTemp < 250) {
-		// Compensate for temperatures away from 25C
-		lastRH = lastRH - .15 * (25 - htu_lastTemp);
+	if (0 == rhStatus) {
+		//Sleep through the conversion
+		sleepMs(HTU_RH_CONVERSION_MS);
+		rhStatus = readHTU21D(&reading, 0);
+	}
+	if (0 != rhStatus) {
+		lastRH = rhStatus;
+		return rhStatus;
 	}
+	convertHTUHumidity(reading);
 	//return 0 for success
-	return 0;
+	return status;
 }
-
@@ -24,23 +24,24 @@ bool initHTU21D();
 // Change HTU21D settings
 void changeHTU21D(char new_settings);
 
-//Read 12 bit temperature from the HTU21D
-//Update the temperature in the on-board module if calibration is true
-//Returns 0 on success, an error code on failure
-//Stores the sensor reading in internal variable htu_lastTemp;
-uint16_t senseHTU21DTemperature(bool calibration);
+//Start a 12 bit temperature conversion without waiting for it, so that
+//other sensing can be done meanwhile. The next senseHTU21D reads the
+//result instead of starting a conversion of its own.
+void startHTU21DTemperature();
 
-//Read 8-bit humidity from the HTU21D
+//Read 12 bit temperature and then 8-bit humidity from the HTU21D in one IIC
+//session, the humidity conversion starts as the temperature is read.
+//Update the temperature in the on-board module if calibration is true
 //Returns 0 on success, an error code on failure
-//Stores the sensor reading in internal variable lastRH;
-uint16_t senseHTU21DHumidity();
+//Stores the sensor readings or their error codes in internal variables
+//htu_lastTemp and lastRH;
+uint16_t senseHTU21D(bool calibration);
 
 //Used cached values unless updateCached is true.
 //Always senses when called for the first time.
-void doSenseHTURH16F(bool updateCached);
 //Set calibration to true if this should update the temperature in the
 //on-board temperature code module for recalibration after
 //temperature changes.
-void doSenseHTUTemp16F(bool updateCached, bool calibration);
+void doSenseHTU16F(bool updateCached, bool calibration);
 
 #endif /* HTU21D_H_ */
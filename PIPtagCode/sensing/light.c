@@ -8,7 +8,6 @@
 #include "light.h"
 
 uint8_t cached_light = 0;
-uint8_t* light_location;
 
 void doSenseAmbientLight(bool update) {
 	static bool first = true;
@@ -17,9 +16,7 @@ void doSenseAmbientLight(bool update) {
 		cached_light = relativeLightLevel();
 	}
 
-	light_location = malloc(1);
-	light_location[0] = ((uint8_t*) &cached_light)[0];
-
+	txFrame[FRAME_LIGHT] = cached_light;
 }
 
 volatile uint8_t ambient_val = 0;
@@ -13,7 +13,7 @@
 
 #include "../CC110x/definitions.h"
 #include "msp430.h"
-#include "../Owl/mem_pool.h"
+#include "../Owl/frame.h"
 
 
 
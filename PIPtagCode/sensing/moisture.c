@@ -169,7 +169,6 @@
 #include "../interrupt.h"
 
 uint16_t cached_moisture = 0;	// the saved value of the previous measurement
-uint8_t* moisture_location;		// pointer to the location used in the transmit buffer for moisture data
 
 /*
  *	Moisture Sensing Probe (main function)
@@ -246,9 +245,7 @@ void doMoistureSense(bool update) {
 		P2OUT = original_P2OUT;
 	}
 	// Save value to transmit buffer
-	moisture_location = malloc(2);
-	moisture_location[0] = ((uint8_t*) &cached_moisture)[1];
-	moisture_location[1] = ((uint8_t*) &cached_moisture)[0];
+	putFrame16(FRAME_MOISTURE, cached_moisture);
 
 }
 
@@ -470,6 +467,7 @@ uint16_t cm_getMoistureLevel(void) {
 	}
 
 #if CM_RAW_MEASUREMENT	// Return raw measurement value in timer counts WITHOUT calibration and scaling applied (useful for testing and manual calibration)
+	(void) scaled_value;
 	return measurement;
 #else
 	// Perform min/max scale limit safety checks and force the value to within the limits if it is out of the lower and upper bounds (limits set in "settings.h")
@@ -557,7 +555,7 @@ void crystalOn(uint8_t divider) {
 
 // Stops crystal oscillator output from radio and puts radio to sleep
 void crystalOff(void) {
-	// Reset GDO0 to high impedence tri-state as set by ReWriteCC1101Registers() in main.c
+	// Reset GDO0 to high impedence tri-state as set by writeRadioConfig() in CC110x/radio_config.c
 	TI_CC_SPIWriteReg(TI_CCxxx0_IOCFG0, 0x2E); // GDO0 output pin to high impedance 3-state
 	// Turn off crystal oscillator (typ. current consumption 0.22 mA)
 	TI_CC_SPIStrobe(TI_CCxxx0_SXOFF);
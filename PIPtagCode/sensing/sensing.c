@@ -6,16 +6,17 @@
  */
 
 #include "sensing.h"
+#include "../interrupt.h"
+#include "../Owl/scheduler.h"
 
 extern uint16_t numBinary;
-extern uint8_t* temp7_location;
 extern uint8_t last_temp7;
 
 /*
- * Rounds a double-precision to an integer.
+ * Rounds a 12.4 fixed point value to an integer, halves away from zero.
  */
-int round(double number) {
-	return (number >= 0) ? (int) (number + 0.5) : (int) (number - 0.5);
+int round16Fixed(int value) {
+	return (value >= 0) ? (value + 8) >> 4 : -((8 - value) >> 4);
 }
 
 /*
@@ -25,9 +26,41 @@ int round(double number) {
  * +------------+----+
  * |      12b   | 4b |
  * +------------+----+
+ * Truncates toward zero, as the conversion from float used to.
  */
-uint16_t to16Fixed(const float floatVal) {
-	return (uint16_t) (floatVal*16);
+int to16Fixed(long value, int fraction_bits) {
+	int shift = fraction_bits - 4;
+	return (value >= 0) ? (int) (value >> shift) : -(int) ((-value) >> shift);
+}
+
+unsigned long mulFixed(unsigned long constant, unsigned int x, int extra_bits) {
+	unsigned long low_mask = (1UL << extra_bits) - 1;
+	return (constant >> extra_bits) * x
+			+ (((constant & low_mask) * x) >> extra_bits);
+}
+
+long floatBitsToFixed(unsigned long bits, int fraction_bits) {
+	int exponent = (int) ((bits >> 23) & 0xFF);
+	//Zero, and denormals that are too small to matter
+	if (0 == exponent) {
+		return 0;
+	}
+	long mantissa = (bits & 0x7FFFFFL) | 0x800000L;
+	//Position of the lowest mantissa bit relative to the fixed point
+	int shift = exponent - 127 - 23 + fraction_bits;
+	long value;
+	if (shift >= 8) {
+		//Saturate values that do not fit
+		value = 0x7FFFFFFFL;
+	} else if (shift >= 0) {
+		value = mantissa << shift;
+	} else if (shift > -25) {
+		//Round to nearest
+		value = (mantissa + (1L << (-shift - 1))) >> -shift;
+	} else {
+		value = 0;
+	}
+	return (bits & 0x80000000UL) ? -value : value;
 }
 
 int senseBinary() {
@@ -68,17 +101,15 @@ bool doTemp7Binary(bool forceUpdate) {
 	uint8_t oldVal = lastBinary;
 
 //Byte for the temperature and binary data.
-//temp7_location is kept global so that the updateTemp7
+//It has a fixed place in the frame so that the updateTemp7
 //function can modify the temperature value in the future.
 //This supports filling in sensed data, then determining if
 //a packet will be transmitted, and only after then deciding
 //whether or not to sense temperature.
-	temp7_location = malloc(1);
 	if (forceUpdate || first_call) {
 		lastBinary = senseBinary();
 	}
-	temp7_location[0] |= lastBinary;
-	temp7_location[0] |= last_temp7 << 1;
+	txFrame[FRAME_TEMP7] = (last_temp7 << 1) | lastBinary;
 
 //If this is the first time the function is called then temperature
 //must be sensed.
@@ -95,3 +126,64 @@ bool doTemp7Binary(bool forceUpdate) {
 	return oldVal ^ lastBinary;
 }
 
+#if BINARY_EDGE_WAKE
+//Whether armBinaryEdge() gave the pins to the port interrupt
+static bool edgeArmed = false;
+//P1.2 bits of P1DIR, P1OUT and P1REN from before
+static uint8_t edgeP1Dir, edgeP1Out, edgeP1Ren;
+#endif
+
+void armBinaryEdge() {
+#if BINARY_EDGE_WAKE
+	//A closed switch would draw current through the pull-up
+	if (lastBinary) {
+		return;
+	}
+	edgeP1Dir = P1DIR & 0x04;
+	edgeP1Out = P1OUT & 0x04;
+	edgeP1Ren = P1REN & 0x04;
+	//Pull P1.2 up and drive P3.7 low, closing the switch pulls P1.2 down
+	P3REN &= ~(0x80);
+	P3OUT &= ~(0x80);
+	P3DIR |= 0x80;
+	P1DIR &= ~(0x04);
+	P1OUT |= 0x04;
+	P1REN |= 0x04;
+	//Falling edge, changing the edge select can set the flag
+	P1IES |= 0x04;
+	P1IFG &= ~(0x04);
+	edgeArmed = true;
+	binaryEdgeArmed = true;
+	P1IE |= 0x04;
+	//If the switch closed since it was last read there will be no edge
+	if (0 == (P1IN & 0x04)) {
+		P1IFG |= 0x04;
+	}
+#endif
+}
+
+bool disarmBinaryEdge() {
+#if BINARY_EDGE_WAKE
+	if (!edgeArmed) {
+		return false;
+	}
+	P1IE &= ~(0x04);
+	P1IFG &= ~(0x04);
+	binaryEdgeArmed = false;
+	//An edge after the sleep was over must not end the next one
+	AlarmAbort = 0;
+	bool edge = binaryEdgeSeen;
+	binaryEdgeSeen = false;
+	edgeArmed = false;
+	//Back to how senseBinary() leaves P3.7 and how P1.2 was
+	P3DIR &= ~(0x80);
+	P3REN |= 0x80;
+	P1OUT = (P1OUT & ~(0x04)) | edgeP1Out;
+	P1REN = (P1REN & ~(0x04)) | edgeP1Ren;
+	P1DIR = (P1DIR & ~(0x04)) | edgeP1Dir;
+	return edge;
+#else
+	return false;
+#endif
+}
+
@@ -13,18 +13,47 @@
 #include "../CC110x/definitions.h"
 #include "../CC110x/tuning.h"
 */
+#include "adc.h"
 #include "moisture.h"
 #include "battery.h"
 #include "light.h"
 #include "temperature.h"
 #include "htu21d.h"
+#include "supply.h"
 /*
 #include "../settings.h"
-#include "../Owl/mem_pool.h"
+#include "../Owl/frame.h"
 */
 
-uint16_t to16Fixed(float f);
-int round(double);
+/*
+ * Sensor math is done in fixed point because the MSP430 has no FPU.
+ * Sensed values are kept in the signed 12.4 format of the 16-bit packet
+ * fields, intermediate results in fixed point with more fraction bits.
+ */
+
+/*
+ * Convert a fixed point value with the given number of fraction bits to the
+ * 12.4 format, truncating toward zero.
+ */
+int to16Fixed(long value, int fraction_bits);
+
+/*
+ * Round a 12.4 value to the nearest integer.
+ */
+int round16Fixed(int value);
+
+/*
+ * Multiply a constant that has extra_bits more fraction bits than the result
+ * by x without overflowing 32 bits. (constant >> extra_bits) * x must fit.
+ */
+unsigned long mulFixed(unsigned long constant, unsigned int x, int extra_bits);
+
+/*
+ * Convert the bits of an IEEE-754 single precision float, such as the
+ * calibration values written by flash-temp.rb, to fixed point with the
+ * given number of fraction bits.
+ */
+long floatBitsToFixed(unsigned long bits, int fraction_bits);
 
 /*
  * Store the 7-bit temperature and 1-bit binary data.
@@ -36,6 +65,24 @@ bool doTemp7Binary(bool forceUpdate);
 
 int senseBinary();
 
+/*
+ * Last value of the binary input, 1 if the switch is closed.
+ */
+extern bool lastBinary;
+
+/*
+ * With BINARY_EDGE_WAKE, let the binary input closing end the next
+ * schedulerSleep() through the port 1 interrupt on P1.2. Only an open input is
+ * armed, a closed one is left to the BINARY_INTVL poll.
+ */
+void armBinaryEdge();
+
+/*
+ * Give the pins back after the sleep. Returns true if the input closed, it
+ * still has to be debounced and read with senseBinary().
+ */
+bool disarmBinaryEdge();
+
 
 
 #endif /* SENSING_H_ */
@@ -0,0 +1,35 @@
+/*
+ * supply.c
+ */
+
+#include "supply.h"
+#include "../Owl/scheduler.h"
+
+//Charge (nC) drawn from the supply capacitor that the cell has not put back yet
+uint32_t supplyDeficit = 0;
+
+void drawCharge(uint32_t charge_nc) {
+	if (SUPPLY_BUDGET_NC < supplyDeficit + charge_nc) {
+		//Recharge until the operation fits in the budget, or until the
+		//capacitor is full if the operation alone is larger than the budget
+		uint32_t missing = supplyDeficit + charge_nc - SUPPLY_BUDGET_NC;
+		if (missing > supplyDeficit) {
+			missing = supplyDeficit;
+		}
+		if (0 < missing) {
+			uint16_t gap_ms = (missing + RECHARGE_UA - 1) / RECHARGE_UA;
+			sleepMs(gap_ms);
+			rechargeSupply(gap_ms);
+		}
+	}
+	supplyDeficit += charge_nc;
+}
+
+void rechargeSupply(uint32_t ms) {
+	//uA * ms = nC
+	if (ms >= (supplyDeficit + RECHARGE_UA - 1) / RECHARGE_UA) {
+		supplyDeficit = 0;
+	} else {
+		supplyDeficit -= ms * RECHARGE_UA;
+	}
+}
@@ -0,0 +1,56 @@
+/*
+ * supply.h
+ *
+ * Model of the charge drawn from the supply capacitor during a round of
+ * sensing and transmission.
+ */
+
+#ifndef SUPPLY_H_
+#define SUPPLY_H_
+
+#include "../CC110x/definitions.h"
+#include "battery_costs.h"
+
+/*
+ * The coin cell cannot deliver the peak current of the sensors and the radio,
+ * which comes from the supply capacitor (C3 on the TPIP-K 1.1) instead. The
+ * capacitor has to recharge between bursts so that the supply does not drop
+ * too far. Rather than waiting a fixed time after every sensor, each
+ * operation books the charge it draws and a recharge gap is only inserted
+ * when the next operation would take more than SUPPLY_BUDGET_NC out of the
+ * capacitor.
+ */
+
+// Capacitance of the supply capacitor (uF)
+#define SUPPLY_CAP_UF 100
+// Drop of the supply voltage allowed during a round (mV)
+#define SUPPLY_DROOP_MV 300
+// Current the coin cell delivers into the capacitor while it recharges (uA)
+#define RECHARGE_UA 500
+
+// Charge (nC) that can be drawn before the drop reaches SUPPLY_DROOP_MV
+#define SUPPLY_BUDGET_NC ((uint32_t) SUPPLY_CAP_UF * SUPPLY_DROOP_MV)
+
+// Charge drawn by each operation (nC), from its cost in battery_costs.h at 3 V
+#define UJ_TO_NC(uj) ((uint32_t) (uj) * 1000 / 3)
+#define BINARY_CHARGE_NC (UJ_TO_NC(BIN_COST_X256) / 256)
+#define TEMP_CHARGE_NC (UJ_TO_NC(TEMP_COST_X128) / 128)
+#define LIGHT_CHARGE_NC UJ_TO_NC(LIGHT_COST)
+#define HTU21D_CHARGE_NC UJ_TO_NC(HTU21D_COST)
+#define RADIO_CHARGE_NC UJ_TO_NC(RADIO_COST)
+#define DOWNLINK_CHARGE_NC UJ_TO_NC(DOWNLINK_COST)
+// The moisture probe is clocked from the radio crystal, about 2 mA for 3 ms
+#define MOISTURE_CHARGE_NC 6000
+
+/*
+ * Call before an operation that draws the given charge. Sleeps until the
+ * capacitor has recharged enough for it, if needed, and books the charge.
+ */
+void drawCharge(uint32_t charge_nc);
+
+/*
+ * Credit the charge the coin cell puts back during the given time asleep.
+ */
+void rechargeSupply(uint32_t ms);
+
+#endif /* SUPPLY_H_ */
@@ -6,24 +6,21 @@
  */
 
 #include "temperature.h"
+#include "adc.h"
 
 extern uint16_t numTemp;
-uint8_t* temp16_location;
 uint16_t cached_temp16F = 0;
 
 /*
- * Raw ADC value for temperature.
+ * Temperature conversion slope value, degrees per ADC count with 26
+ * fraction bits.
  */
-int adc10_value;
-/*
- * Temperature conversion slope value.
- */
-double temperatureSlope = 0;
+long temperatureSlope = 0;
 
 /*
- * Temperature conversion offset value.
+ * Temperature conversion offset value, degrees with 20 fraction bits.
  */
-double temperatureOffset = 0;
+long temperatureOffset = 0;
 
 //Use when creating code for the flasher utility.
 //DEFAULT_SLOPE and DEFAULT_OFFSET are unique strings
@@ -33,14 +30,9 @@ double temperatureOffset = 0;
 unsigned long notTempSlope = DEFAULT_SLOPE;
 unsigned long notTempOffset = DEFAULT_OFFSET;
 
-float lastTemp = 0;
-float lastCalibrateTemp = 0;
-
-/*
- * Location where the 7 bit temperature should go if it is resampled
- * Used in the doTemp7Binary function.
- */
-uint8_t* temp7_location = 0;
+//Temperatures in 12.4 fixed point
+int lastTemp = 0;
+int lastCalibrateTemp = 0;
 
 /*
  * Storage for the last sampled 7-bit temperature value
@@ -53,8 +45,8 @@ void initTemperature() {
 	//Following two lines are for the flasher.
 	//Values are set with hex editor after compilation.
 	//Comment out following two lines when using code for programming individual tags using Code Composer.
-	temperatureSlope = *(double*) &notTempSlope;
-	temperatureOffset = *(double*) &notTempOffset;
+	temperatureSlope = floatBitsToFixed(notTempSlope, 26);
+	temperatureOffset = floatBitsToFixed(notTempOffset, 20);
 
 	//When programming with device specific calibration values,
 	//comment out two lines above and uncomment out the following two lines.
@@ -65,63 +57,38 @@ void initTemperature() {
 }
 
 int recalRadioFromTemp() {
-	float diff = lastTemp - lastCalibrateTemp;
+	int diff = lastTemp - lastCalibrateTemp;
 
-	if (abs(diff) > CALIBRATE_TEMP_DIFF) {
+	//Compare whole degrees
+	if (diff / 16 > CALIBRATE_TEMP_DIFF || diff / 16 < -CALIBRATE_TEMP_DIFF) {
 		lastCalibrateTemp += diff;
 		return 1;
 	}
 	return 0;
 }
 
-/*
- * Configure the ADC for temperature sensing.
- */
-void configADC() {
-	/*
-	 * Comment Format:		//Bits modified	//Bits' function				//Bits modified to...
-	 */
-
-	ADC10CTL0 = SREF_1 //Bits 15-13	//Select Reference				//R+ = VREF+ and VR- = VSS
-	+ REFON 	//Bit 5			//Reference generator on		//Reference on
-			+ ADC10SR + ADC10ON //Bit 4			//ADC10 on						//ADC10 on
-			+ ADC10SHT_3 //Bits 12-11	//ADC10 sample-and-hold time	//64 � ADC10CLKs
-			+ ADC10IE; //Enable interrupts when the ADC10MEM register gets a conversion result
-
-	ADC10CTL1 = INCH_10	//Bits 15-12	//Input channel select			//Temperature sensor
-	+ ADC10DIV_3;		//Bits 7-5		//ADC10 clock divider			///4
-}
-
-// ADC10 interrupt service routine so we sleep while waiting for the conversion to finish
-#pragma vector=ADC10_VECTOR
-__interrupt void ADC10_ISR(void) {
-	adc10_value = ADC10MEM;	//temporarily hold output value while shutting down adc.
-	_BIC_SR_IRQ(CPUOFF);
+uint8_t radioTempBucket() {
+	//Offset to keep HTU21D temperatures down to -47 C positive
+	return (lastTemp + 64 * 16) / (16 * CALIBRATE_TEMP_DIFF);
 }
 
 /*
  * Retrieve the ADC value and calculate the current temperature.
  */
-float getTemperature() {
+int getTemperature() {
 	++numTemp;
 //	shiftTempArray();
-	configADC();
-
-	__delay_cycles(100);	//wait for Vref to settle.  30 microseconds needed.
-
-	ADC10CTL0 |= ENC//Bit 1		//Enable conversion				//ADC10 enabled
-	+ ADC10SC;//Bit 0			//Start conversion				//Start sample-and-conversion
+	//Also converts the supply voltage if the battery is due this wake-up
+	adcSense(ADC_TEMPERATURE);
 
-	_BIS_SR(CPUOFF + GIE);
-	// LPM0, ADC12_ISR will force exit
-
-	ADC10CTL0 &= ~ENC;  //Bit 1			//Enable conversion bit--ADC10 disabled
-
-	ADC10CTL0 &= ~(REFON | ADC10ON); //turn off Reference and ADC.  Needed for low sleep power
-
-	// Save quarter of new value in array
-	lastTemp = (temperatureSlope * adc10_value + temperatureOffset
-			+ 40);
+	//Temperature with 20 fraction bits, the slope has 6 more
+	long slope;
+	if (temperatureSlope < 0) {
+		slope = -(long) mulFixed(-temperatureSlope, adc10_value, 6);
+	} else {
+		slope = mulFixed(temperatureSlope, adc10_value, 6);
+	}
+	lastTemp = to16Fixed(slope + temperatureOffset + (40L << 20), 20);
 	//the reported temperature is shifted up 40 degrees
 	//Valid temperature range -40C to 87C
 	//Matches chip temperature range.
@@ -129,14 +96,24 @@ float getTemperature() {
 	return lastTemp;
 }
 
+/*
+ * Value for the 16-bit temperature field.  In raw mode this is the ADC10 count
+ * of the last conversion so that the receiver can apply the calibration.
+ */
+uint16_t temp16Value(int temperature) {
+#if TEMP_RAW_MEASUREMENT
+	return adc10_value;
+#else
+	return temperature;
+#endif
+}
+
 void updateTemp16F(bool updateCached) {
 	if (updateCached) {
-		cached_temp16F = to16Fixed(getTemperature());
+		cached_temp16F = temp16Value(getTemperature());
 	} else {
-		cached_temp16F = to16Fixed(lastTemp);
+		cached_temp16F = temp16Value(lastTemp);
 	}
-//	temp16_location[0] = ((uint8_t*) &cached_temp16F)[1];
-//	temp16_location[1] = ((uint8_t*) &cached_temp16F)[0];
 }
 
 void doSenseTemp16F() {
@@ -144,21 +121,18 @@ void doSenseTemp16F() {
 
 	if (first) {
 		first = false;
-		cached_temp16F = to16Fixed(getTemperature());
+		cached_temp16F = temp16Value(getTemperature());
 	}
 
-	temp16_location = malloc(2);
-	temp16_location[0] = ((uint8_t*) &cached_temp16F)[1];
-	temp16_location[1] = ((uint8_t*) &cached_temp16F)[0];
+	putFrame16(FRAME_TEMP16, cached_temp16F);
 }
 
 void updateTemp7() {
-	if (0 != temp7_location) {
-		last_temp7 = round(getTemperature());
-		temp7_location[0] = (last_temp7 << 1) | (temp7_location[0] & 0x01);
-	}
+	last_temp7 = round16Fixed(getTemperature());
+	//Keep the binary bit that shares the byte
+	txFrame[FRAME_TEMP7] = (last_temp7 << 1) | (txFrame[FRAME_TEMP7] & 0x01);
 }
 
-void setLastTemp(float setVal) {
+void setLastTemp(int setVal) {
 	lastTemp = setVal;
 }
@@ -11,7 +11,7 @@
 #include "../CC110x/definitions.h"
 #include "../settings.h"
 #include "msp430.h"
-#include "../Owl/mem_pool.h"
+#include "../Owl/frame.h"
 #include "sensing.h"
 
 #define DEFAULT_SLOPE	0xACCADACA		//0xACCADACA default for automatic flashing
@@ -21,16 +21,18 @@
  */
 void initTemperature();
 /*
- * Configure the ADC for temperature readings.
+ * Get the current temperature value in 12.4 fixed point, shifted up 40
+ * degrees.
  */
-void configADC();
-/*
- * Get the current temperature value.
- */
-float getTemperature();
+int getTemperature();
 void updateTemp16F(bool);
 void doSenseTemp16F();
 int recalRadioFromTemp();
+/*
+ * Temperature bucket of the last temperature for the radio calibration
+ * cache, see recalibrateCC11xxCached() in CC110x/tuning.c.
+ */
+uint8_t radioTempBucket();
 /*
  * Update the 7-bit temperature used in the doTemp7Binary function.
  * Call doTemp7Binary before calling updateTemp7; updateTemp7 updates
@@ -42,6 +44,6 @@ void updateTemp7();
  * Used to set the temperature value if temperature is being sensed from
  * outside of this module.
  */
-void setLastTemp(float setVal);
+void setLastTemp(int setVal);
 
 #endif /* TEMPERATURE_H_ */
@@ -41,6 +41,7 @@
 #define MS_ONE_MINUTE		60000
 #define MS_NINETY_SECOND	90000
 #define MS_TWO_MINUTE		120000
+#define MS_TEN_MINUTE		600000
 #define MS_ONE_HOUR			3600000
 
 #define GRAIL_FREQ 		902004500		// center of range for rcvr set to 902.1 MHz per measurement REH 1/21/2013
@@ -48,6 +49,10 @@
 #define MID_BAND_FREQ 	915000000		//Center of ISM band. For GPIP to TPIP testing
 #define FCC_FREQ		922000000		//Approximate mid-range of the upper available band above GSM
 
+// Modem profiles for RADIO_PROFILE, register values in CC110x/radio_config.h
+#define RADIO_PROFILE_250K	0	// 250 kbps MSK, 541 kHz receive bandwidth
+#define RADIO_PROFILE_500K	1	// 500 kbps MSK, 812 kHz receive bandwidth
+
 
 
 //Change the next constants to alter the behavior of your pip
@@ -55,10 +60,6 @@
 //Insert numerical value for manual assignment of ID.
 #define TXER_ID 3377	//0xABBADABA is default ID for automatic flashing
 
-//The maximum delay (in ms) for any of the sense types to complete
-//and then wait 10ms to allow the capacitor to recharge.
-#define MAX_SENSE_DELAY 150
-
 #define ENABLE_BINARY 0			//Binary event from switch open/close (usually magnetic)
 #define ENABLE_TEMP16 0			//Temp sensor on MSP
 #define ENABLE_AMBIENT_LIGHT 1	//Using LED on board
@@ -78,6 +79,7 @@
 // Comment the below line to disable CRC in the packet
 #define PROTOCOL_VERSION 2	// Version 1 = 21-bit + parity ID, no CRC
 							// Version 2 = 24-bit, CRC enabled
+							// Version 3 = version 2 with bit packed fields (Owl/packed.h)
 
 // PA table settings for radio.
 // Sets transmit power level.
@@ -86,9 +88,27 @@
 // Radio frequency for transmissions
 #define DEFAULT_FREQ FCC_FREQ
 
-// How often MSP will wake up and check to see if sensing is required.
-// If WAKE_INTVL < PACKTINTVL_MS then MSP can go back to sleep without transmission.
-#define WAKE_INTVL MS_TEN_SECOND
+// Modem profile of the radio. Readers only hear tags with their own profile,
+// so they have to be set up with the same register values. The 500 kbps
+// profile halves the time on air at about 3 dB less range.
+#define RADIO_PROFILE RADIO_PROFILE_250K
+// Preamble length, NUM_PREAMBLE in MDMCFG1:
+// 0 = 2, 1 = 3, 2 = 4, 3 = 6, 4 = 8, 5 = 12, 6 = 16, 7 = 24 bytes
+#define RADIO_NUM_PREAMBLE 2
+
+// Channel plan. Channel n is n * RADIO_CHANNEL_STEP channels of CHANNR above
+// DEFAULT_FREQ, which is 800 kHz apart with the 250 kbps profile and 1.6 MHz
+// with the 500 kbps one (CHANNR steps are 200 kHz, CHANSPC in MDMCFG1/0).
+// With NUM_CHANNELS above 1 a tag picks channel (24 bit ID) % NUM_CHANNELS
+// unless it was optically programmed with one (KEY_CHAN in optical_conn.h),
+// so that the tags of a site are split evenly over readers on NUM_CHANNELS
+// channels. Above FCC_FREQ at most 8 channels, or 4 at 500 kbps, stay below
+// 928 MHz.
+#define NUM_CHANNELS 1
+
+// The MSP sleeps until the next transmission or sensing interval below is due
+// (see Owl/scheduler.c), so each interval can be chosen independently.
+// Intervals that are multiples of each other share wake-ups.
 
 // How frequently to transmit a packet when no data is "sensed"
 // This will be the "heartbeat" transmission period.
@@ -104,15 +124,69 @@
 #define SENSE_REPEAT_INTVL_1 MS_QUARTER_SECOND
 #define SENSE_REPEAT_INTVL_2 MS_HALF_SECOND
 
+// Tags that transmit at the same time collide at the receiver. With
+// TX_SLOT_OFFSET set to 1 each tag waits for its own slot in its packet
+// interval after power-on, picked from boardID, so that tags powered on together do
+// not start in lockstep. Every sleep, before background and repeat
+// transmissions alike, is then lengthened by a pseudo-random 0 to
+// TX_JITTER_MS - 1 milliseconds so that tags with similar clocks do not stay
+// on top of each other. TX_JITTER_MS is a power of two, 0 turns it off.
+#define TX_SLOT_OFFSET 1
+#define TX_JITTER_MS 32
+
+// Report by exception. When set, the tag only transmits when a sensed value
+// moved past its deadband since the last transmission, and otherwise sends a
+// heartbeat every REPORT_HEARTBEAT_MS instead of every PACKTINTVL_MS.
+// Changes are found at the next sensing interval of the sense type.
+// Packets sent because of a change have the changeReport header bit set.
+#define ENABLE_REPORT_ON_CHANGE 0
+// Longest time without a transmission in report by exception mode
+#define REPORT_HEARTBEAT_MS MS_TEN_MINUTE
+// Deadbands, a value has to move by more than this to be reported
+// Temperature in 1/16 degrees C, for both the MSP and the HTU21D
+// (ADC10 counts for the MSP with TEMP_RAW_MEASUREMENT)
+#define DEADBAND_TEMP16 8
+// Relative humidity in 1/16 %RH
+#define DEADBAND_RH16 32
+// Raw moisture counts
+#define DEADBAND_MOISTURE 16
+// Light level is compared in buckets of 2^LIGHT_BUCKET_SHIFT
+#define LIGHT_BUCKET_SHIFT 5
+
+// Batching. When above 1, the tag senses as usual but keeps the samples of up
+// to BATCH_SIZE transmission intervals and sends them in one packet, which
+// saves the preamble, sync word, ID and CRC of every packet it replaces.
+// Binary changes and battery reports are sent at once with the samples so far.
+// Batches must fit the 61 byte payload of the radio (see Owl/batch.h), about
+// 7 samples with light and HTU21D sensing. Not used with ENABLE_REPORT_ON_CHANGE.
+#define BATCH_SIZE 1
+
 // Recalibrate radio if temperature changes by this many degrees
 #define CALIBRATE_TEMP_DIFF 3
 // How frequently to recalibrate the radio even without temperature change.
 #define RECAL_INTVL MS_ONE_HOUR
+// Radio calibrations are kept for this many temperature buckets, each
+// CALIBRATE_TEMP_DIFF degrees wide. A temperature change back into a cached
+// bucket reuses its calibration, the RECAL_INTVL calibration always runs and
+// refreshes the current bucket. 0 turns the cache off.
+#define FSCAL_CACHE_SIZE 4
+// Cached calibrations older than this are redone
+#define FSCAL_CACHE_MAX_AGE (24 * MS_ONE_HOUR)
 
 // How frequently to poll the sensed "binary" data
 #define BINARY_INTVL MS_TEN_SECOND
+// If set to 1, a switch closing on the binary input wakes the tag through a
+// port interrupt on P1.2 instead of waiting for the next poll. A closed switch
+// would draw current through the pull-up, so its opening is still found by
+// the BINARY_INTVL poll: wire the switch so that the event to report closes it.
+#define BINARY_EDGE_WAKE 0
+// Time the binary input has to settle after an edge before it is read
+#define BINARY_DEBOUNCE_MS 20
 // How frequently to poll the temperature sensor on the MSP
 #define TEMP_INTVL MS_TEN_SECOND
+// If set to 1, the 16-bit temperature field carries the raw ADC10 count instead of fixed point degrees.
+// The receiver then applies the tag's slope and offset from its calibration file.
+#define TEMP_RAW_MEASUREMENT 0
 // Interval between "battery" transmissions
 #define SENSE_BATTERY_INTVL MS_ONE_HOUR
 // Interval between ambient light level
@@ -131,6 +205,39 @@
 //When battery gets low, internal resistance is high enough that flashing shuts down the tag prematurely
 #define PRODUCTION false
 
+// Battery-aware power policy. When set to 1, every battery sense moves the tag
+// between power levels by its supply voltage. Below POWER_LOW_MV the sensing
+// and transmit intervals are stretched by 2^POWER_LOW_STRETCH and the radio
+// sends at POWER_LOW_PATABLE, below POWER_CRITICAL_MV by 2^POWER_CRITICAL_STRETCH
+// at POWER_CRITICAL_PATABLE. A level is only left again once the supply is
+// POWER_HYSTERESIS_MV above its threshold. The LED is not flashed at startup
+// below normal, and frames sent below normal have the lowPower ExtHeader bit set.
+// The MSP430 browns out around 2.2V, see set_UCS() in main.c.
+#define ENABLE_POWER_POLICY 0
+#define POWER_LOW_MV 2600
+#define POWER_CRITICAL_MV 2400
+#define POWER_HYSTERESIS_MV 100
+#define POWER_LOW_STRETCH 1
+#define POWER_CRITICAL_STRETCH 2
+#define POWER_LOW_PATABLE PWR_0_5dBm
+#define POWER_CRITICAL_PATABLE PWR_m10_3dBm
+
+// Radio downlink. When set to 1, the radio turns to RX after every
+// DOWNLINK_EVERY-th transmission and listens for DOWNLINK_WINDOW_MS from the
+// start of the transmission for a command frame from a reader, see
+// Owl/downlink.h. A command carries the key-value pairs of the optical link
+// (optical_conn.h) to change the ID, frequency, interval, header, channel or
+// transmit power without touching the tag. Each window costs DOWNLINK_COST.
+#define ENABLE_DOWNLINK 0
+#define DOWNLINK_EVERY 60
+#define DOWNLINK_WINDOW_MS 3
+
+// Optical configuration at power-on. When set to 1, the tag looks for the light
+// of an optical programmer (opticalTransmit() in optical_conn.c) before it
+// starts and takes the same key-value pairs as a radio command from it. Without
+// a programmer this costs one light reading in LPM3.
+#define ENABLE_OPTICAL_CONFIG 1
+
 /*******************
  * History stuff
  *******************/
@@ -148,18 +255,6 @@
 /* End user-configurable stuff */
 
 
-/* How many wake-up counts between each sensing/calculation operation */
-#define BINARY_STEPS (BINARY_INTVL/WAKE_INTVL)
-#define TEMP_STEPS (TEMP_INTVL/WAKE_INTVL)
-#define AMBIENT_LIGHT_STEPS (AMBIENT_LIGHT_INTVL/WAKE_INTVL)
-#define MOISTURE_STEPS (MOISTURE_INTVL/WAKE_INTVL)
-#define HTU_STEPS (HTU_INTVL/WAKE_INTVL)
-#define BATTERY_STEPS (SENSE_BATTERY_INTVL/WAKE_INTVL)
-#define RECAL_STEPS (RECAL_INTVL/WAKE_INTVL)
-#define BACKGROUND_STEPS (PACKTINTVL/WAKE_INTVL)
-#define HISTORY_STEPS (HISTORY_INTVL/WAKE_INTVL)
-
-
 /* Moisture sensing */
 
 //Use capacitive moisture sensor, either commercial unit or any kind of probe that uses the high dielectric constant of water.
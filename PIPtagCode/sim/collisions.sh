@@ -0,0 +1,71 @@
+#!/bin/sh
+# Collision benchmark for dense deployments. Runs TAGS tags through pipsim,
+# all powered on at the same time with consecutive IDs and VLOs spread 10%
+# around 12 kHz, and counts the frames that overlap a frame of another tag
+# at the receiver on the same channel. Overlapping frames are all counted as
+# lost, there is no capture effect. The worst delivery rate of a single tag
+# shows tags that keep colliding with each other.
+#
+#   sh collisions.sh [tags] [seconds]          tags (1000) for seconds (3600)
+#   PIPSIM=/tmp/b/pipsim sh collisions.sh      another build, see Makefile
+#
+# Extra pipsim options can be passed in PIPSIM_ARGS.
+
+TAGS=${1:-1000}
+SECONDS_RUN=${2:-3600}
+PIPSIM=${PIPSIM:-$(dirname "$0")/build/pipsim}
+FIRST_ID=${FIRST_ID:-4096}
+
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+awk -v n="$TAGS" 'BEGIN { srand(1); for (i = 0; i < n; ++i) printf "%d %.0f\n", i, 12000 * (0.95 + 0.1 * rand()) }' |
+while read -r tag vlo; do
+	"$PIPSIM" -t "$SECONDS_RUN" -v --id $((FIRST_ID + tag)) --vlo "$vlo" $PIPSIM_ARGS |
+		awk -v tag="$tag" '$2 == "TX" && $4 == "bytes" {
+			channel = "channel" == $7 ? $8 + 0 : 0
+			printf "%.6f %.6f %d %d\n", $1, $1 + $5 / 1e6, tag, channel
+		}' >> "$OUT/frames" || exit 1
+done
+
+sort -g "$OUT/frames" | awk -v tags="$TAGS" '
+	{ start[NR] = $1; end[NR] = $2; tag[NR] = $3; channel[NR] = $4; ++sent[$3] }
+	END {
+		#A frame collides with the frame on its channel that ends last
+		#before it starts
+		for (i = 1; i <= NR; ++i) {
+			c = channel[i]
+			if ((c in latest) && start[i] < end[latest[c]]) {
+				hit[i] = 1
+				hit[latest[c]] = 1
+			}
+			if (!(c in latest) || end[i] > end[latest[c]]) {
+				latest[c] = i
+			}
+		}
+		channels = 0
+		for (c in latest) {
+			++channels
+		}
+		lost = 0
+		for (i in hit) {
+			++lost
+			++collided[tag[i]]
+		}
+		airtime = 0
+		for (i = 1; i <= NR; ++i) {
+			airtime += end[i] - start[i]
+		}
+		printf "%d tags on %d channels, %d frames, %d collided, %.2f%% delivered, load %.1f%% per channel\n",
+			tags, channels, NR, lost, NR ? 100 * (NR - lost) / NR : 0,
+			NR ? 100 * airtime / channels / (end[NR] > start[1] ? end[NR] - start[1] : 1) : 0
+		#A pair of tags stuck on top of each other shows in the worst tag
+		worst = 100
+		for (t in sent) {
+			delivered = 100 * (sent[t] - collided[t]) / sent[t]
+			if (delivered < worst) {
+				worst = delivered
+			}
+		}
+		printf "worst tag %.2f%% delivered\n", worst
+	}'
@@ -0,0 +1,422 @@
+/*
+ * msp430.h
+ *
+ * Stand-in for the TI device header when the firmware is built for the host
+ * simulator in PIPtagCode/sim. Every register of the MSP430G2553 that the
+ * firmware touches is a cell of a simulated register file and each access
+ * goes through sim_reg(), which charges the CPU time of the access and lets
+ * the simulated peripherals react to what the firmware wrote.
+ *
+ * Register cells hold the value little endian, as on the MSP430, so byte
+ * registers are the low byte of their cell. The simulator only runs on little
+ * endian hosts.
+ *
+ * Bit definitions are the ones of the TI header.
+ */
+
+#ifndef SIM_MSP430_H_
+#define SIM_MSP430_H_
+
+#ifndef __MSP430G2553__
+#define __MSP430G2553__
+#endif
+
+enum SimRegister {
+	/* Digital I/O */
+	SIM_P1IN, SIM_P1OUT, SIM_P1DIR, SIM_P1IFG, SIM_P1IES, SIM_P1IE,
+	SIM_P1SEL, SIM_P1SEL2, SIM_P1REN,
+	SIM_P2IN, SIM_P2OUT, SIM_P2DIR, SIM_P2IFG, SIM_P2IES, SIM_P2IE,
+	SIM_P2SEL, SIM_P2SEL2, SIM_P2REN,
+	SIM_P3IN, SIM_P3OUT, SIM_P3DIR, SIM_P3SEL, SIM_P3SEL2, SIM_P3REN,
+	/* Special function and clock system */
+	SIM_IE1, SIM_IFG1, SIM_IE2, SIM_IFG2,
+	SIM_DCOCTL, SIM_BCSCTL1, SIM_BCSCTL2, SIM_BCSCTL3,
+	SIM_CALDCO_1MHZ, SIM_CALBC1_1MHZ, SIM_CALDCO_12MHZ, SIM_CALBC1_12MHZ,
+	SIM_WDTCTL,
+	/* Comparator_A+ */
+	SIM_CACTL1, SIM_CACTL2, SIM_CAPD,
+	/* ADC10 */
+	SIM_ADC10AE0, SIM_ADC10CTL0, SIM_ADC10CTL1, SIM_ADC10MEM,
+	/* USCI */
+	SIM_UCA0CTL0, SIM_UCA0CTL1, SIM_UCA0BR0, SIM_UCA0BR1, SIM_UCA0MCTL,
+	SIM_UCA0STAT, SIM_UCA0RXBUF, SIM_UCA0TXBUF,
+	SIM_UCB0CTL0, SIM_UCB0CTL1, SIM_UCB0BR0, SIM_UCB0BR1,
+	SIM_UCB0STAT, SIM_UCB0RXBUF, SIM_UCB0TXBUF,
+	/* Timer0_A3 and Timer1_A3 */
+	SIM_TA0CTL, SIM_TA0R, SIM_TA0CCTL0, SIM_TA0CCTL1, SIM_TA0CCTL2,
+	SIM_TA0CCR0, SIM_TA0CCR1, SIM_TA0CCR2, SIM_TA0IV,
+	SIM_TA1CTL, SIM_TA1R, SIM_TA1CCTL0, SIM_TA1CCTL1, SIM_TA1CCTL2,
+	SIM_TA1CCR0, SIM_TA1CCR1, SIM_TA1CCR2, SIM_TA1IV,
+	SIM_NUM_REGISTERS
+};
+
+/* Returns the cell of a register after letting the simulation see the access */
+void* sim_reg(int reg);
+
+#define SIM_REG8(reg)	(*(volatile unsigned char*) sim_reg(reg))
+#define SIM_REG16(reg)	(*(volatile unsigned short*) sim_reg(reg))
+
+#define P1IN		SIM_REG8(SIM_P1IN)
+#define P1OUT		SIM_REG8(SIM_P1OUT)
+#define P1DIR		SIM_REG8(SIM_P1DIR)
+#define P1IFG		SIM_REG8(SIM_P1IFG)
+#define P1IES		SIM_REG8(SIM_P1IES)
+#define P1IE		SIM_REG8(SIM_P1IE)
+#define P1SEL		SIM_REG8(SIM_P1SEL)
+#define P1SEL2		SIM_REG8(SIM_P1SEL2)
+#define P1REN		SIM_REG8(SIM_P1REN)
+#define P2IN		SIM_REG8(SIM_P2IN)
+#define P2OUT		SIM_REG8(SIM_P2OUT)
+#define P2DIR		SIM_REG8(SIM_P2DIR)
+#define P2IFG		SIM_REG8(SIM_P2IFG)
+#define P2IES		SIM_REG8(SIM_P2IES)
+#define P2IE		SIM_REG8(SIM_P2IE)
+#define P2SEL		SIM_REG8(SIM_P2SEL)
+#define P2SEL2		SIM_REG8(SIM_P2SEL2)
+#define P2REN		SIM_REG8(SIM_P2REN)
+#define P3IN		SIM_REG8(SIM_P3IN)
+#define P3OUT		SIM_REG8(SIM_P3OUT)
+#define P3DIR		SIM_REG8(SIM_P3DIR)
+#define P3SEL		SIM_REG8(SIM_P3SEL)
+#define P3SEL2		SIM_REG8(SIM_P3SEL2)
+#define P3REN		SIM_REG8(SIM_P3REN)
+
+#define IE1			SIM_REG8(SIM_IE1)
+#define IFG1		SIM_REG8(SIM_IFG1)
+#define IE2			SIM_REG8(SIM_IE2)
+#define IFG2		SIM_REG8(SIM_IFG2)
+#define DCOCTL		SIM_REG8(SIM_DCOCTL)
+#define BCSCTL1		SIM_REG8(SIM_BCSCTL1)
+#define BCSCTL2		SIM_REG8(SIM_BCSCTL2)
+#define BCSCTL3		SIM_REG8(SIM_BCSCTL3)
+#define CALDCO_1MHZ	SIM_REG8(SIM_CALDCO_1MHZ)
+#define CALBC1_1MHZ	SIM_REG8(SIM_CALBC1_1MHZ)
+#define CALDCO_12MHZ	SIM_REG8(SIM_CALDCO_12MHZ)
+#define CALBC1_12MHZ	SIM_REG8(SIM_CALBC1_12MHZ)
+#define WDTCTL		SIM_REG16(SIM_WDTCTL)
+
+#define CACTL1		SIM_REG8(SIM_CACTL1)
+#define CACTL2		SIM_REG8(SIM_CACTL2)
+#define CAPD		SIM_REG8(SIM_CAPD)
+
+#define ADC10AE0	SIM_REG8(SIM_ADC10AE0)
+#define ADC10CTL0	SIM_REG16(SIM_ADC10CTL0)
+#define ADC10CTL1	SIM_REG16(SIM_ADC10CTL1)
+#define ADC10MEM	SIM_REG16(SIM_ADC10MEM)
+
+#define UCA0CTL0	SIM_REG8(SIM_UCA0CTL0)
+#define UCA0CTL1	SIM_REG8(SIM_UCA0CTL1)
+#define UCA0BR0		SIM_REG8(SIM_UCA0BR0)
+#define UCA0BR1		SIM_REG8(SIM_UCA0BR1)
+#define UCA0MCTL	SIM_REG8(SIM_UCA0MCTL)
+#define UCA0STAT	SIM_REG8(SIM_UCA0STAT)
+#define UCA0RXBUF	SIM_REG8(SIM_UCA0RXBUF)
+#define UCA0TXBUF	SIM_REG8(SIM_UCA0TXBUF)
+#define UCB0CTL0	SIM_REG8(SIM_UCB0CTL0)
+#define UCB0CTL1	SIM_REG8(SIM_UCB0CTL1)
+#define UCB0BR0		SIM_REG8(SIM_UCB0BR0)
+#define UCB0BR1		SIM_REG8(SIM_UCB0BR1)
+#define UCB0STAT	SIM_REG8(SIM_UCB0STAT)
+#define UCB0RXBUF	SIM_REG8(SIM_UCB0RXBUF)
+#define UCB0TXBUF	SIM_REG8(SIM_UCB0TXBUF)
+
+#define TA0CTL		SIM_REG16(SIM_TA0CTL)
+#define TA0R		SIM_REG16(SIM_TA0R)
+#define TA0CCTL0	SIM_REG16(SIM_TA0CCTL0)
+#define TA0CCTL1	SIM_REG16(SIM_TA0CCTL1)
+#define TA0CCTL2	SIM_REG16(SIM_TA0CCTL2)
+#define TA0CCR0		SIM_REG16(SIM_TA0CCR0)
+#define TA0CCR1		SIM_REG16(SIM_TA0CCR1)
+#define TA0CCR2		SIM_REG16(SIM_TA0CCR2)
+#define TA0IV		SIM_REG16(SIM_TA0IV)
+#define TA1CTL		SIM_REG16(SIM_TA1CTL)
+#define TA1R		SIM_REG16(SIM_TA1R)
+#define TA1CCTL0	SIM_REG16(SIM_TA1CCTL0)
+#define TA1CCTL1	SIM_REG16(SIM_TA1CCTL1)
+#define TA1CCTL2	SIM_REG16(SIM_TA1CCTL2)
+#define TA1CCR0		SIM_REG16(SIM_TA1CCR0)
+#define TA1CCR1		SIM_REG16(SIM_TA1CCR1)
+#define TA1CCR2		SIM_REG16(SIM_TA1CCR2)
+#define TA1IV		SIM_REG16(SIM_TA1IV)
+
+/* Timer0_A3 under its old names */
+#define TACTL		TA0CTL
+#define TAR			TA0R
+#define TACCTL0		TA0CCTL0
+#define TACCTL1		TA0CCTL1
+#define TACCTL2		TA0CCTL2
+#define TACCR0		TA0CCR0
+#define TACCR1		TA0CCR1
+#define TACCR2		TA0CCR2
+#define CCTL0		TA0CCTL0
+#define CCTL1		TA0CCTL1
+#define CCTL2		TA0CCTL2
+#define CCR0		TA0CCR0
+#define CCR1		TA0CCR1
+#define CCR2		TA0CCR2
+
+#define BIT0		(0x0001)
+#define BIT1		(0x0002)
+#define BIT2		(0x0004)
+#define BIT3		(0x0008)
+#define BIT4		(0x0010)
+#define BIT5		(0x0020)
+#define BIT6		(0x0040)
+#define BIT7		(0x0080)
+#define BIT8		(0x0100)
+#define BIT9		(0x0200)
+#define BITA		(0x0400)
+#define BITB		(0x0800)
+#define BITC		(0x1000)
+#define BITD		(0x2000)
+#define BITE		(0x4000)
+#define BITF		(0x8000)
+
+/* Status register */
+#define GIE			(0x0008)
+#define CPUOFF		(0x0010)
+#define OSCOFF		(0x0020)
+#define SCG0		(0x0040)
+#define SCG1		(0x0080)
+#define LPM0_bits	(CPUOFF)
+#define LPM1_bits	(SCG0+CPUOFF)
+#define LPM2_bits	(SCG1+CPUOFF)
+#define LPM3_bits	(SCG1+SCG0+CPUOFF)
+#define LPM4_bits	(SCG1+SCG0+OSCOFF+CPUOFF)
+
+/* Special function registers */
+#define WDTIE		(0x01)
+#define OFIE		(0x02)
+#define UCA0RXIE	(0x01)
+#define UCA0TXIE	(0x02)
+#define UCA0RXIFG	(0x01)
+#define UCA0TXIFG	(0x02)
+#define UCB0RXIFG	(0x04)
+#define UCB0TXIFG	(0x08)
+
+/* Watchdog timer */
+#define WDTPW		(0x5A00)
+#define WDTHOLD		(0x0080)
+#define WDTNMIES	(0x0040)
+#define WDTNMI		(0x0020)
+#define WDTTMSEL	(0x0010)
+#define WDTCNTCL	(0x0008)
+#define WDTSSEL		(0x0004)
+#define WDTIS1		(0x0002)
+#define WDTIS0		(0x0001)
+#define WDT_ADLY_1000	(WDTPW+WDTTMSEL+WDTCNTCL+WDTSSEL)
+#define WDT_ADLY_250	(WDTPW+WDTTMSEL+WDTCNTCL+WDTSSEL+WDTIS0)
+#define WDT_ADLY_16		(WDTPW+WDTTMSEL+WDTCNTCL+WDTSSEL+WDTIS1)
+#define WDT_ADLY_1_9	(WDTPW+WDTTMSEL+WDTCNTCL+WDTSSEL+WDTIS1+WDTIS0)
+
+/* Basic clock system */
+#define XT2OFF		(0x80)
+#define XTS			(0x40)
+#define DIVA_0		(0x00)
+#define DIVA_1		(0x10)
+#define DIVA_2		(0x20)
+#define DIVA_3		(0x30)
+#define SELM_0		(0x00)
+#define SELM_1		(0x40)
+#define SELM_2		(0x80)
+#define SELM_3		(0xC0)
+#define DIVM_0		(0x00)
+#define DIVM_1		(0x10)
+#define DIVM_2		(0x20)
+#define DIVM_3		(0x30)
+#define SELS		(0x08)
+#define DIVS_0		(0x00)
+#define DIVS_1		(0x02)
+#define DIVS_2		(0x04)
+#define DIVS_3		(0x06)
+#define LFXT1S_0	(0x00)
+#define LFXT1S_1	(0x10)
+#define LFXT1S_2	(0x20)
+#define LFXT1S_3	(0x30)
+#define XCAP_0		(0x00)
+#define XCAP_1		(0x04)
+#define XCAP_2		(0x08)
+#define XCAP_3		(0x0C)
+
+/* Comparator_A+ */
+#define CAEX		(0x80)
+#define CARSEL		(0x40)
+#define CAREF_0		(0x00)
+#define CAREF_1		(0x10)
+#define CAREF_2		(0x20)
+#define CAREF_3		(0x30)
+#define CAON		(0x08)
+#define CAIES		(0x04)
+#define CAIE		(0x02)
+#define CAIFG		(0x01)
+#define CASHORT		(0x80)
+#define P2CA4		(0x40)
+#define P2CA3		(0x20)
+#define P2CA2		(0x10)
+#define P2CA1		(0x08)
+#define P2CA0		(0x04)
+#define CAF			(0x02)
+#define CAOUT		(0x01)
+
+/* ADC10 */
+#define ADC10SC		(0x0001)
+#define ENC			(0x0002)
+#define ADC10IFG	(0x0004)
+#define ADC10IE		(0x0008)
+#define ADC10ON		(0x0010)
+#define REFON		(0x0020)
+#define REF2_5V		(0x0040)
+#define MSC			(0x0080)
+#define REFBURST	(0x0100)
+#define REFOUT		(0x0200)
+#define ADC10SR		(0x0400)
+#define ADC10SHT_0	(0x0000)
+#define ADC10SHT_1	(0x0800)
+#define ADC10SHT_2	(0x1000)
+#define ADC10SHT_3	(0x1800)
+#define SREF_0		(0x0000)
+#define SREF_1		(0x2000)
+#define SREF_2		(0x4000)
+#define SREF_3		(0x6000)
+#define SREF_7		(0xE000)
+#define ADC10BUSY	(0x0001)
+#define CONSEQ_0	(0x0000)
+#define ADC10SSEL_0	(0x0000)
+#define ADC10SSEL_1	(0x0008)
+#define ADC10SSEL_2	(0x0010)
+#define ADC10SSEL_3	(0x0018)
+#define ADC10DIV_0	(0x0000)
+#define ADC10DIV_1	(0x0020)
+#define ADC10DIV_2	(0x0040)
+#define ADC10DIV_3	(0x0060)
+#define ADC10DIV_4	(0x0080)
+#define ADC10DIV_5	(0x00A0)
+#define ADC10DIV_6	(0x00C0)
+#define ADC10DIV_7	(0x00E0)
+#define ISSH		(0x0100)
+#define ADC10DF		(0x0200)
+#define SHS_0		(0x0000)
+#define SHS_1		(0x0400)
+#define SHS_2		(0x0800)
+#define SHS_3		(0x0C00)
+#define INCH_0		(0x0000)
+#define INCH_1		(0x1000)
+#define INCH_2		(0x2000)
+#define INCH_3		(0x3000)
+#define INCH_4		(0x4000)
+#define INCH_5		(0x5000)
+#define INCH_6		(0x6000)
+#define INCH_7		(0x7000)
+#define INCH_10		(0xA000)
+#define INCH_11		(0xB000)
+
+/* USCI */
+#define UCCKPH		(0x80)
+#define UCCKPL		(0x40)
+#define UCMSB		(0x20)
+#define UC7BIT		(0x10)
+#define UCMST		(0x08)
+#define UCMODE_0	(0x00)
+#define UCSYNC		(0x01)
+#define UCPEN		(0x80)
+#define UCPAR		(0x40)
+#define UCSPB		(0x08)
+#define UCSSEL_0	(0x00)
+#define UCSSEL_1	(0x40)
+#define UCSSEL_2	(0x80)
+#define UCSSEL_3	(0xC0)
+#define UCSWRST		(0x01)
+#define UCBRS_0		(0x00)
+#define UCBRS_1		(0x02)
+#define UCBRF_0		(0x00)
+#define UCOS16		(0x01)
+#define UCBUSY		(0x01)
+
+/* Timer_A */
+#define TASSEL_0	(0x0000)
+#define TASSEL_1	(0x0100)
+#define TASSEL_2	(0x0200)
+#define TASSEL_3	(0x0300)
+#define ID_0		(0x0000)
+#define ID_1		(0x0040)
+#define ID_2		(0x0080)
+#define ID_3		(0x00C0)
+#define MC_0		(0x0000)
+#define MC_1		(0x0010)
+#define MC_2		(0x0020)
+#define MC_3		(0x0030)
+#define TACLR		(0x0004)
+#define TAIE		(0x0002)
+#define TAIFG		(0x0001)
+#define CM_0		(0x0000)
+#define CM_1		(0x4000)
+#define CM_2		(0x8000)
+#define CM_3		(0xC000)
+#define CCIS_0		(0x0000)
+#define CCIS_1		(0x1000)
+#define CCIS_2		(0x2000)
+#define CCIS_3		(0x3000)
+#define SCS			(0x0800)
+#define SCCI		(0x0400)
+#define CAP			(0x0100)
+#define OUTMOD_0	(0x0000)
+#define OUTMOD_1	(0x0020)
+#define OUTMOD_2	(0x0040)
+#define OUTMOD_3	(0x0060)
+#define OUTMOD_4	(0x0080)
+#define OUTMOD_5	(0x00A0)
+#define OUTMOD_6	(0x00C0)
+#define OUTMOD_7	(0x00E0)
+#define CCIE		(0x0010)
+#define CCI			(0x0008)
+#define OUT			(0x0004)
+#define COV			(0x0002)
+#define CCIFG		(0x0001)
+#define TA0IV_NONE		(0x0000)
+#define TA0IV_TACCR1	(0x0002)
+#define TA0IV_TACCR2	(0x0004)
+#define TA0IV_TAIFG		(0x000A)
+#define TA1IV_TAIFG		(0x000A)
+
+/* Interrupt vectors, only used by the ignored vector pragmas */
+#define PORT1_VECTOR		(2 * 2u)
+#define PORT2_VECTOR		(3 * 2u)
+#define ADC10_VECTOR		(5 * 2u)
+#define USCIAB0TX_VECTOR	(6 * 2u)
+#define USCIAB0RX_VECTOR	(7 * 2u)
+#define TIMER0_A1_VECTOR	(8 * 2u)
+#define TIMER0_A0_VECTOR	(9 * 2u)
+#define WDT_VECTOR			(10 * 2u)
+#define COMPARATORA_VECTOR	(11 * 2u)
+#define TIMER1_A1_VECTOR	(12 * 2u)
+#define TIMER1_A0_VECTOR	(13 * 2u)
+#define NMI_VECTOR			(14 * 2u)
+
+/* Compiler intrinsics */
+void sim_bis_sr(unsigned int bits);
+void sim_bic_sr_irq(unsigned int bits);
+void sim_delay_cycles(unsigned long cycles);
+
+#define __interrupt
+#define _BIS_SR(x)						sim_bis_sr(x)
+#define __bis_SR_register(x)			sim_bis_sr(x)
+#define _BIC_SR_IRQ(x)					sim_bic_sr_irq(x)
+#define __bic_SR_register_on_exit(x)	sim_bic_sr_irq(x)
+#define __enable_interrupt()			sim_bis_sr(GIE)
+#define _EINT()							sim_bis_sr(GIE)
+#define __delay_cycles(x)				sim_delay_cycles(x)
+#define _delay_cycles(x)				sim_delay_cycles(x)
+#define __no_operation()				sim_delay_cycles(1)
+#define _NOP()							sim_delay_cycles(1)
+
+#define LPM0		_BIS_SR(LPM0_bits + GIE)
+#define LPM0_EXIT	_BIC_SR_IRQ(LPM0_bits)
+#define LPM1		_BIS_SR(LPM1_bits + GIE)
+#define LPM1_EXIT	_BIC_SR_IRQ(LPM1_bits)
+#define LPM3		_BIS_SR(LPM3_bits + GIE)
+#define LPM3_EXIT	_BIC_SR_IRQ(LPM3_bits)
+
+/* The TI compiler treats abs() as a builtin, the firmware never includes stdlib.h */
+int abs(int);
+
+#endif /* SIM_MSP430_H_ */
@@ -0,0 +1,177 @@
+/*
+ * sim.h
+ *
+ * Host simulation of a tag: the firmware runs unmodified against a simulated
+ * MSP430G2553 register file, CC1101 radio, HTU21D sensor and the analog
+ * inputs of the board, while simulated time advances with every register
+ * access, busy wait and low power mode. The energy of every power state is
+ * integrated over that time.
+ *
+ * Only the simulator's own files include this header; the firmware sees the
+ * stand-in msp430.h in sim/include.
+ */
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "msp430.h"
+
+/* Simulation parameters, set from the command line */
+typedef struct {
+	//Seconds of tag time to simulate
+	double duration;
+	//Frequency of the VLO that clocks ACLK
+	double vlo_hz;
+	//Supply voltage at power-on, and at the end of the run for a supply
+	//that falls linearly
+	double vcc;
+	double vcc_end;
+	//Ambient temperature (C) and relative humidity (%)
+	double temperature;
+	double humidity;
+	//Amplitude (C) of a daily temperature cycle around temperature
+	double temp_swing;
+	//Light level as relativeLightLevel() would report it, 0 is dark
+	int light;
+	//Time the moisture probe takes to charge to the comparator reference
+	double moisture_us;
+	//Seconds between changes of the binary input, 0 leaves it open
+	double binary_period;
+	//Key-value pairs of a command that a reader sends in reply to every
+	//frame of the tag from downlink_at on, until the tag receives it
+	uint8_t downlink[32];
+	int downlink_length;
+	double downlink_at;
+	//Frame an optical programmer sends from power-on for optical_for seconds
+	uint8_t optical[32];
+	int optical_length;
+	double optical_for;
+	//Print every transmitted frame
+	bool verbose;
+} SimConfig;
+
+extern SimConfig sim_config;
+
+/* Seconds since power-on */
+extern double sim_now;
+/* Register cells and the status register of the simulated MSP430 */
+extern uint16_t sim_regs[SIM_NUM_REGISTERS];
+extern uint16_t sim_sr;
+
+/* Set when the simulation ends: the time limit passed or the firmware hung */
+extern jmp_buf sim_stop;
+void sim_fatal(const char* format, ...);
+
+typedef enum {
+	MCU_ACTIVE,
+	MCU_LPM0,
+	MCU_LPM1,
+	MCU_LPM3
+} SimMcuState;
+
+/* sim_core.c */
+void sim_reset(void);
+SimMcuState sim_mcu_state(void);
+double sim_mclk_hz(void);
+double sim_smclk_hz(void);
+double sim_aclk_hz(void);
+//Change a register from the peripheral side, not seen as a firmware write
+void sim_set_reg(int reg, uint16_t value);
+void sim_commit(void);
+void sim_advance_to(double t);
+void sim_cpu_cycles(double cycles);
+//An edge on a port 1 pin, sets P1IFG for the selected edge
+void sim_port1_edge(uint8_t bit, bool rising);
+//Level driven by the MSP430 on a port 1 pin, true if driven high or released
+bool sim_port1_drive(uint8_t bit);
+bool sim_binary_closed(void);
+//Ambient temperature now, following the daily cycle
+double sim_temperature(void);
+//Supply voltage now, falling from vcc to vcc_end over the run
+double sim_vcc(void);
+
+/* sim_timer.c */
+void timer_reset(void);
+void timer_write(int reg, uint16_t old, uint16_t value);
+void timer_inputs_changed(void);
+void timer_read(int reg);
+void timers_sync(double t);
+double timers_next_irq(void);
+//Force Timer0_A3 into the state SleepLPM3 leaves it in
+void timer_alarm_clock(uint16_t ccr0);
+
+/* sim_cc1101.c */
+typedef enum {
+	RF_SLEEP,
+	RF_XOSC_START,
+	RF_IDLE,
+	RF_XOFF,
+	RF_CALIBRATE,
+	RF_FS_SETTLE,
+	RF_FSTXON,
+	RF_TX,
+	RF_RX
+} RadioState;
+
+typedef struct {
+	unsigned long frames;
+	unsigned long bad_frames;
+	//Command frames the radio put in its RX FIFO
+	unsigned long commands;
+	unsigned long calibrations;
+	unsigned long wakeups;
+	unsigned long spi_bytes;
+	double airtime;
+} RadioStats;
+
+extern RadioStats radio_stats;
+
+void cc1101_reset(void);
+void cc1101_csn(bool high);
+//Exchange a byte that finishes shifting at the given time
+uint8_t cc1101_exchange(uint8_t mosi, double done);
+bool cc1101_so(void);
+double cc1101_gdo0_hz(void);
+RadioState cc1101_state(void);
+double cc1101_current_ma(void);
+double cc1101_next_event(void);
+void cc1101_update(void);
+
+/* sim_htu21d.c */
+extern unsigned long htu21d_measurements;
+void htu21d_reset(void);
+void htu21d_lines_changed(void);
+bool htu21d_sda(void);
+bool htu21d_scl(void);
+double htu21d_current_ma(void);
+double htu21d_next_event(void);
+void htu21d_update(void);
+
+/* sim_adc10.c */
+extern unsigned long adc10_conversions;
+void adc10_reset(void);
+void adc10_write(uint16_t old, uint16_t value);
+double adc10_current_ma(void);
+double comparator_current_ma(void);
+double adc10_next_event(void);
+void adc10_update(void);
+
+/* sim_optical.c */
+//Bytes the USCI_A0 received from the optical programmer
+extern unsigned long optical_bytes;
+void optical_reset(void);
+//Light level as relativeLightLevel() would report it now
+int sim_light(void);
+double optical_next_event(void);
+void optical_update(void);
+
+/* sim_energy.c */
+void energy_reset(void);
+void energy_integrate(double seconds);
+void energy_report(void);
+
+#endif /* SIM_H_ */
@@ -0,0 +1,92 @@
+/*
+ * sim_adc10.c
+ *
+ * ADC10 single conversions of the internal temperature sensor and of Vcc/2
+ * (sensing/adc.c), and the supply current of the ADC, its reference and
+ * Comparator_A+.
+ */
+
+#include <math.h>
+
+#include "sim.h"
+
+//Typical ADC10OSC frequency
+#define ADC10OSC_HZ 5e6
+//Supply currents (mA) from the MSP430G2553 datasheet
+#define REF_MA 0.25
+#define CONVERTING_MA 0.6
+#define COMPARATOR_MA 0.045
+
+unsigned long adc10_conversions;
+
+static double done_at;
+
+void adc10_reset(void) {
+	adc10_conversions = 0;
+	done_at = INFINITY;
+}
+
+static double input_volts(uint16_t ctl1) {
+	switch (ctl1 & 0xF000) {
+	case INCH_10:
+		//Temperature sensor, typical transfer function
+		return 0.00355 * sim_temperature() + 0.986;
+	case INCH_11:
+		return sim_vcc() / 2;
+	default:
+		return 0;
+	}
+}
+
+static uint16_t conversion_result(void) {
+	uint16_t ctl0 = sim_regs[SIM_ADC10CTL0];
+	double reference = sim_vcc();
+	if (SREF_1 == (ctl0 & SREF_7)) {
+		reference = (ctl0 & REF2_5V) ? 2.5 : 1.5;
+	}
+	double code = floor(input_volts(sim_regs[SIM_ADC10CTL1]) / reference * 1023 + 0.5);
+	return (uint16_t) fmin(1023, fmax(0, code));
+}
+
+void adc10_write(uint16_t old, uint16_t value) {
+	if ((value & ADC10SC) && (value & ENC) && (value & ADC10ON) && isinf(done_at)) {
+		static const int sample_cycles[4] = {4, 8, 16, 64};
+		uint16_t ctl1 = sim_regs[SIM_ADC10CTL1];
+		double adc_hz = ADC10OSC_HZ / (((ctl1 >> 5) & 0x07) + 1);
+		done_at = sim_now + (sample_cycles[(value >> 11) & 0x03] + 13) / adc_hz;
+		++adc10_conversions;
+	}
+	//ADC10SC resets itself
+	if (value & ADC10SC) {
+		sim_set_reg(SIM_ADC10CTL0, value & ~ADC10SC);
+	}
+	//Turning the ADC off aborts a conversion
+	if (!(value & ADC10ON)) {
+		done_at = INFINITY;
+	}
+}
+
+double adc10_current_ma(void) {
+	uint16_t ctl0 = sim_regs[SIM_ADC10CTL0];
+	double ma = (ctl0 & REFON) ? REF_MA : 0;
+	if (!isinf(done_at)) {
+		ma += CONVERTING_MA;
+	}
+	return ma;
+}
+
+double comparator_current_ma(void) {
+	return (sim_regs[SIM_CACTL1] & CAON) ? COMPARATOR_MA : 0;
+}
+
+double adc10_next_event(void) {
+	return done_at;
+}
+
+void adc10_update(void) {
+	if (done_at <= sim_now) {
+		done_at = INFINITY;
+		sim_set_reg(SIM_ADC10MEM, conversion_result());
+		sim_set_reg(SIM_ADC10CTL0, sim_regs[SIM_ADC10CTL0] | ADC10IFG);
+	}
+}
@@ -0,0 +1,609 @@
+/*
+ * sim_cc1101.c
+ *
+ * The CC1101 as the firmware sees it over SPI: configuration and status
+ * registers, command strobes, the TX FIFO and the main radio state machine
+ * with the timing and supply current of each state. Transmitted frames are
+ * checked for the mistakes that go unnoticed on a bench: a frequency
+ * synthesizer that was not calibrated for the programmed frequency and FIFO
+ * underflow when the firmware fills the FIFO after STX.
+ *
+ * A reader stand-in answers the frames of the tag with the command of
+ * --downlink. The command arrives REPLY_DELAY_S after the end of a frame and
+ * lands in the RX FIFO if the radio was in RX before it started.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sim.h"
+#include "settings.h"
+#include "CC110x/TI_CC_CC1100-CC2500.h"
+
+#define XOSC_HZ 26e6
+//State durations from the CC1101 datasheet, 26 MHz crystal
+#define XOSC_START_S 150e-6
+#define CALIBRATE_S 721e-6
+#define FS_SETTLE_S 88.4e-6
+//Supply currents (mA) from the CC1101 datasheet
+#define IDLE_MA 1.7
+#define XOFF_MA 0.165
+#define FS_MA 8.4
+#define RX_MA 15.4
+//Time a reader takes to answer a frame
+#define REPLY_DELAY_S 500e-6
+//RSSI (-60 dBm) and LQI status bytes appended to a received command
+#define REPLY_RSSI 28
+#define REPLY_LQI 20
+
+#define NUM_CONFIG 0x2F
+#define FIFO_SIZE 64
+
+RadioStats radio_stats;
+
+//Reset values of the configuration registers
+static const uint8_t config_defaults[NUM_CONFIG] = {
+	0x29, 0x2E, 0x3F, 0x07, 0xD3, 0x91, 0xFF, 0x04,
+	0x45, 0x00, 0x00, 0x0F, 0x00, 0x1E, 0xC4, 0xEC,
+	0x8C, 0x22, 0x02, 0x22, 0xF8, 0x47, 0x07, 0x30,
+	0x04, 0x36, 0x6C, 0x03, 0x40, 0x91, 0x87, 0x6B,
+	0xF8, 0x56, 0x10, 0xA9, 0x0A, 0x20, 0x0D, 0x41,
+	0x00, 0x59, 0x7F, 0x3F, 0x88, 0x31, 0x0B
+};
+
+//TX current of the PATABLE settings in settings.h, per the SWRA150 design note
+static const struct {
+	uint8_t setting;
+	double ma;
+} tx_currents[] = {
+	{PWR_9_9_dBm, 29.3}, {PWR_8_0_dBm, 26.0}, {PWR_6_0_dBm, 23.4},
+	{PWR_4_0_dBm, 18.6}, {PWR_3_0_dBm, 17.9}, {PWR_1_8_dBm, 17.1},
+	{PWR_0_5dBm, 16.3}, {PWR_m0_6dBm, 15.8}, {PWR_m3_1dBm, 14.1},
+	{PWR_m10_3dBm, 12.9}, {PWR_m20_0dBm, 11.7}, {PWR_m30_2dBm, 11.1},
+	{PWR_m60_4dBm, 10.3}
+};
+
+//Registers a calibration depends on
+static const uint8_t calibration_regs[] = {
+	TI_CCxxx0_FSCAL3, TI_CCxxx0_FSCAL2, TI_CCxxx0_FSCAL1, TI_CCxxx0_FSCAL0,
+	TI_CCxxx0_FREQ2, TI_CCxxx0_FREQ1, TI_CCxxx0_FREQ0, TI_CCxxx0_CHANNR,
+	TI_CCxxx0_TEST2, TI_CCxxx0_TEST1, TI_CCxxx0_TEST0
+};
+#define NUM_CALIBRATION_REGS sizeof(calibration_regs)
+
+static uint8_t config[NUM_CONFIG];
+static uint8_t patable[8];
+static int pa_index;
+
+static uint8_t tx_fifo[FIFO_SIZE];
+//Time each TX FIFO byte finished arriving over SPI
+static double tx_arrival[FIFO_SIZE];
+static int tx_count;
+
+static RadioState state;
+//End of a timed state, INFINITY for others
+static double state_end;
+//State that FS_SETTLE leads to
+static RadioState settle_target;
+static bool csn_low;
+//SPWD or SXOFF waiting for CSn to go high or the end of TX
+static RadioState pending_off;
+static bool pending;
+
+//SPI transaction state
+static bool have_header;
+static uint8_t header;
+static uint8_t address;
+
+//Calibration state
+static bool calibrated;
+static uint8_t calibration[NUM_CALIBRATION_REGS];
+
+static double tx_start;
+static bool tx_uncalibrated;
+static bool warned_pa;
+
+static uint8_t rx_fifo[FIFO_SIZE];
+static int rx_count;
+//Time the radio last entered RX
+static double rx_since;
+
+//Command frame of the reader stand-in, on air from reply_start to reply_end
+static uint8_t reply[FIFO_SIZE];
+static int reply_length;
+static double reply_start;
+static double reply_end;
+static bool reply_received;
+
+void cc1101_reset(void) {
+	memcpy(config, config_defaults, sizeof(config));
+	memset(patable, 0, sizeof(patable));
+	patable[0] = 0xC6;
+	pa_index = 0;
+	tx_count = 0;
+	rx_count = 0;
+	reply_start = INFINITY;
+	reply_end = -INFINITY;
+	reply_received = false;
+	//Powered up by the supply, not yet put to sleep by the firmware
+	state = RF_IDLE;
+	state_end = INFINITY;
+	csn_low = false;
+	pending = false;
+	have_header = false;
+	calibrated = false;
+	warned_pa = false;
+	memset(&radio_stats, 0, sizeof(radio_stats));
+}
+
+RadioState cc1101_state(void) {
+	return state;
+}
+
+static bool xosc_running(void) {
+	return RF_SLEEP != state && RF_XOFF != state && RF_XOSC_START != state;
+}
+
+double cc1101_current_ma(void) {
+	switch (state) {
+	case RF_SLEEP:
+		//Part of the tag's sleep current
+		return 0;
+	case RF_XOSC_START:
+	case RF_IDLE:
+		return IDLE_MA;
+	case RF_XOFF:
+		return XOFF_MA;
+	case RF_CALIBRATE:
+	case RF_FS_SETTLE:
+	case RF_FSTXON:
+		return FS_MA;
+	case RF_RX:
+		return RX_MA;
+	case RF_TX: {
+		uint8_t setting = patable[config[TI_CCxxx0_FREND0] & 0x07];
+		size_t i;
+		for (i = 0; i < sizeof(tx_currents) / sizeof(tx_currents[0]); ++i) {
+			if (tx_currents[i].setting == setting) {
+				return tx_currents[i].ma;
+			}
+		}
+		if (!warned_pa) {
+			fprintf(stderr, "sim: PATABLE setting 0x%02X has no known current, assuming the maximum\n", setting);
+			warned_pa = true;
+		}
+		return tx_currents[0].ma;
+	}
+	}
+	return 0;
+}
+
+//Crystal clock on GDO0 when IOCFG0 selects CLK_XOSC/n
+double cc1101_gdo0_hz(void) {
+	static const double dividers[16] = {
+		1, 1.5, 2, 3, 4, 6, 8, 12, 16, 24, 32, 48, 64, 96, 128, 192
+	};
+	uint8_t cfg = config[TI_CCxxx0_IOCFG0] & 0x3F;
+	if (cfg < 0x30 || !xosc_running()) {
+		return 0;
+	}
+	return XOSC_HZ / dividers[cfg - 0x30];
+}
+
+bool cc1101_so(void) {
+	//SO is CHIP_RDYn until the first SPI clock
+	return !xosc_running();
+}
+
+double cc1101_next_event(void) {
+	return state_end;
+}
+
+static double data_rate(void) {
+	int e = config[TI_CCxxx0_MDMCFG4] & 0x0F;
+	int m = config[TI_CCxxx0_MDMCFG3];
+	return (256.0 + m) * pow(2, e) / pow(2, 28) * XOSC_HZ;
+}
+
+//Bytes of preamble and sync word sent before the packet
+static int overhead_bytes(void) {
+	static const int preamble[8] = {2, 3, 4, 6, 8, 12, 16, 24};
+	int sync;
+	switch (config[TI_CCxxx0_MDMCFG2] & 0x07) {
+	case 0:
+	case 4:
+		sync = 0;
+		break;
+	case 3:
+	case 7:
+		sync = 4;
+		break;
+	default:
+		sync = 2;
+	}
+	return preamble[(config[TI_CCxxx0_MDMCFG1] >> 4) & 0x07] + sync;
+}
+
+//Bytes taken from the FIFO for a packet, length byte included
+static int packet_bytes(void) {
+	if (1 == (config[TI_CCxxx0_PKTCTRL0] & 0x03)) {
+		return 1 + (tx_count ? tx_fifo[0] : 0);
+	}
+	return config[TI_CCxxx0_PKTLEN];
+}
+
+static int crc_bytes(void) {
+	return (config[TI_CCxxx0_PKTCTRL0] & TI_CCxxx0_PKT_CRC_EN) ? 2 : 0;
+}
+
+static void enter(RadioState next, double duration) {
+	state = next;
+	state_end = isinf(duration) ? INFINITY : sim_now + duration;
+}
+
+static void sleep_now(RadioState off) {
+	//Registers 0x29-0x2E, PATABLE entries other than the first and the
+	//FIFOs are not retained in SLEEP
+	if (RF_SLEEP == off) {
+		memcpy(config + TI_CCxxx0_FSTEST, config_defaults + TI_CCxxx0_FSTEST, NUM_CONFIG - TI_CCxxx0_FSTEST);
+		memset(patable + 1, 0, sizeof(patable) - 1);
+	}
+	tx_count = 0;
+	rx_count = 0;
+	enter(off, INFINITY);
+}
+
+//RX until the reply of the reader stand-in is over, if one is coming
+static void enter_rx(void) {
+	rx_since = sim_now;
+	enter(RF_RX, reply_end > sim_now ? reply_end - sim_now : INFINITY);
+}
+
+//Have the reader stand-in answer the frame that just ended
+static void schedule_reply(const uint8_t* frame) {
+	if (!sim_config.downlink_length || reply_received || sim_now < sim_config.downlink_at) {
+		return;
+	}
+	//Length, the ID of the tag from its frame and the key-value pairs
+	reply[0] = 3 + sim_config.downlink_length;
+	memcpy(reply + 1, frame + 1, 3);
+	memcpy(reply + 4, sim_config.downlink, sim_config.downlink_length);
+	reply_length = 1 + reply[0];
+	reply_start = sim_now + REPLY_DELAY_S;
+	reply_end = reply_start + (overhead_bytes() + reply_length + crc_bytes()) * 8.0 / data_rate();
+}
+
+//The reply is over, it is received if the radio listened from its start
+static void finish_rx(void) {
+	if (rx_since <= reply_start && reply_end <= sim_now && rx_count + reply_length + 2 <= FIFO_SIZE) {
+		int i;
+		memcpy(rx_fifo + rx_count, reply, reply_length);
+		rx_count += reply_length;
+		if (config[TI_CCxxx0_PKTCTRL1] & 0x04) {
+			rx_fifo[rx_count++] = REPLY_RSSI;
+			rx_fifo[rx_count++] = 0x80 | REPLY_LQI;
+		}
+		reply_received = true;
+		++radio_stats.commands;
+		if (sim_config.verbose) {
+			printf("%12.6f RX %2d bytes:", reply_start, reply_length);
+			for (i = 0; i < reply_length; ++i) {
+				printf(" %02X", reply[i]);
+			}
+			printf("\n");
+		}
+		//RXOFF_MODE in MCSM1
+		if (3 == ((config[TI_CCxxx0_MCSM1] >> 2) & 0x03)) {
+			enter(RF_RX, INFINITY);
+		} else {
+			enter(RF_IDLE, INFINITY);
+		}
+	} else {
+		state_end = INFINITY;
+	}
+	reply_start = INFINITY;
+}
+
+static void start_tx(void) {
+	bool bad_cal = !calibrated;
+	size_t i;
+	for (i = 0; i < NUM_CALIBRATION_REGS && !bad_cal; ++i) {
+		bad_cal = calibration[i] != config[calibration_regs[i]];
+	}
+	tx_start = sim_now;
+	double airtime = (overhead_bytes() + packet_bytes() + crc_bytes()) * 8.0 / data_rate();
+	enter(RF_TX, airtime);
+	tx_uncalibrated = bad_cal;
+	if (bad_cal) {
+		fprintf(stderr, "sim: %.6f s: TX without a calibration for the current frequency registers\n", sim_now);
+	}
+}
+
+static void finish_tx(void) {
+	double byte_time = 8.0 / data_rate();
+	int needed = packet_bytes();
+	bool underflow = tx_count < needed;
+	int i;
+	for (i = 0; i < needed && i < tx_count && !underflow; ++i) {
+		//Each byte must be in the FIFO before the modulator reaches it
+		underflow = tx_arrival[i] > tx_start + (overhead_bytes() + i) * byte_time;
+	}
+	bool bad = underflow || tx_uncalibrated;
+	++radio_stats.frames;
+	radio_stats.bad_frames += bad;
+	radio_stats.airtime += sim_now - tx_start;
+	if (underflow) {
+		fprintf(stderr, "sim: %.6f s: TX FIFO underflow\n", sim_now);
+	}
+	schedule_reply(tx_fifo);
+	if (sim_config.verbose) {
+		printf("%12.6f TX %2d bytes %7.1f us%s%s", tx_start, needed, (sim_now - tx_start) * 1e6,
+				underflow ? " UNDERFLOW" : "", tx_uncalibrated ? " UNCALIBRATED" : "");
+		if (config[TI_CCxxx0_CHANNR]) {
+			printf(" channel %d", config[TI_CCxxx0_CHANNR]);
+		}
+		printf(":");
+		for (i = 0; i < needed && i < tx_count; ++i) {
+			printf(" %02X", tx_fifo[i]);
+		}
+		printf("\n");
+	}
+	//Bytes beyond the packet stay for the next one
+	if (needed < tx_count) {
+		memmove(tx_fifo, tx_fifo + needed, tx_count - needed);
+		memmove(tx_arrival, tx_arrival + needed, sizeof(double) * (tx_count - needed));
+		tx_count -= needed;
+	} else {
+		tx_count = 0;
+	}
+	//TXOFF_MODE in MCSM1
+	if (1 == (config[TI_CCxxx0_MCSM1] & 0x03)) {
+		enter(RF_FSTXON, INFINITY);
+	} else if (3 == (config[TI_CCxxx0_MCSM1] & 0x03)) {
+		enter_rx();
+	} else {
+		enter(RF_IDLE, INFINITY);
+	}
+}
+
+//A SPWD or SXOFF strobe takes effect once CSn is high and the radio is done
+//calibrating, settling or sending
+static void apply_pending(void) {
+	bool busy = RF_CALIBRATE == state || RF_FS_SETTLE == state || RF_TX == state;
+	if (pending && !csn_low && !busy) {
+		pending = false;
+		sleep_now(pending_off);
+	}
+}
+
+void cc1101_update(void) {
+	while (state_end <= sim_now) {
+		switch (state) {
+		case RF_XOSC_START:
+			enter(RF_IDLE, INFINITY);
+			break;
+		case RF_CALIBRATE: {
+			size_t i;
+			for (i = 0; i < NUM_CALIBRATION_REGS; ++i) {
+				calibration[i] = config[calibration_regs[i]];
+			}
+			calibrated = true;
+			++radio_stats.calibrations;
+			enter(RF_IDLE, INFINITY);
+			break;
+		}
+		case RF_FS_SETTLE:
+			if (RF_TX == settle_target) {
+				start_tx();
+			} else if (RF_RX == settle_target) {
+				enter_rx();
+			} else {
+				enter(settle_target, INFINITY);
+			}
+			break;
+		case RF_TX:
+			finish_tx();
+			break;
+		case RF_RX:
+			finish_rx();
+			break;
+		default:
+			state_end = INFINITY;
+		}
+	}
+	apply_pending();
+}
+
+void cc1101_csn(bool high) {
+	csn_low = !high;
+	have_header = false;
+	pa_index = 0;
+	if (!high && (RF_SLEEP == state || RF_XOFF == state)) {
+		if (RF_SLEEP == state) {
+			++radio_stats.wakeups;
+		}
+		enter(RF_XOSC_START, XOSC_START_S);
+	} else if (high) {
+		apply_pending();
+	}
+}
+
+static void strobe(uint8_t command) {
+	switch (command) {
+	case TI_CCxxx0_SRES:
+		memcpy(config, config_defaults, sizeof(config));
+		memset(patable, 0, sizeof(patable));
+		patable[0] = 0xC6;
+		tx_count = 0;
+		rx_count = 0;
+		calibrated = false;
+		enter(RF_IDLE, INFINITY);
+		break;
+	case TI_CCxxx0_SFSTXON:
+		if (RF_IDLE == state) {
+			settle_target = RF_FSTXON;
+			enter(RF_FS_SETTLE, FS_SETTLE_S);
+		}
+		break;
+	case TI_CCxxx0_SCAL:
+		if (RF_IDLE == state) {
+			enter(RF_CALIBRATE, CALIBRATE_S);
+		}
+		break;
+	case TI_CCxxx0_SRX:
+		if (RF_IDLE == state || RF_FSTXON == state) {
+			settle_target = RF_RX;
+			enter(RF_FS_SETTLE, FS_SETTLE_S);
+		}
+		break;
+	case TI_CCxxx0_STX:
+		if (RF_FSTXON == state) {
+			start_tx();
+		} else if (RF_IDLE == state) {
+			settle_target = RF_TX;
+			enter(RF_FS_SETTLE, FS_SETTLE_S);
+		}
+		break;
+	case TI_CCxxx0_SIDLE:
+		if (RF_TX == state) {
+			finish_tx();
+		}
+		pending = false;
+		enter(RF_IDLE, INFINITY);
+		break;
+	case TI_CCxxx0_SXOFF:
+	case TI_CCxxx0_SPWD:
+		pending = true;
+		pending_off = TI_CCxxx0_SPWD == command ? RF_SLEEP : RF_XOFF;
+		break;
+	case TI_CCxxx0_SFTX:
+		tx_count = 0;
+		break;
+	case TI_CCxxx0_SFRX:
+		rx_count = 0;
+		break;
+	}
+}
+
+//Status byte returned for every header and written data byte
+static uint8_t status_byte(bool tx) {
+	uint8_t value;
+	switch (state) {
+	case RF_RX:
+		value = 1;
+		break;
+	case RF_TX:
+		value = 2;
+		break;
+	case RF_FSTXON:
+		value = 3;
+		break;
+	case RF_CALIBRATE:
+		value = 4;
+		break;
+	case RF_FS_SETTLE:
+		value = 5;
+		break;
+	default:
+		value = 0;
+	}
+	int available = tx ? FIFO_SIZE - 1 - tx_count : 0;
+	return (xosc_running() ? 0 : 0x80) | (value << 4) | (available < 15 ? available : 15);
+}
+
+static uint8_t marcstate(void) {
+	switch (state) {
+	case RF_SLEEP:
+		return 0x00;
+	case RF_XOFF:
+		return 0x02;
+	case RF_CALIBRATE:
+		return 0x05;
+	case RF_FS_SETTLE:
+		return 0x0A;
+	case RF_FSTXON:
+		return 0x12;
+	case RF_TX:
+		return 0x13;
+	case RF_RX:
+		return 0x0D;
+	default:
+		return 0x01;
+	}
+}
+
+static uint8_t status_register(uint8_t addr) {
+	switch (addr) {
+	case 0x30:
+		//PARTNUM
+		return 0x00;
+	case 0x31:
+		//VERSION
+		return 0x14;
+	case TI_CCxxx0_MARCSTATE:
+		return marcstate();
+	case TI_CCxxx0_TXBYTES:
+		return tx_count;
+	case TI_CCxxx0_RXBYTES:
+		return rx_count;
+	default:
+		return 0;
+	}
+}
+
+uint8_t cc1101_exchange(uint8_t mosi, double done) {
+	++radio_stats.spi_bytes;
+	bool read = header & TI_CCxxx0_READ_SINGLE;
+	bool burst = header & TI_CCxxx0_WRITE_BURST;
+	if (!have_header) {
+		header = mosi;
+		address = mosi & 0x3F;
+		read = header & TI_CCxxx0_READ_SINGLE;
+		burst = header & TI_CCxxx0_WRITE_BURST;
+		if (0x30 <= address && address <= 0x3D && !(read && burst)) {
+			uint8_t status = status_byte(!read);
+			strobe(address);
+			return status;
+		}
+		have_header = true;
+		return status_byte(!read);
+	}
+	uint8_t miso = status_byte(!read);
+	if (TI_CCxxx0_TXFIFO == address && read) {
+		//RX FIFO
+		if (rx_count) {
+			miso = rx_fifo[0];
+			memmove(rx_fifo, rx_fifo + 1, --rx_count);
+		}
+	} else if (TI_CCxxx0_TXFIFO == address) {
+		if (tx_count < FIFO_SIZE) {
+			tx_fifo[tx_count] = mosi;
+			tx_arrival[tx_count] = done;
+			++tx_count;
+		}
+	} else if (TI_CCxxx0_PATABLE == address) {
+		if (read) {
+			miso = patable[pa_index];
+		} else {
+			patable[pa_index] = mosi;
+		}
+		pa_index = (pa_index + 1) & 0x07;
+	} else if (0x30 <= address) {
+		miso = status_register(address);
+	} else {
+		if (read) {
+			miso = config[address];
+		} else {
+			config[address] = mosi;
+		}
+		if (burst) {
+			address = (address + 1) % NUM_CONFIG;
+		}
+	}
+	//Single accesses take one data byte, bursts continue until CSn goes high
+	if (!burst) {
+		have_header = false;
+	}
+	return miso;
+}
@@ -0,0 +1,637 @@
+/*
+ * sim_core.c
+ *
+ * Register file, simulated time, low power modes and interrupt dispatch of
+ * the simulated MSP430G2553, and the alarm clock of AlarmClock-v1.2.asm.
+ *
+ * The firmware writes register cells directly through the pointer that
+ * sim_reg() returns, so writes are found afterwards: every access takes a
+ * snapshot of the cell and the next call into the simulator compares it with
+ * the cell. An access stays pending for two calls because in "A = B" the
+ * cell of A is fetched before B is read.
+ */
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sim.h"
+
+//Interrupt service routines of the firmware
+void TIMER1_A0_ISR(void);
+void TIMER1_A1_ISR(void);
+void TIMER0_A1_ISR(void);
+void ADC10_ISR(void);
+void USCIAB0RX_ISR(void);
+void p1interrupt(void);
+
+//MCLK cycles of one register access, an instruction with an absolute operand
+#define ACCESS_CYCLES 4
+//Interrupt entry and return
+#define ISR_CYCLES 11
+//Instructions of SleepLPM3 and its WDT interrupts
+#define ALARM_CYCLES 150
+//Interval of the alarm clock's WDT between sleeps, in ACLK cycles
+#define ALARM_WDT_CYCLES 64
+//Dispatches without the firmware making progress before giving up
+#define MAX_STORM 1000000
+
+SimConfig sim_config;
+double sim_now;
+uint16_t sim_regs[SIM_NUM_REGISTERS];
+uint16_t sim_sr;
+jmp_buf sim_stop;
+
+static bool in_isr;
+static uint16_t isr_sr;
+static unsigned long storm;
+
+//A register access whose write, if any, has not been seen yet
+typedef struct {
+	int reg;
+	uint16_t before;
+	int age;
+} Access;
+
+#define MAX_PENDING 8
+static Access pending[MAX_PENDING];
+static int num_pending;
+
+//Level of the CC1101's CSn pin
+static bool csn_high;
+
+/*
+ * USCI_B0 is double buffered: TXBUF is free again as soon as its byte moves
+ * to the shift register, and the received byte lands in RXBUF when the eight
+ * bits have been shifted. Bytes still shifting wait in a short queue.
+ */
+#define SPI_QUEUE 4
+static struct {
+	uint8_t miso;
+	double ready_at;
+} spi_queue[SPI_QUEUE];
+static int spi_queued;
+static double spi_txbuf_free;
+static double spi_shift_end;
+static bool spi_rx_flag;
+
+//Alarm clock state
+static double alarm_last_wake;
+static double alarm_at;
+static bool alarm_warned;
+//Set by the firmware to end SleepLPM3 early, a variable of the asm routine
+volatile unsigned short AlarmAbort;
+
+//Whether the closed binary input pulls P1.2 down to a low P3.7
+static bool binary_pulls_p12;
+
+void sim_fatal(const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	fprintf(stderr, "sim: %.6f s: ", sim_now);
+	vfprintf(stderr, format, args);
+	fputc('\n', stderr);
+	va_end(args);
+	longjmp(sim_stop, 2);
+}
+
+void sim_reset(void) {
+	memset(sim_regs, 0, sizeof(sim_regs));
+	sim_regs[SIM_WDTCTL] = 0x6900;
+	sim_regs[SIM_DCOCTL] = 0x60;
+	sim_regs[SIM_BCSCTL1] = 0x87;
+	sim_regs[SIM_CALDCO_1MHZ] = 0xB5;
+	sim_regs[SIM_CALBC1_1MHZ] = 0x86;
+	sim_regs[SIM_CALDCO_12MHZ] = 0x7A;
+	sim_regs[SIM_CALBC1_12MHZ] = 0x8E;
+	sim_regs[SIM_UCA0CTL1] = UCSWRST;
+	sim_regs[SIM_UCB0CTL0] = UCSYNC;
+	sim_regs[SIM_UCB0CTL1] = UCSWRST;
+	sim_sr = 0;
+	sim_now = 0;
+	in_isr = false;
+	storm = 0;
+	num_pending = 0;
+	csn_high = true;
+	spi_queued = 0;
+	spi_txbuf_free = 0;
+	spi_shift_end = 0;
+	spi_rx_flag = false;
+	alarm_last_wake = 0;
+	alarm_at = INFINITY;
+	alarm_warned = false;
+	AlarmAbort = 0;
+	binary_pulls_p12 = false;
+	timer_reset();
+	cc1101_reset();
+	htu21d_reset();
+	adc10_reset();
+	optical_reset();
+	energy_reset();
+}
+
+SimMcuState sim_mcu_state(void) {
+	if (in_isr || !(sim_sr & CPUOFF)) {
+		return MCU_ACTIVE;
+	}
+	if (sim_sr & SCG1) {
+		return MCU_LPM3;
+	}
+	return (sim_sr & SCG0) ? MCU_LPM1 : MCU_LPM0;
+}
+
+static double dco_hz(void) {
+	uint8_t bcs = sim_regs[SIM_BCSCTL1];
+	uint8_t dco = sim_regs[SIM_DCOCTL];
+	if (bcs == sim_regs[SIM_CALBC1_12MHZ] && dco == sim_regs[SIM_CALDCO_12MHZ]) {
+		return 12e6;
+	}
+	if (bcs == sim_regs[SIM_CALBC1_1MHZ] && dco == sim_regs[SIM_CALDCO_1MHZ]) {
+		return 1e6;
+	}
+	//Power-on setting
+	return 1.1e6;
+}
+
+double sim_mclk_hz(void) {
+	return dco_hz() / (1 << ((sim_regs[SIM_BCSCTL2] >> 4) & 3));
+}
+
+double sim_smclk_hz(void) {
+	if (MCU_LPM3 == sim_mcu_state()) {
+		return 0;
+	}
+	return dco_hz() / (1 << ((sim_regs[SIM_BCSCTL2] >> 1) & 3));
+}
+
+double sim_aclk_hz(void) {
+	//The board has no watch crystal, ACLK always runs from the VLO
+	return sim_config.vlo_hz / (1 << ((sim_regs[SIM_BCSCTL1] >> 4) & 3));
+}
+
+void sim_set_reg(int reg, uint16_t value) {
+	sim_regs[reg] = value;
+	int i;
+	for (i = 0; i < num_pending; ++i) {
+		if (pending[i].reg == reg) {
+			pending[i].before = value;
+		}
+	}
+}
+
+bool sim_port1_drive(uint8_t bit) {
+	uint8_t dir = sim_regs[SIM_P1DIR];
+	//Pins given to a peripheral are treated as driven low
+	if (sim_regs[SIM_P1SEL] & bit) {
+		return false;
+	}
+	return !(dir & bit) || (sim_regs[SIM_P1OUT] & bit);
+}
+
+void sim_port1_edge(uint8_t bit, bool rising) {
+	bool falling_selected = sim_regs[SIM_P1IES] & bit;
+	if (rising != falling_selected) {
+		sim_set_reg(SIM_P1IFG, sim_regs[SIM_P1IFG] | bit);
+	}
+}
+
+bool sim_binary_closed(void) {
+	if (sim_config.binary_period <= 0) {
+		return false;
+	}
+	return 1 == (long) floor(sim_now / sim_config.binary_period) % 2;
+}
+
+static double binary_next_change(void) {
+	if (sim_config.binary_period <= 0) {
+		return INFINITY;
+	}
+	return (floor(sim_now / sim_config.binary_period) + 1) * sim_config.binary_period;
+}
+
+//An edge on P1.2 when the binary input starts or stops pulling it down to
+//P3.7 while nothing else holds it low
+static void binary_lines_changed(void) {
+	bool p37_low = (sim_regs[SIM_P3DIR] & BIT7) && !(sim_regs[SIM_P3OUT] & BIT7) &&
+			!(sim_regs[SIM_P3SEL] & BIT7);
+	bool pulls = sim_binary_closed() && p37_low;
+	if (pulls != binary_pulls_p12) {
+		binary_pulls_p12 = pulls;
+		if (htu21d_scl()) {
+			sim_port1_edge(BIT2, !pulls);
+		}
+	}
+}
+
+double sim_temperature(void) {
+	return sim_config.temperature + sim_config.temp_swing * sin(2 * M_PI * sim_now / 86400);
+}
+
+double sim_vcc(void) {
+	return sim_config.vcc + (sim_config.vcc_end - sim_config.vcc) * fmin(1, sim_now / sim_config.duration);
+}
+
+//Move bytes that finished shifting into RXBUF
+static void spi_settle(void) {
+	int kept = 0;
+	int i;
+	for (i = 0; i < spi_queued; ++i) {
+		if (spi_queue[i].ready_at <= sim_now) {
+			sim_set_reg(SIM_UCB0RXBUF, spi_queue[i].miso);
+			spi_rx_flag = true;
+		} else {
+			spi_queue[kept++] = spi_queue[i];
+		}
+	}
+	spi_queued = kept;
+}
+
+//Outputs and pulled inputs of a port, other inputs read low
+static uint8_t port_level(int out_reg, int dir_reg, int ren_reg, int sel_reg) {
+	uint8_t out = sim_regs[out_reg];
+	uint8_t dir = sim_regs[dir_reg];
+	uint8_t ren = sim_regs[ren_reg];
+	uint8_t sel = sim_regs[sel_reg];
+	return (dir & ~sel & out) | (~dir & ren & out);
+}
+
+//Update registers whose value depends on the moment they are read
+static void refresh(int reg) {
+	uint8_t in;
+	switch (reg) {
+	case SIM_P1IN:
+		in = port_level(SIM_P1OUT, SIM_P1DIR, SIM_P1REN, SIM_P1SEL);
+		//HTU21D bus on P1.1 (SDA) and P1.2 (SCL)
+		in &= ~(BIT1 | BIT2);
+		in |= (htu21d_sda() ? BIT1 : 0) | (htu21d_scl() && !binary_pulls_p12 ? BIT2 : 0);
+		//CC1101 SO on P1.6 while CSn is low
+		if (!csn_high) {
+			in = (in & ~BIT6) | (cc1101_so() ? BIT6 : 0);
+		}
+		sim_regs[reg] = in;
+		break;
+	case SIM_P2IN:
+		sim_regs[reg] = port_level(SIM_P2OUT, SIM_P2DIR, SIM_P2REN, SIM_P2SEL);
+		break;
+	case SIM_P3IN:
+		in = port_level(SIM_P3OUT, SIM_P3DIR, SIM_P3REN, SIM_P3SEL);
+		//The binary input connects P1.2 to P3.7 when closed
+		if (!(sim_regs[SIM_P3DIR] & BIT7) && sim_binary_closed()) {
+			in = (in & ~BIT7) | ((sim_regs[SIM_P1DIR] & BIT2) && sim_port1_drive(BIT2) ? BIT7 : 0);
+		}
+		sim_regs[reg] = in;
+		break;
+	case SIM_IFG2:
+		spi_settle();
+		in = sim_regs[reg] & ~(UCB0TXIFG | UCB0RXIFG);
+		in |= (sim_now >= spi_txbuf_free ? UCB0TXIFG : 0) | (spi_rx_flag ? UCB0RXIFG : 0);
+		sim_regs[reg] = in;
+		break;
+	case SIM_UCA0RXBUF:
+		//Reading RXBUF clears UCA0RXIFG
+		sim_set_reg(SIM_IFG2, sim_regs[SIM_IFG2] & ~UCA0RXIFG);
+		break;
+	case SIM_UCB0RXBUF:
+		//Reading RXBUF clears UCB0RXIFG
+		spi_settle();
+		spi_rx_flag = false;
+		break;
+	case SIM_UCB0STAT:
+		sim_regs[reg] = (sim_regs[reg] & ~UCBUSY) | (sim_now < spi_shift_end ? UCBUSY : 0);
+		break;
+	case SIM_TA0R:
+	case SIM_TA0IV:
+	case SIM_TA1R:
+	case SIM_TA1IV:
+		timer_read(reg);
+		break;
+	}
+}
+
+//Exchange a byte with the CC1101 over USCI_B0
+static void spi_byte(uint8_t mosi) {
+	spi_settle();
+	unsigned int divider = sim_regs[SIM_UCB0BR0] | (sim_regs[SIM_UCB0BR1] << 8);
+	double smclk = sim_smclk_hz();
+	if (smclk <= 0) {
+		sim_fatal("SPI transfer without SMCLK");
+	}
+	double start = fmax(sim_now, spi_shift_end);
+	spi_txbuf_free = start;
+	spi_shift_end = start + 8.0 * (divider ? divider : 1) / smclk;
+	uint8_t miso = 0xFF;
+	if (!(sim_regs[SIM_UCB0CTL1] & UCSWRST) && !csn_high) {
+		miso = cc1101_exchange(mosi, spi_shift_end);
+	}
+	if (SPI_QUEUE == spi_queued) {
+		sim_fatal("SPI writes overrun the transmit buffer");
+	}
+	spi_queue[spi_queued].miso = miso;
+	spi_queue[spi_queued].ready_at = spi_shift_end;
+	++spi_queued;
+}
+
+static void write_reg(int reg, uint16_t old, uint16_t value) {
+	bool high;
+	switch (reg) {
+	case SIM_P1OUT:
+	case SIM_P1DIR:
+	case SIM_P1SEL:
+		htu21d_lines_changed();
+		break;
+	case SIM_P3OUT:
+	case SIM_P3DIR:
+	case SIM_P3SEL:
+		high = !(sim_regs[SIM_P3DIR] & BIT6) || (sim_regs[SIM_P3OUT] & BIT6);
+		if (high != csn_high) {
+			csn_high = high;
+			cc1101_csn(high);
+		}
+		binary_lines_changed();
+		timer_inputs_changed();
+		break;
+	case SIM_IFG2:
+		if ((old & UCB0RXIFG) && !(value & UCB0RXIFG)) {
+			spi_settle();
+			spi_rx_flag = false;
+		}
+		break;
+	case SIM_UCB0TXBUF:
+		spi_byte(value);
+		break;
+	case SIM_CACTL1:
+	case SIM_CACTL2:
+		timer_inputs_changed();
+		break;
+	case SIM_ADC10CTL0:
+		adc10_write(old, value);
+		break;
+	case SIM_TA0CTL:
+	case SIM_TA0R:
+	case SIM_TA0CCTL0:
+	case SIM_TA0CCTL1:
+	case SIM_TA0CCTL2:
+	case SIM_TA0CCR0:
+	case SIM_TA0CCR1:
+	case SIM_TA0CCR2:
+	case SIM_TA1CTL:
+	case SIM_TA1R:
+	case SIM_TA1CCTL0:
+	case SIM_TA1CCTL1:
+	case SIM_TA1CCTL2:
+	case SIM_TA1CCR0:
+	case SIM_TA1CCR1:
+	case SIM_TA1CCR2:
+		timer_write(reg, old, value);
+		break;
+	}
+}
+
+void sim_commit(void) {
+	int kept = 0;
+	int i;
+	for (i = 0; i < num_pending; ++i) {
+		int reg = pending[i].reg;
+		uint16_t before = pending[i].before;
+		uint16_t value = sim_regs[reg];
+		//The firmware never reads TXBUF, so every access is a write
+		if (SIM_UCB0TXBUF == reg) {
+			write_reg(reg, before, value);
+			continue;
+		}
+		if (value != before) {
+			pending[i].before = value;
+			write_reg(reg, before, value);
+		}
+		if (++pending[i].age < 2) {
+			pending[kept++] = pending[i];
+		}
+	}
+	num_pending = kept;
+}
+
+void sim_advance_to(double t) {
+	while (sim_now < t) {
+		double next = t;
+		next = fmin(next, cc1101_next_event());
+		next = fmin(next, htu21d_next_event());
+		next = fmin(next, adc10_next_event());
+		next = fmin(next, optical_next_event());
+		next = fmin(next, binary_next_change());
+		next = fmin(next, sim_config.duration);
+		energy_integrate(next - sim_now);
+		timers_sync(next);
+		sim_now = next;
+		cc1101_update();
+		htu21d_update();
+		adc10_update();
+		optical_update();
+		binary_lines_changed();
+		if (sim_now >= sim_config.duration) {
+			longjmp(sim_stop, 1);
+		}
+	}
+}
+
+void sim_cpu_cycles(double cycles) {
+	sim_advance_to(sim_now + cycles / sim_mclk_hz());
+}
+
+static void run_isr(void (*isr)(void)) {
+	if (MAX_STORM < ++storm) {
+		sim_fatal("interrupts keep firing without the firmware making progress");
+	}
+	//Entering an interrupt clears GIE and the low power mode bits
+	isr_sr = sim_sr;
+	sim_sr = 0;
+	in_isr = true;
+	sim_cpu_cycles(ISR_CYCLES);
+	isr();
+	sim_commit();
+	in_isr = false;
+	sim_sr = isr_sr;
+}
+
+//TA0_ISR of AlarmClock-v1.2.asm
+static void alarm_ta0_isr(void) {
+	sim_bic_sr_irq(LPM3_bits);
+}
+
+static bool flagged(int reg, uint16_t enable, uint16_t flag) {
+	return (sim_regs[reg] & (enable | flag)) == (enable | flag);
+}
+
+//Service the highest priority pending interrupt, returns false if there is none
+static bool dispatch(void) {
+	if (!(sim_sr & GIE) || in_isr) {
+		return false;
+	}
+	//The alarm clock's WDT and Timer_A interrupts while SleepLPM3 runs
+	if (alarm_at <= sim_now) {
+		alarm_at = INFINITY;
+		run_isr(alarm_ta0_isr);
+		return true;
+	}
+	if (flagged(SIM_TA1CCTL0, CCIE, CCIFG)) {
+		sim_set_reg(SIM_TA1CCTL0, sim_regs[SIM_TA1CCTL0] & ~CCIFG);
+		run_isr(TIMER1_A0_ISR);
+		return true;
+	}
+	if (flagged(SIM_TA1CCTL1, CCIE, CCIFG) || flagged(SIM_TA1CCTL2, CCIE, CCIFG) ||
+			flagged(SIM_TA1CTL, TAIE, TAIFG)) {
+		run_isr(TIMER1_A1_ISR);
+		return true;
+	}
+	if (flagged(SIM_TA0CCTL0, CCIE, CCIFG)) {
+		sim_set_reg(SIM_TA0CCTL0, sim_regs[SIM_TA0CCTL0] & ~CCIFG);
+		run_isr(alarm_ta0_isr);
+		return true;
+	}
+	if (flagged(SIM_TA0CCTL1, CCIE, CCIFG) || flagged(SIM_TA0CCTL2, CCIE, CCIFG) ||
+			flagged(SIM_TA0CTL, TAIE, TAIFG)) {
+		run_isr(TIMER0_A1_ISR);
+		return true;
+	}
+	if ((sim_regs[SIM_IE2] & UCA0RXIE) && (sim_regs[SIM_IFG2] & UCA0RXIFG)) {
+		run_isr(USCIAB0RX_ISR);
+		return true;
+	}
+	if (flagged(SIM_ADC10CTL0, ADC10IE, ADC10IFG)) {
+		sim_set_reg(SIM_ADC10CTL0, sim_regs[SIM_ADC10CTL0] & ~ADC10IFG);
+		run_isr(ADC10_ISR);
+		return true;
+	}
+	if (sim_regs[SIM_P2IE] & sim_regs[SIM_P2IFG]) {
+		sim_fatal("PORT2 interrupt has no handler");
+	}
+	if (sim_regs[SIM_P1IE] & sim_regs[SIM_P1IFG]) {
+		run_isr(p1interrupt);
+		return true;
+	}
+	return false;
+}
+
+//Sleep until an interrupt clears CPUOFF
+static void lpm_wait(void) {
+	while (sim_sr & CPUOFF) {
+		if (dispatch()) {
+			continue;
+		}
+		if (!(sim_sr & GIE)) {
+			sim_fatal("the CPU sleeps with interrupts disabled");
+		}
+		double next = fmin(cc1101_next_event(), htu21d_next_event());
+		next = fmin(next, adc10_next_event());
+		next = fmin(next, optical_next_event());
+		next = fmin(next, timers_next_irq());
+		next = fmin(next, alarm_at);
+		next = fmin(next, binary_next_change());
+		if (isinf(next)) {
+			sim_fatal("the CPU sleeps with nothing that could wake it up");
+		}
+		//Rounding can put a timer event a hair before now
+		if (next <= sim_now) {
+			next = sim_now + 1e-9;
+		}
+		sim_advance_to(next);
+		storm = 0;
+	}
+}
+
+void* sim_reg(int reg) {
+	sim_commit();
+	sim_cpu_cycles(ACCESS_CYCLES);
+	if (!dispatch() && !in_isr) {
+		storm = 0;
+	}
+	refresh(reg);
+	if (MAX_PENDING == num_pending) {
+		memmove(pending, pending + 1, sizeof(Access) * (MAX_PENDING - 1));
+		--num_pending;
+	}
+	pending[num_pending].reg = reg;
+	pending[num_pending].before = sim_regs[reg];
+	pending[num_pending].age = 0;
+	++num_pending;
+	return &sim_regs[reg];
+}
+
+void sim_bis_sr(unsigned int bits) {
+	sim_commit();
+	sim_sr |= bits;
+	lpm_wait();
+}
+
+void sim_bic_sr_irq(unsigned int bits) {
+	if (in_isr) {
+		isr_sr &= ~bits;
+	} else {
+		sim_sr &= ~bits;
+	}
+}
+
+void sim_delay_cycles(unsigned long cycles) {
+	sim_commit();
+	sim_cpu_cycles(cycles);
+}
+
+/*
+ * Busy wait of TI_CC_spi.c, which costs about one MCLK cycle per count.
+ * The firmware's copy is linked as a weak symbol so that the waits take
+ * simulated time.
+ */
+void TI_CC_Wait(unsigned int cycles) {
+	sim_commit();
+	sim_cpu_cycles(cycles);
+}
+
+/*
+ * AlarmClock-v1.2.asm. AlrmClkStrt starts the WDT, which interrupts every
+ * 64 ACLK cycles. SleepLPM3(n) sleeps until n ACLK cycles after the end of the
+ * previous sleep: it waits for the next WDT interrupt, counts the rest of the
+ * delay with the WDT at several intervals and the last 4-67 cycles with
+ * Timer0_A3. An interrupt that sets AlarmAbort ends the sleep at once, or at
+ * the next WDT interrupt if it came before the CPU went to sleep.
+ */
+void AlrmClkStrt(void) {
+	sim_commit();
+	alarm_last_wake = sim_now;
+	sim_sr |= GIE;
+}
+
+void SleepLPM3(long aclk_cycles) {
+	sim_commit();
+	sim_cpu_cycles(ALARM_CYCLES);
+	double aclk = sim_aclk_hz();
+	double period = ALARM_WDT_CYCLES / aclk;
+	long intervals = (long) floor((sim_now - alarm_last_wake) / period);
+	long remaining = aclk_cycles - ALARM_WDT_CYCLES * intervals - 132;
+	double wake = alarm_last_wake + aclk_cycles / aclk;
+	if (remaining < 0) {
+		//The asm routine would wrap around and sleep for hours
+		if (!alarm_warned) {
+			fprintf(stderr, "sim: %.6f s: SleepLPM3(%ld) called %.2f ms after the last wake-up\n",
+					sim_now, aclk_cycles, (sim_now - alarm_last_wake) * 1e3);
+			alarm_warned = true;
+		}
+		wake = alarm_last_wake + (intervals + 1) * period + (ALARM_WDT_CYCLES + 4) / aclk;
+	}
+	if (AlarmAbort) {
+		sim_advance_to(alarm_last_wake + (intervals + 1) * period);
+	} else {
+		timer_alarm_clock((remaining & 0x3F) + 4);
+		alarm_at = wake;
+		while (sim_now < wake && !AlarmAbort) {
+			sim_sr |= LPM3_bits | GIE;
+			lpm_wait();
+		}
+		alarm_at = INFINITY;
+	}
+	if (sim_now < wake) {
+		//AlarmStop stops Timer0_A3 and restarts the WDT
+		AlarmAbort = 0;
+		sim_set_reg(SIM_TA0CTL, sim_regs[SIM_TA0CTL] & ~MC_3);
+	}
+	alarm_last_wake = sim_now;
+}
@@ -0,0 +1,163 @@
+/*
+ * sim_energy.c
+ *
+ * Integrates the supply current of every part of the tag over simulated time
+ * and reports the energy per wake-up and the battery life it projects, next
+ * to the estimate that getUsedJoules() in sensing/battery.c makes from its
+ * table of operation costs.
+ */
+
+#include <stdio.h>
+
+#include "sim.h"
+#include "settings.h"
+#include "sensing/battery_costs.h"
+
+//MSP430G2553 supply current per MHz of DCO (mA), active and in LPM0/1
+#define ACTIVE_MA_PER_MHZ 0.25
+#define LPM0_MA_PER_MHZ 0.056
+
+//Firmware counters, uint32_t is unsigned long in CC110x/definitions.h
+extern unsigned long numBinary;
+extern unsigned long numTemp;
+extern unsigned long numHTU;
+extern unsigned long numBattery;
+extern unsigned long numRadio;
+extern unsigned long numLight;
+extern unsigned long numWakeup;
+extern unsigned long numHistory;
+extern unsigned long numDownlink;
+unsigned long getUptimeSeconds(void);
+unsigned short getUsedJoules(void);
+
+typedef enum {
+	E_SLEEP,
+	E_MCU_ACTIVE,
+	E_MCU_LPM0,
+	E_RADIO_IDLE,
+	E_RADIO_SYNTH,
+	E_RADIO_TX,
+	E_RADIO_RX,
+	E_ADC,
+	E_COMPARATOR,
+	E_HTU,
+	NUM_CATEGORIES
+} Category;
+
+static const char* category_names[NUM_CATEGORIES] = {
+	"sleep (battery.c floor)",
+	"MCU active",
+	"MCU LPM0/1",
+	"radio idle/XOSC",
+	"radio calibrate/FS",
+	"radio TX",
+	"radio RX",
+	"ADC10 and reference",
+	"comparator",
+	"HTU21D"
+};
+
+//Energy of each category (uJ) and time spent in each MCU state (s)
+static double energy[NUM_CATEGORIES];
+static double mcu_time[4];
+
+void energy_reset(void) {
+	int i;
+	for (i = 0; i < NUM_CATEGORIES; ++i) {
+		energy[i] = 0;
+	}
+	for (i = 0; i < 4; ++i) {
+		mcu_time[i] = 0;
+	}
+}
+
+static Category radio_category(RadioState state) {
+	switch (state) {
+	case RF_CALIBRATE:
+	case RF_FS_SETTLE:
+	case RF_FSTXON:
+		return E_RADIO_SYNTH;
+	case RF_TX:
+		return E_RADIO_TX;
+	case RF_RX:
+		return E_RADIO_RX;
+	default:
+		return E_RADIO_IDLE;
+	}
+}
+
+void energy_integrate(double seconds) {
+	if (seconds <= 0) {
+		return;
+	}
+	//mA * V * s = mJ
+	double uj_per_ma = sim_vcc() * seconds * 1e3;
+	SimMcuState mcu = sim_mcu_state();
+	mcu_time[mcu] += seconds;
+	//The measured sleep cost covers LPM3 and the radio and sensor sleeping
+	energy[E_SLEEP] += SLEEP_COST_1SECOND_x100 / 100.0 * seconds;
+	double mhz = sim_mclk_hz() / 1e6;
+	if (MCU_ACTIVE == mcu) {
+		energy[E_MCU_ACTIVE] += ACTIVE_MA_PER_MHZ * mhz * uj_per_ma;
+	} else if (MCU_LPM3 != mcu) {
+		energy[E_MCU_LPM0] += LPM0_MA_PER_MHZ * mhz * uj_per_ma;
+	}
+	energy[radio_category(cc1101_state())] += cc1101_current_ma() * uj_per_ma;
+	energy[E_ADC] += adc10_current_ma() * uj_per_ma;
+	energy[E_COMPARATOR] += comparator_current_ma() * uj_per_ma;
+	energy[E_HTU] += htu21d_current_ma() * uj_per_ma;
+}
+
+//Energy that getUsedJoules() charges for the counts so far, in uJ
+static double firmware_estimate(unsigned long htu, unsigned long light) {
+	double uj = numBinary * BIN_COST_X256 / 256.0;
+	uj += numTemp * TEMP_COST_X128 / 128.0;
+	uj += numBattery * BATT_COST_X512 / 512.0;
+	uj += numRadio * (double) RADIO_COST;
+	uj += numHistory * (double) RADIO_COST_HISTORY;
+	uj += light * (double) LIGHT_COST;
+	uj += htu * (double) HTU21D_COST;
+	uj += numDownlink * (double) DOWNLINK_COST;
+	uj += getUptimeSeconds() * SLEEP_COST_1SECOND_x100 / 100.0;
+	return uj;
+}
+
+void energy_report(void) {
+	double total = 0;
+	int i;
+	for (i = 0; i < NUM_CATEGORIES; ++i) {
+		total += energy[i];
+	}
+	double seconds = sim_now;
+	double average_uw = 0 < seconds ? total / seconds : 0;
+	unsigned long wakeups = numWakeup ? numWakeup : 1;
+
+	printf("Simulated %.1f s, %lu wake-ups, %lu frames (%lu bad), %lu radio calibrations\n",
+			seconds, numWakeup, radio_stats.frames, radio_stats.bad_frames, radio_stats.calibrations);
+	printf("MCU time: active %.3f s, LPM0/1 %.3f s, LPM3 %.3f s\n",
+			mcu_time[MCU_ACTIVE], mcu_time[MCU_LPM0] + mcu_time[MCU_LPM1], mcu_time[MCU_LPM3]);
+	printf("Radio: %.3f ms on air, %lu crystal starts, %lu SPI bytes, %lu commands received\n",
+			radio_stats.airtime * 1e3, radio_stats.wakeups, radio_stats.spi_bytes, radio_stats.commands);
+	printf("\n%-24s %14s %12s %7s\n", "Energy", "uJ", "uJ/wake-up", "share");
+	for (i = 0; i < NUM_CATEGORIES; ++i) {
+		printf("%-24s %14.1f %12.3f %6.1f%%\n", category_names[i], energy[i],
+				energy[i] / wakeups, 0 < total ? energy[i] * 100 / total : 0);
+	}
+	printf("%-24s %14.1f %12.3f\n", "total", total, total / wakeups);
+
+	printf("\nAverage power %.3f uW", average_uw);
+	if (0 < average_uw) {
+		double life_days = BATTERY_CAP_UJ / average_uw / 86400;
+		printf(", battery life %.0f days (%.2f years) on %.0f J",
+				life_days, life_days / 365.25, BATTERY_CAP_UJ / 1e6);
+	}
+	printf("\n");
+
+	printf("\nFirmware counters: binary %lu, temp %lu, battery %lu, radio %lu, history %lu, light %lu, HTU21D %lu, downlink %lu\n",
+			numBinary, numTemp, numBattery, numRadio, numHistory, numLight, numHTU, numDownlink);
+	printf("Simulated: %lu frames, %lu ADC10 conversions, %lu HTU21D measurements, %lu optical bytes\n",
+			radio_stats.frames, adc10_conversions, htu21d_measurements, optical_bytes);
+	double estimate = firmware_estimate(numHTU, numLight);
+	printf("\ngetUsedJoules() %u J, its cost table gives %.1f uJ (%.1f%% of simulated)\n",
+			getUsedJoules(), estimate, 0 < total ? estimate * 100 / total : 0);
+}
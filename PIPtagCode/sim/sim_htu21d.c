@@ -0,0 +1,320 @@
+/*
+ * sim_htu21d.c
+ *
+ * HTU21D temperature and humidity sensor on the bit banged IIC bus of
+ * sensing/htu21d.c, SDA on P1.1 and SCL on P1.2. The bus is followed edge by
+ * edge: the sensor samples SDA on rising SCL edges, drives its ACK and data
+ * bits after falling edges and holds SCL low during a conversion started with
+ * a hold master command.
+ */
+
+#include <math.h>
+
+#include "sim.h"
+
+#define SDA BIT1
+#define SCL BIT2
+#define ADDRESS 0x80
+#define POWER_UP_S 15e-3
+//Supply current while measuring (mA)
+#define MEASURING_MA 0.45
+
+enum {
+	CMD_HOLD_TEMP = 0xE3,
+	CMD_HOLD_RH = 0xE5,
+	CMD_TEMP = 0xF3,
+	CMD_RH = 0xF5,
+	CMD_WRITE_REG = 0xE6,
+	CMD_READ_REG = 0xE7,
+	CMD_SOFT_RESET = 0xFE
+};
+
+typedef enum {
+	BUS_IDLE,
+	//Not addressed, waiting for a START
+	BUS_IGNORE,
+	BUS_RECEIVE,
+	BUS_SEND
+} BusMode;
+
+unsigned long htu21d_measurements;
+
+//Levels the sensor leaves the lines at, false when pulling low
+static bool sda_out, scl_out;
+//Bus levels last seen
+static bool sda_bus, scl_bus;
+
+static BusMode mode;
+//Bit of the current byte, 8 during the ACK clock
+static int bit;
+static uint8_t shift;
+//Bytes received since the START
+static int byte_index;
+static uint8_t command;
+//Whether the master acknowledged the last byte sent
+static bool master_ack;
+
+static uint8_t user_reg;
+static double ready_at;
+//Conversion in progress or its result
+static bool measuring;
+static bool humidity;
+static bool stretching;
+static uint8_t result[3];
+static int send_index;
+
+void htu21d_reset(void) {
+	htu21d_measurements = 0;
+	sda_out = scl_out = true;
+	sda_bus = scl_bus = true;
+	mode = BUS_IDLE;
+	bit = 0;
+	byte_index = 0;
+	command = 0;
+	user_reg = 0x02;
+	ready_at = POWER_UP_S;
+	measuring = false;
+	stretching = false;
+	send_index = 0;
+}
+
+static bool master_level(uint8_t pin) {
+	return sim_port1_drive(pin);
+}
+
+bool htu21d_sda(void) {
+	return sda_bus;
+}
+
+bool htu21d_scl(void) {
+	return scl_bus;
+}
+
+double htu21d_current_ma(void) {
+	return measuring && sim_now < ready_at ? MEASURING_MA : 0;
+}
+
+double htu21d_next_event(void) {
+	return measuring ? ready_at : INFINITY;
+}
+
+static uint8_t crc8(const uint8_t* data, int length) {
+	uint8_t crc = 0;
+	int i, b;
+	for (i = 0; i < length; ++i) {
+		crc ^= data[i];
+		for (b = 0; b < 8; ++b) {
+			crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : crc << 1;
+		}
+	}
+	return crc;
+}
+
+//Conversion time and result mask for the resolution in the user register
+static double conversion_s(bool rh, uint16_t* mask) {
+	static const double temp_s[4] = {50e-3, 13e-3, 25e-3, 7e-3};
+	static const uint16_t temp_mask[4] = {0xFFFC, 0xFFF0, 0xFFF8, 0xFFE0};
+	static const double rh_s[4] = {16e-3, 3e-3, 5e-3, 8e-3};
+	static const uint16_t rh_mask[4] = {0xFFF0, 0xFF00, 0xFFC0, 0xFFE0};
+	int resolution = ((user_reg >> 6) & 0x02) | (user_reg & 0x01);
+	*mask = rh ? rh_mask[resolution] : temp_mask[resolution];
+	return rh ? rh_s[resolution] : temp_s[resolution];
+}
+
+static void start_measurement(bool rh) {
+	uint16_t mask;
+	double seconds = conversion_s(rh, &mask);
+	double raw = rh ? (sim_config.humidity + 6) / 125.0 * 65536 : (sim_temperature() + 46.85) / 175.72 * 65536;
+	uint16_t value = (uint16_t) fmin(65535, fmax(0, raw));
+	value = (value & mask) | (rh ? 0x02 : 0);
+	result[0] = value >> 8;
+	result[1] = value & 0xFF;
+	result[2] = crc8(result, 2);
+	humidity = rh;
+	measuring = true;
+	ready_at = sim_now + seconds;
+	++htu21d_measurements;
+}
+
+static uint8_t next_send_byte(void) {
+	if (CMD_READ_REG == command) {
+		return user_reg;
+	}
+	return result[send_index < 3 ? send_index : 2];
+}
+
+static void drive_send_bit(void) {
+	sda_out = shift & 0x80;
+}
+
+//Begin sending to the master after the read address was acknowledged
+static void begin_send(void) {
+	mode = BUS_SEND;
+	bit = 0;
+	send_index = 0;
+	shift = next_send_byte();
+	if (stretching) {
+		//Hold SCL low until the conversion is done
+		scl_out = false;
+		return;
+	}
+	drive_send_bit();
+}
+
+//Handle a received byte, returns true to acknowledge it
+static bool received(uint8_t byte) {
+	bool busy = measuring && sim_now < ready_at;
+	if (0 == byte_index) {
+		if (ADDRESS != (byte & 0xFE) || (sim_now < ready_at && !measuring)) {
+			return false;
+		}
+		if (byte & 0x01) {
+			bool hold = CMD_HOLD_TEMP == command || CMD_HOLD_RH == command;
+			//A no hold conversion is polled by addressing the sensor until it acknowledges
+			if (busy && !hold) {
+				return false;
+			}
+			stretching = busy && hold;
+		}
+		return true;
+	}
+	if (1 == byte_index) {
+		command = byte;
+		switch (byte) {
+		case CMD_HOLD_TEMP:
+		case CMD_TEMP:
+			start_measurement(false);
+			break;
+		case CMD_HOLD_RH:
+		case CMD_RH:
+			start_measurement(true);
+			break;
+		case CMD_SOFT_RESET:
+			user_reg = 0x02;
+			measuring = false;
+			ready_at = sim_now + POWER_UP_S;
+			break;
+		}
+		return true;
+	}
+	if (2 == byte_index && CMD_WRITE_REG == command) {
+		//Bits 3-5 are reserved and bit 6 is the read only end of battery flag
+		user_reg = (user_reg & 0x78) | (byte & 0x87);
+	}
+	return true;
+}
+
+static void scl_rising(void) {
+	if (BUS_RECEIVE == mode && bit < 8) {
+		shift = (shift << 1) | sda_bus;
+		++bit;
+	} else if (BUS_SEND == mode && 8 == bit) {
+		master_ack = !sda_bus;
+	}
+}
+
+static void scl_falling(void) {
+	if (BUS_RECEIVE == mode) {
+		if (8 == bit) {
+			//Eight bits are in, answer during the ACK clock
+			if (received(shift)) {
+				sda_out = false;
+				bit = 9;
+			} else {
+				mode = BUS_IGNORE;
+			}
+		} else if (9 == bit) {
+			sda_out = true;
+			bit = 0;
+			bool read = 0 == byte_index && (shift & 0x01);
+			++byte_index;
+			if (read) {
+				begin_send();
+			}
+		}
+	} else if (BUS_SEND == mode) {
+		if (bit < 7) {
+			++bit;
+			shift <<= 1;
+			drive_send_bit();
+		} else if (7 == bit) {
+			//Release SDA for the master's ACK
+			bit = 8;
+			sda_out = true;
+		} else if (master_ack) {
+			bit = 0;
+			++send_index;
+			shift = next_send_byte();
+			drive_send_bit();
+		} else {
+			mode = BUS_IGNORE;
+			sda_out = true;
+		}
+	}
+}
+
+static void sda_changed(void) {
+	if (!scl_bus) {
+		return;
+	}
+	if (!sda_bus) {
+		//START or repeated START
+		mode = BUS_RECEIVE;
+		bit = 0;
+		byte_index = 0;
+	} else {
+		//STOP
+		mode = BUS_IDLE;
+	}
+	sda_out = true;
+	if (!stretching) {
+		scl_out = true;
+	}
+}
+
+//Follow the bus until the levels settle, one edge at a time
+static void settle(void) {
+	int guard;
+	for (guard = 0; guard < 16; ++guard) {
+		bool sda = master_level(SDA) && sda_out;
+		bool scl = master_level(SCL) && scl_out;
+		bool sda_edge = sda != sda_bus;
+		bool scl_edge = scl != scl_bus;
+		if (!sda_edge && !scl_edge) {
+			return;
+		}
+		//With both lines changing, a high SCL falls before SDA moves and a
+		//low SCL rises after SDA moved, so neither looks like START or STOP
+		if (scl_edge && (!sda_edge || scl_bus)) {
+			scl_bus = scl;
+			sim_port1_edge(SCL, scl);
+			if (scl) {
+				scl_rising();
+			} else {
+				scl_falling();
+			}
+		} else {
+			sda_bus = sda;
+			sim_port1_edge(SDA, sda);
+			sda_changed();
+		}
+	}
+	sim_fatal("the IIC bus does not settle");
+}
+
+void htu21d_lines_changed(void) {
+	settle();
+}
+
+void htu21d_update(void) {
+	if (measuring && ready_at <= sim_now) {
+		measuring = false;
+		if (stretching) {
+			//Present the first bit and let SCL go
+			stretching = false;
+			drive_send_bit();
+			scl_out = true;
+			settle();
+		}
+	}
+}
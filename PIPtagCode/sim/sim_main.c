@@ -0,0 +1,201 @@
+/*
+ * sim_main.c
+ *
+ * Runs the firmware of main.c from power-on for a stretch of simulated time
+ * and prints the energy it used.
+ *
+ * Usage: pipsim [options]
+ *   -t, --time SECONDS       simulated time (3600)
+ *   -v, --verbose            print every transmitted frame
+ *       --vlo HZ             VLO frequency (12000)
+ *       --vcc VOLTS          supply voltage (3.0)
+ *       --vcc-end VOLTS      supply voltage at the end, falling linearly from --vcc (--vcc)
+ *       --temp C             ambient temperature (25)
+ *       --temp-swing C       amplitude of a daily temperature cycle (0)
+ *       --rh PERCENT         relative humidity (50)
+ *       --light LEVEL        light level, 0 is dark (40)
+ *       --moisture-us US     moisture probe charge time (85)
+ *       --binary-period S    seconds between binary input changes, 0 never (0)
+ *       --slope, --offset    ADC10 temperature calibration flashed into the tag
+ *       --id ID              boardID flashed into the tag (TXER_ID)
+ *       --downlink HEX       key-value pairs a reader sends the tag after its frames, see Owl/downlink.h
+ *       --downlink-at S      time the reader starts sending them (0)
+ *       --optical HEX        frame an optical programmer sends from power-on, see optical_conn.h
+ *       --optical-for S      time the programmer keeps sending it (3)
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+
+void firmware_main(void);
+
+//Calibration cells in sensing/temperature.c, holding a float in the low bytes
+extern unsigned long notTempSlope;
+extern unsigned long notTempOffset;
+//ID of the tag in main.c
+extern unsigned long boardID;
+
+static void flash_calibration(unsigned long* cell, float value) {
+	*cell = 0;
+	memcpy(cell, &value, sizeof(value));
+}
+
+//Bytes of a hex string, returns false if it is not one
+static bool parse_hex(const char* hex, uint8_t* bytes, int size, int* length) {
+	int count = 0;
+	while (hex[0] && hex[1] && count < size) {
+		unsigned int value;
+		if (1 != sscanf(hex, "%2x", &value)) {
+			return false;
+		}
+		bytes[count++] = value;
+		hex += 2;
+	}
+	*length = count;
+	return 0 < count && !hex[0];
+}
+
+static void usage(const char* name) {
+	fprintf(stderr, "usage: %s [-t seconds] [-v] [--vlo hz] [--vcc volts] [--vcc-end volts] [--temp c] [--temp-swing c]\n"
+			"\t[--rh percent] [--light level] [--moisture-us us] [--binary-period s] [--slope s] [--offset o] [--id id]\n"
+			"\t[--downlink hex] [--downlink-at s] [--optical hex] [--optical-for s]\n", name);
+	exit(1);
+}
+
+int main(int argc, char** argv) {
+	enum {
+		OPT_VLO = 256, OPT_VCC, OPT_VCC_END, OPT_TEMP, OPT_TEMP_SWING, OPT_RH, OPT_LIGHT, OPT_MOISTURE, OPT_BINARY, OPT_SLOPE, OPT_OFFSET, OPT_ID,
+		OPT_DOWNLINK, OPT_DOWNLINK_AT, OPT_OPTICAL, OPT_OPTICAL_FOR
+	};
+	static const struct option options[] = {
+		{"time", required_argument, NULL, 't'},
+		{"verbose", no_argument, NULL, 'v'},
+		{"vlo", required_argument, NULL, OPT_VLO},
+		{"vcc", required_argument, NULL, OPT_VCC},
+		{"vcc-end", required_argument, NULL, OPT_VCC_END},
+		{"temp", required_argument, NULL, OPT_TEMP},
+		{"temp-swing", required_argument, NULL, OPT_TEMP_SWING},
+		{"rh", required_argument, NULL, OPT_RH},
+		{"light", required_argument, NULL, OPT_LIGHT},
+		{"moisture-us", required_argument, NULL, OPT_MOISTURE},
+		{"binary-period", required_argument, NULL, OPT_BINARY},
+		{"slope", required_argument, NULL, OPT_SLOPE},
+		{"offset", required_argument, NULL, OPT_OFFSET},
+		{"id", required_argument, NULL, OPT_ID},
+		{"downlink", required_argument, NULL, OPT_DOWNLINK},
+		{"downlink-at", required_argument, NULL, OPT_DOWNLINK_AT},
+		{"optical", required_argument, NULL, OPT_OPTICAL},
+		{"optical-for", required_argument, NULL, OPT_OPTICAL_FOR},
+		{NULL, 0, NULL, 0}
+	};
+	//A typical tag from slopeoffsetcsvcorrect.csv
+	float slope = 0.41305f;
+	float offset = -277.75f;
+	long id = -1;
+
+	sim_config.duration = 3600;
+	sim_config.vlo_hz = 12000;
+	sim_config.vcc = 3.0;
+	sim_config.vcc_end = -1;
+	sim_config.temperature = 25;
+	sim_config.temp_swing = 0;
+	sim_config.humidity = 50;
+	sim_config.light = 40;
+	sim_config.moisture_us = 85;
+	sim_config.binary_period = 0;
+	sim_config.downlink_length = 0;
+	sim_config.downlink_at = 0;
+	sim_config.optical_length = 0;
+	sim_config.optical_for = 3;
+	sim_config.verbose = false;
+
+	int opt;
+	while (-1 != (opt = getopt_long(argc, argv, "t:v", options, NULL))) {
+		switch (opt) {
+		case 't':
+			sim_config.duration = atof(optarg);
+			break;
+		case 'v':
+			sim_config.verbose = true;
+			break;
+		case OPT_VLO:
+			sim_config.vlo_hz = atof(optarg);
+			break;
+		case OPT_VCC:
+			sim_config.vcc = atof(optarg);
+			break;
+		case OPT_VCC_END:
+			sim_config.vcc_end = atof(optarg);
+			break;
+		case OPT_TEMP:
+			sim_config.temperature = atof(optarg);
+			break;
+		case OPT_TEMP_SWING:
+			sim_config.temp_swing = atof(optarg);
+			break;
+		case OPT_RH:
+			sim_config.humidity = atof(optarg);
+			break;
+		case OPT_LIGHT:
+			sim_config.light = atoi(optarg);
+			break;
+		case OPT_MOISTURE:
+			sim_config.moisture_us = atof(optarg);
+			break;
+		case OPT_BINARY:
+			sim_config.binary_period = atof(optarg);
+			break;
+		case OPT_SLOPE:
+			slope = atof(optarg);
+			break;
+		case OPT_OFFSET:
+			offset = atof(optarg);
+			break;
+		case OPT_ID:
+			id = strtol(optarg, NULL, 0);
+			break;
+		case OPT_DOWNLINK:
+			if (!parse_hex(optarg, sim_config.downlink, sizeof(sim_config.downlink), &sim_config.downlink_length)) {
+				usage(argv[0]);
+			}
+			break;
+		case OPT_DOWNLINK_AT:
+			sim_config.downlink_at = atof(optarg);
+			break;
+		case OPT_OPTICAL:
+			if (!parse_hex(optarg, sim_config.optical, sizeof(sim_config.optical), &sim_config.optical_length)) {
+				usage(argv[0]);
+			}
+			break;
+		case OPT_OPTICAL_FOR:
+			sim_config.optical_for = atof(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc || sim_config.duration <= 0 || sim_config.vlo_hz <= 0 || sim_config.vcc <= 0) {
+		usage(argv[0]);
+	}
+	if (sim_config.vcc_end < 0) {
+		sim_config.vcc_end = sim_config.vcc;
+	}
+
+	sim_reset();
+	flash_calibration(&notTempSlope, slope);
+	flash_calibration(&notTempOffset, offset);
+	if (0 <= id) {
+		boardID = id;
+	}
+	int stop = setjmp(sim_stop);
+	if (0 == stop) {
+		firmware_main();
+		sim_fatal("main() returned");
+	}
+	energy_report();
+	return 2 == stop ? 2 : 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * sim_optical.c
+ *
+ * An optical programmer held in front of the tag, driven like opticalTransmit()
+ * in optical_conn.c: its LED is lit from power-on for optical_for seconds and
+ * sends the frame over and over, 60 ms apart, at 4800 baud. The USCI_A0 of
+ * the tag receives it on P1.1.
+ */
+
+#include <math.h>
+
+#include "sim.h"
+
+//Start, 8 data, parity and stop bits at 4800 baud
+#define BYTE_SECONDS (11 / 4800.0)
+//Light between frames, the _delay_cycles(60000) of opticalTransmit() at 1 MHz
+#define FRAME_GAP 0.06
+//relativeLightLevel() with the programmer's LED in front of the tag
+#define PROGRAMMER_LIGHT 250
+
+unsigned long optical_bytes;
+
+//Bytes sent since power-on, over all the repeats of the frame
+static long sent;
+
+void optical_reset(void) {
+	optical_bytes = 0;
+	sent = 0;
+}
+
+static bool lit(void) {
+	return 0 < sim_config.optical_length && sim_now < sim_config.optical_for;
+}
+
+int sim_light(void) {
+	return lit() ? PROGRAMMER_LIGHT : sim_config.light;
+}
+
+//Time the stop bit of the nth byte since power-on ends
+static double byte_end(long n) {
+	long frame = n / sim_config.optical_length;
+	long index = n % sim_config.optical_length;
+	return (frame + 1) * FRAME_GAP + (frame * sim_config.optical_length + index + 1) * BYTE_SECONDS;
+}
+
+double optical_next_event(void) {
+	if (0 == sim_config.optical_length) {
+		return INFINITY;
+	}
+	double t = byte_end(sent);
+	return t < sim_config.optical_for ? t : INFINITY;
+}
+
+void optical_update(void) {
+	while (optical_next_event() <= sim_now) {
+		uint8_t byte = sim_config.optical[sent % sim_config.optical_length];
+		++sent;
+		//The bytes only reach a running USCI through the RXD function of P1.1
+		bool rxd = (sim_regs[SIM_P1SEL] & BIT1) && (sim_regs[SIM_P1SEL2] & BIT1);
+		if ((sim_regs[SIM_UCA0CTL1] & UCSWRST) || !rxd) {
+			continue;
+		}
+		//A byte not read yet is overwritten
+		sim_set_reg(SIM_UCA0RXBUF, byte);
+		sim_set_reg(SIM_IFG2, sim_regs[SIM_IFG2] | UCA0RXIFG);
+		++optical_bytes;
+	}
+}
@@ -0,0 +1,315 @@
+/*
+ * sim_timer.c
+ *
+ * Timer0_A3 and Timer1_A3. The counters are brought up to date whenever
+ * simulated time advances, counting ticks arithmetically rather than one at a
+ * time. Capture inputs come from the analog side of the board: the moisture
+ * probe charging to the comparator reference (TA0.1, CCI1B), the LED
+ * discharging in the light sensor (TA0.2, CCI2A) and the software capture
+ * that recalibrateVLO() triggers by switching TA0.0 to Vcc.
+ */
+
+#include <limits.h>
+#include <math.h>
+
+#include "sim.h"
+
+//Ticks from arming the light capture until a completely dark LED times out,
+//OPTICAL_DELAY_DURATION + 1 in sensing/light.h
+#define LIGHT_TIMEOUT_TICKS 256
+
+#define NEVER LLONG_MAX
+
+//Offsets of the registers of a timer from its TAxCTL
+enum {
+	OFS_CTL, OFS_R, OFS_CCTL0, OFS_CCTL1, OFS_CCTL2, OFS_CCR0, OFS_CCR1, OFS_CCR2, OFS_IV
+};
+
+typedef struct {
+	//First register of the timer
+	int base;
+	//Fraction of a tick counted but not yet seen by the counter
+	double frac;
+	//Ticks counted since reset, captures are scheduled against this
+	long long ticks;
+	//Scheduled captures
+	bool armed[3];
+	long long capture_at[3];
+	//Whether the capture input of each channel was connected last time
+	bool connected[3];
+} Timer;
+
+static Timer timers[2];
+
+static uint16_t reg(const Timer* t, int offset) {
+	return sim_regs[t->base + offset];
+}
+
+static void set(const Timer* t, int offset, uint16_t value) {
+	sim_set_reg(t->base + offset, value);
+}
+
+void timer_reset(void) {
+	int i;
+	for (i = 0; i < 2; ++i) {
+		Timer* t = &timers[i];
+		t->base = 0 == i ? SIM_TA0CTL : SIM_TA1CTL;
+		t->frac = 0;
+		t->ticks = 0;
+		int c;
+		for (c = 0; c < 3; ++c) {
+			t->armed[c] = false;
+			t->connected[c] = false;
+		}
+	}
+}
+
+static double timer_hz(const Timer* t) {
+	uint16_t ctl = reg(t, OFS_CTL);
+	double hz = 0;
+	switch (ctl & TASSEL_3) {
+	case TASSEL_0:
+		//TA0CLK on P1.0 carries the CC1101 GDO0 clock
+		if (&timers[0] == t && (sim_regs[SIM_P1SEL] & BIT0)) {
+			hz = cc1101_gdo0_hz();
+		}
+		break;
+	case TASSEL_1:
+		hz = sim_aclk_hz();
+		break;
+	case TASSEL_2:
+		hz = sim_smclk_hz();
+		break;
+	}
+	return hz / (1 << ((ctl >> 6) & 3));
+}
+
+//Highest count before the timer rolls over to zero, -1 while it is halted
+static long timer_top(const Timer* t) {
+	switch (reg(t, OFS_CTL) & MC_3) {
+	case MC_0:
+		return -1;
+	case MC_2:
+		return 0xFFFF;
+	default:
+		//Up mode, up/down is treated the same since the firmware never uses it
+		return reg(t, OFS_CCR0) ? reg(t, OFS_CCR0) : -1;
+	}
+}
+
+//Ticks until the counter next reaches the given value
+static long long ticks_until(long top, long cur, long value) {
+	if (value > top) {
+		return NEVER;
+	}
+	//Above the period the next tick rolls the counter over to zero
+	if (cur > top) {
+		return 1 + value;
+	}
+	long period = top + 1;
+	long d = ((value - cur) % period + period) % period;
+	return 0 == d ? period : d;
+}
+
+//Counter value after the given number of ticks
+static uint16_t position(long top, long cur, long long ticks) {
+	long period = top + 1;
+	if (cur > top) {
+		return (ticks - 1) % period;
+	}
+	return (cur + ticks) % period;
+}
+
+static void capture(Timer* t, int channel, uint16_t value) {
+	uint16_t cctl = reg(t, OFS_CCTL0 + channel);
+	if (cctl & CCIFG) {
+		cctl |= COV;
+	}
+	set(t, OFS_CCR0 + channel, value);
+	set(t, OFS_CCTL0 + channel, cctl | CCIFG);
+}
+
+static void count(Timer* t, long top, long long n) {
+	long cur = reg(t, OFS_R);
+	int c;
+	for (c = 0; c < 3; ++c) {
+		uint16_t cctl = reg(t, OFS_CCTL0 + c);
+		if (cctl & CAP) {
+			if (t->armed[c] && t->capture_at[c] <= t->ticks + n) {
+				t->armed[c] = false;
+				capture(t, c, position(top, cur, t->capture_at[c] - t->ticks));
+			}
+		} else if (ticks_until(top, cur, reg(t, OFS_CCR0 + c)) <= n) {
+			set(t, OFS_CCTL0 + c, cctl | CCIFG);
+		}
+	}
+	if (ticks_until(top, cur, 0) <= n) {
+		set(t, OFS_CTL, reg(t, OFS_CTL) | TAIFG);
+	}
+	set(t, OFS_R, position(top, cur, n));
+	t->ticks += n;
+}
+
+static void sync(Timer* t, double seconds) {
+	double hz = timer_hz(t);
+	long top = timer_top(t);
+	if (hz <= 0 || top < 0 || seconds <= 0) {
+		return;
+	}
+	double total = t->frac + seconds * hz;
+	long long n = (long long) floor(total + 1e-6);
+	t->frac = fmax(0, total - n);
+	if (0 < n) {
+		count(t, top, n);
+	}
+}
+
+void timers_sync(double t) {
+	double seconds = t - sim_now;
+	sync(&timers[0], seconds);
+	sync(&timers[1], seconds);
+}
+
+//Ticks from now until the input of a capture channel has an edge, NEVER if it has none
+static long long input_edge(Timer* t, int channel) {
+	if (&timers[0] != t) {
+		return NEVER;
+	}
+	uint16_t cctl = reg(t, OFS_CCTL0 + channel);
+	if (!(cctl & CAP) || !(cctl & CM_3)) {
+		return NEVER;
+	}
+	double hz = timer_hz(t);
+	long top = timer_top(t);
+	if (hz <= 0 || top < 0) {
+		return NEVER;
+	}
+	if (1 == channel && CCIS_1 == (cctl & CCIS_3)) {
+		//Moisture probe on CA2, charged from the next rollover through TA0.0
+		if ((sim_regs[SIM_CACTL1] & CAON) && (sim_regs[SIM_CACTL2] & P2CA2)) {
+			return ticks_until(top, reg(t, OFS_R), 0) + lround(sim_config.moisture_us * 1e-6 * hz);
+		}
+	} else if (2 == channel && CCIS_0 == (cctl & CCIS_3)) {
+		//LED on P3.0, discharging faster in brighter light
+		bool input = (sim_regs[SIM_P3SEL] & BIT0) && !(sim_regs[SIM_P3DIR] & BIT0);
+		int light = sim_light();
+		if (input && 0 < light) {
+			light = light < LIGHT_TIMEOUT_TICKS ? light : LIGHT_TIMEOUT_TICKS - 1;
+			return LIGHT_TIMEOUT_TICKS - light;
+		}
+	}
+	return NEVER;
+}
+
+//Schedule or cancel captures after the inputs or the timer changed
+static void arm(Timer* t, bool force) {
+	int c;
+	for (c = 0; c < 3; ++c) {
+		long long edge = input_edge(t, c);
+		bool connected = NEVER != edge;
+		if (connected && (force || !t->connected[c])) {
+			t->armed[c] = true;
+			t->capture_at[c] = t->ticks + edge;
+		} else if (!connected) {
+			t->armed[c] = false;
+		}
+		t->connected[c] = connected;
+	}
+}
+
+void timer_inputs_changed(void) {
+	arm(&timers[0], false);
+}
+
+void timer_write(int r, uint16_t old, uint16_t value) {
+	Timer* t = r < SIM_TA1CTL ? &timers[0] : &timers[1];
+	int offset = r - t->base;
+	bool force = false;
+	if (OFS_CTL == offset && (value & TACLR)) {
+		//TACLR clears the counter and divider and then reads back as 0
+		set(t, OFS_R, 0);
+		set(t, OFS_CTL, value & ~TACLR);
+		t->frac = 0;
+		force = true;
+	} else if (OFS_R == offset) {
+		t->frac = 0;
+		force = true;
+	} else if (OFS_CCTL0 == offset && (value & CAP) && (value & CM_3) &&
+			CCIS_2 == (old & CCIS_3) && CCIS_3 == (value & CCIS_3)) {
+		//Switching the input from GND to Vcc is a rising edge, a software capture
+		capture(t, 0, reg(t, OFS_R));
+	}
+	arm(t, force);
+}
+
+void timer_read(int r) {
+	Timer* t = r < SIM_TA1CTL ? &timers[0] : &timers[1];
+	if (OFS_IV != r - t->base) {
+		return;
+	}
+	//TAxIV reports the highest priority pending interrupt and clears its flag
+	uint16_t iv = 0;
+	if ((reg(t, OFS_CCTL1) & (CCIE | CCIFG)) == (CCIE | CCIFG)) {
+		iv = TA0IV_TACCR1;
+		set(t, OFS_CCTL1, reg(t, OFS_CCTL1) & ~CCIFG);
+	} else if ((reg(t, OFS_CCTL2) & (CCIE | CCIFG)) == (CCIE | CCIFG)) {
+		iv = TA0IV_TACCR2;
+		set(t, OFS_CCTL2, reg(t, OFS_CCTL2) & ~CCIFG);
+	} else if ((reg(t, OFS_CTL) & (TAIE | TAIFG)) == (TAIE | TAIFG)) {
+		iv = TA0IV_TAIFG;
+		set(t, OFS_CTL, reg(t, OFS_CTL) & ~TAIFG);
+	}
+	set(t, OFS_IV, iv);
+}
+
+//Time of the next interrupt flag of a timer, INFINITY if none will be set
+static double next_irq(Timer* t) {
+	double hz = timer_hz(t);
+	long top = timer_top(t);
+	if (hz <= 0 || top < 0) {
+		return INFINITY;
+	}
+	long cur = reg(t, OFS_R);
+	long long n = NEVER;
+	int c;
+	for (c = 0; c < 3; ++c) {
+		uint16_t cctl = reg(t, OFS_CCTL0 + c);
+		if (!(cctl & CCIE) || (cctl & CCIFG)) {
+			continue;
+		}
+		long long k;
+		if (cctl & CAP) {
+			k = t->armed[c] ? t->capture_at[c] - t->ticks : NEVER;
+		} else {
+			k = ticks_until(top, cur, reg(t, OFS_CCR0 + c));
+		}
+		if (k < n) {
+			n = k;
+		}
+	}
+	if ((reg(t, OFS_CTL) & TAIE) && !(reg(t, OFS_CTL) & TAIFG)) {
+		long long k = ticks_until(top, cur, 0);
+		if (k < n) {
+			n = k;
+		}
+	}
+	if (NEVER == n) {
+		return INFINITY;
+	}
+	return sim_now + fmax(0, n - t->frac) / hz;
+}
+
+double timers_next_irq(void) {
+	return fmin(next_irq(&timers[0]), next_irq(&timers[1]));
+}
+
+void timer_alarm_clock(uint16_t ccr0) {
+	Timer* t = &timers[0];
+	set(t, OFS_CTL, TASSEL_1);
+	set(t, OFS_R, ccr0);
+	set(t, OFS_CCR0, ccr0);
+	set(t, OFS_CCTL0, (reg(t, OFS_CCTL0) & OUTMOD_7) | CCIE);
+	set(t, OFS_CCTL1, 0);
+	t->frac = 0;
+	arm(t, false);
+}
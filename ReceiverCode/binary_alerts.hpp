@@ -0,0 +1,266 @@
+/*******************************************************************************
+ * Priority path for binary (door/water) events.
+ *
+ * When the binary input of a tag changes, doTemp7Binary() in
+ * PIPtagCode/sensing/temperature.c makes the tag send SENSE_TX_REPEAT extra
+ * packets within a second, and every reader in range hears each of them.
+ * BinaryAlertDetector turns that burst into a single event per transition.
+ * Events are published into a ring in shared memory as soon as the packet is
+ * read from the USB, ahead of printing and the rest of the telemetry, so an
+ * alarm process mapping the ring sees a leak within microseconds of the
+ * receiver.
+ *
+ * The ring is a file, normally in /dev/shm, holding an AlertRingHeader and
+ * a power of two number of BinaryAlert slots. The writer fills slot n % size
+ * and then publishes write_count = n + 1. A slot's seq is 0 while it is being
+ * written and n + 1 afterwards, so a reader that copies a slot and sees the
+ * same seq before and after knows the copy is consistent. A receiver that
+ * restarts keeps the ring and its count, so subscribers do not miss alerts.
+ ******************************************************************************/
+#ifndef __BINARY_ALERTS_HPP__
+#define __BINARY_ALERTS_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace pip_alerts {
+  const char ring_magic[8] = {'P', 'I', 'P', 'A', 'L', 'R', 'T', '1'};
+  const char* const default_ring_path = "/dev/shm/pip_binary_alerts";
+
+  //One binary state change of a tag
+  struct BinaryAlert {
+    //n + 1 for the n'th alert, 0 while the slot is being written
+    std::atomic<uint64_t> seq;
+    //Milliseconds since 1970 when the first packet with the new state was read
+    int64_t rx_timestamp;
+    uint32_t tx_id;
+    uint32_t rx_id;
+    float rss;
+    //New state of the binary input
+    uint8_t state;
+    uint8_t reserved[3];
+  };
+
+  struct AlertRingHeader {
+    char magic[8];
+    uint32_t capacity;
+    uint32_t record_size;
+    //Number of alerts ever written
+    std::atomic<uint64_t> write_count;
+  };
+
+  /*
+   * Follow the binary state of every tag. The repeats of a burst and copies
+   * heard by other readers carry the state that was already reported, so
+   * only the first packet of each transition raises an alert. The first
+   * packet from a tag only sets its state.
+   */
+  class BinaryAlertDetector {
+    private:
+      std::unordered_map<uint32_t, bool> states;
+    public:
+      //Returns true if this packet reports a new state for the tag
+      bool observe(uint32_t tx_id, bool state) {
+        auto found = states.find(tx_id);
+        if (found == states.end()) {
+          states.insert(std::make_pair(tx_id, state));
+          return false;
+        }
+        if (found->second == state) {
+          return false;
+        }
+        found->second = state;
+        return true;
+      }
+  };
+
+  //Shared mapping of a ring file, used by both the publisher and subscribers
+  class AlertRing {
+    protected:
+      void* mapping = MAP_FAILED;
+      size_t mapping_size = 0;
+      AlertRingHeader* header = nullptr;
+      BinaryAlert* slots = nullptr;
+
+      //No copying or assignment, the mapping is released only once.
+      AlertRing& operator=(const AlertRing&) = delete;
+      AlertRing(const AlertRing&) = delete;
+
+      //True if a file of the given size starting with this header holds a ring
+      static bool validRing(const AlertRingHeader* ring, size_t size) {
+        return 0 == memcmp(ring->magic, ring_magic, sizeof(ring_magic)) and
+          ring->record_size == sizeof(BinaryAlert) and
+          0 < ring->capacity and 0 == (ring->capacity & (ring->capacity - 1)) and
+          size >= sizeof(AlertRingHeader) + ring->capacity * sizeof(BinaryAlert);
+      }
+
+      /*
+       * Map the ring at path. With a nonzero capacity the file is created,
+       * or an existing ring of that capacity is kept as it is, so that
+       * subscribers that are already running carry on with the next alert.
+       * Any other file is replaced by an empty ring, which keeps the write
+       * count of a ring of another capacity. Subscribers of the old file have
+       * to open the new one. With a zero capacity an existing ring is opened.
+       * Throws std::runtime_error on failure.
+       */
+      AlertRing(const std::string& path, uint32_t capacity) {
+        bool create = 0 < capacity;
+        if (create and 0 != (capacity & (capacity - 1))) {
+          throw std::runtime_error("Alert ring capacity must be a power of two");
+        }
+        int fd = open(path.c_str(), create ? O_RDWR | O_CREAT : O_RDWR, 0644);
+        if (fd < 0) {
+          throw std::runtime_error("Cannot open alert ring " + path);
+        }
+        //Alerts written to the file before, by an earlier receiver
+        uint64_t count = 0;
+        bool reuse = false;
+        if (create) {
+          mapping_size = sizeof(AlertRingHeader) + capacity * sizeof(BinaryAlert);
+          struct stat info;
+          if (0 != fstat(fd, &info)) {
+            close(fd);
+            throw std::runtime_error("Cannot open alert ring " + path);
+          }
+          if ((size_t)info.st_size >= sizeof(AlertRingHeader)) {
+            void* old = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (MAP_FAILED != old) {
+              const AlertRingHeader* old_header = (const AlertRingHeader*)old;
+              if (validRing(old_header, info.st_size)) {
+                count = old_header->write_count.load(std::memory_order_acquire);
+                reuse = old_header->capacity == capacity and (size_t)info.st_size == mapping_size;
+              }
+              munmap(old, info.st_size);
+            }
+          }
+          if (not reuse and 0 < info.st_size) {
+            //A new file, resizing this one would pull it from under the
+            //mappings of running subscribers
+            close(fd);
+            unlink(path.c_str());
+            fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+            if (fd < 0) {
+              throw std::runtime_error("Cannot create alert ring " + path);
+            }
+          }
+          if (not reuse and 0 != ftruncate(fd, mapping_size)) {
+            close(fd);
+            throw std::runtime_error("Cannot size alert ring " + path);
+          }
+        }
+        else {
+          struct stat info;
+          if (0 != fstat(fd, &info) or (size_t)info.st_size < sizeof(AlertRingHeader)) {
+            close(fd);
+            throw std::runtime_error("Alert ring " + path + " is too short");
+          }
+          mapping_size = info.st_size;
+        }
+        mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (MAP_FAILED == mapping) {
+          throw std::runtime_error("Cannot map alert ring " + path);
+        }
+        header = (AlertRingHeader*)mapping;
+        slots = (BinaryAlert*)(header + 1);
+        if (create and not reuse) {
+          //The new file is zero filled, so every slot is already marked unwritten
+          header->capacity = capacity;
+          header->record_size = sizeof(BinaryAlert);
+          header->write_count.store(count, std::memory_order_relaxed);
+          memcpy(header->magic, ring_magic, sizeof(ring_magic));
+        }
+        else if (not create and not validRing(header, mapping_size)) {
+          munmap(mapping, mapping_size);
+          mapping = MAP_FAILED;
+          throw std::runtime_error("Alert ring " + path + " is not a valid alert ring");
+        }
+      }
+
+      ~AlertRing() {
+        if (MAP_FAILED != mapping) {
+          munmap(mapping, mapping_size);
+        }
+      }
+  };
+
+  //The receiver's side of the ring
+  class AlertPublisher : private AlertRing {
+    public:
+      explicit AlertPublisher(const std::string& path = default_ring_path, uint32_t capacity = 1024) :
+        AlertRing(path, capacity) {}
+
+      void publish(int64_t rx_timestamp, uint32_t tx_id, uint32_t rx_id, float rss, bool state) {
+        uint64_t n = header->write_count.load(std::memory_order_relaxed);
+        BinaryAlert& slot = slots[n & (header->capacity - 1)];
+        slot.seq.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.rx_timestamp = rx_timestamp;
+        slot.tx_id = tx_id;
+        slot.rx_id = rx_id;
+        slot.rss = rss;
+        slot.state = state;
+        slot.seq.store(n + 1, std::memory_order_release);
+        header->write_count.store(n + 1, std::memory_order_release);
+      }
+  };
+
+  /*
+   * A process waiting for alerts. Subscribers only read the ring, so any
+   * number of them can follow it. A subscriber that falls more than a ring's
+   * length behind skips the alerts that were overwritten.
+   */
+  class AlertSubscriber : private AlertRing {
+    private:
+      uint64_t next;
+    public:
+      //Follow the ring at path, starting with the next alert that is written
+      explicit AlertSubscriber(const std::string& path = default_ring_path) : AlertRing(path, 0) {
+        next = header->write_count.load(std::memory_order_acquire);
+      }
+
+      //Copy the next alert into the given fields and return true, or return false if there is none
+      bool poll(int64_t& rx_timestamp, uint32_t& tx_id, uint32_t& rx_id, float& rss, bool& state) {
+        while (true) {
+          uint64_t written = header->write_count.load(std::memory_order_acquire);
+          //The ring was made again from scratch, follow its new count
+          if (written < next) {
+            next = written;
+          }
+          if (next >= written) {
+            return false;
+          }
+          if (written - next > header->capacity) {
+            next = written - header->capacity;
+          }
+          const BinaryAlert& slot = slots[next & (header->capacity - 1)];
+          if (slot.seq.load(std::memory_order_acquire) == next + 1) {
+            rx_timestamp = slot.rx_timestamp;
+            tx_id = slot.tx_id;
+            rx_id = slot.rx_id;
+            rss = slot.rss;
+            state = slot.state;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) == next + 1) {
+              ++next;
+              return true;
+            }
+          }
+          //The slot was overwritten while reading, skip ahead
+          ++next;
+        }
+      }
+  };
+}
+
+#endif
+
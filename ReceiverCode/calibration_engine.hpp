@@ -0,0 +1,160 @@
+/*******************************************************************************
+ * Receiver-side calibration of raw tag readings.
+ *
+ * Tags that run with CM_RAW_MEASUREMENT or TEMP_RAW_MEASUREMENT send raw
+ * counts and leave the math to the receiver. Readings are queued and then
+ * calibrated in batches: the per-tag coefficients are gathered into flat
+ * arrays first so that the arithmetic runs as straight loops the compiler can
+ * vectorize.
+ ******************************************************************************/
+#ifndef __CALIBRATION_ENGINE_HPP__
+#define __CALIBRATION_ENGINE_HPP__
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <unordered_map>
+#include <vector>
+
+#include "calibration_table.hpp"
+#include "pip_sense_data.hpp"
+
+namespace pip_calibration {
+  //Queued readings that make a batch worth calibrating before the next report
+  const size_t flush_size = 256;
+
+  //A calibrated reading. Values are only meaningful if their has_ flag is set.
+  struct CalibratedReading {
+    unsigned int tx_id;
+    int64_t rx_timestamp;
+    bool has_temperature;
+    //Degrees C
+    float temperature;
+    bool has_moisture;
+    //In the units of the tag's CM_*_SCALED calibration points
+    float moisture;
+  };
+
+  class CalibrationEngine {
+    private:
+      const CalibrationTable& table;
+      //Last supply voltage reported by each tag (the tag's cached_battery)
+      std::unordered_map<unsigned int, uint16_t> battery_mv;
+
+      //Queued readings, kept as separate arrays for the batch loops
+      std::vector<unsigned int> tx_ids;
+      std::vector<int64_t> timestamps;
+      std::vector<const CalibrationRecord*> calibrations;
+      std::vector<float> temp_count;
+      std::vector<float> moisture_count;
+      std::vector<float> battery;
+      std::vector<unsigned char> has_temp;
+      std::vector<unsigned char> has_moisture;
+
+      //Coefficients gathered for each queued reading, and the results. They
+      //keep their storage from one flush to the next.
+      std::vector<float> slope, offset;
+      std::vector<float> small_lo_batt, small_lo_count, small_count_per_mv;
+      std::vector<float> big_lo_batt, big_lo_count, big_count_per_mv;
+      std::vector<float> small_scaled, big_scaled, min_scaled, max_scaled;
+      std::vector<float> temperature, moisture;
+
+    public:
+      CalibrationEngine(const CalibrationTable& table) : table(table) {}
+
+      /*
+       * Queue a reading. Battery payloads only update the remembered supply
+       * voltage. Returns false if there is nothing to calibrate, either
+       * because the tag is not in the table or it does not send raw values.
+       */
+      bool add(unsigned int tx_id, int64_t rx_timestamp, const pip_sense::SenseReading& reading) {
+        if (reading.has(pip_sense::battery)) {
+          battery_mv[tx_id] = reading.battery_mv;
+        }
+        const CalibrationRecord* calibration = table.find(tx_id);
+        if (nullptr == calibration) {
+          return false;
+        }
+        bool temp = reading.has(pip_sense::temp16_fixed) and (calibration->flags & raw_temp16);
+        bool moist = reading.has(pip_sense::moisture) and (calibration->flags & raw_moisture);
+        if (not temp and not moist) {
+          return false;
+        }
+        tx_ids.push_back(tx_id);
+        timestamps.push_back(rx_timestamp);
+        calibrations.push_back(calibration);
+        temp_count.push_back(reading.temp16_raw);
+        moisture_count.push_back(reading.moisture);
+        //Without a battery report assume a fresh battery
+        auto mv = battery_mv.find(tx_id);
+        battery.push_back(mv != battery_mv.end() ? mv->second : calibration->big_c_hi_batt);
+        has_temp.push_back(temp);
+        has_moisture.push_back(moist);
+        return true;
+      }
+
+      size_t pending() const { return tx_ids.size(); }
+
+      //Calibrate everything that was queued and clear the queue
+      std::vector<CalibratedReading> flush() {
+        const size_t n = tx_ids.size();
+        //Gather the coefficients of each reading
+        for (std::vector<float>* v : {&slope, &offset, &small_lo_batt, &small_lo_count,
+            &small_count_per_mv, &big_lo_batt, &big_lo_count, &big_count_per_mv,
+            &small_scaled, &big_scaled, &min_scaled, &max_scaled, &temperature, &moisture}) {
+          v->resize(n);
+        }
+        for (size_t i = 0; i < n; ++i) {
+          const CalibrationRecord& c = *calibrations[i];
+          slope[i] = c.adc_slope;
+          offset[i] = c.adc_offset;
+          small_lo_batt[i] = c.small_c_lo_batt;
+          small_lo_count[i] = c.small_c_lo_count;
+          small_count_per_mv[i] = c.small_c_hi_batt == c.small_c_lo_batt ? 0.0 :
+            ((float)c.small_c_hi_count - c.small_c_lo_count) / ((float)c.small_c_hi_batt - c.small_c_lo_batt);
+          big_lo_batt[i] = c.big_c_lo_batt;
+          big_lo_count[i] = c.big_c_lo_count;
+          big_count_per_mv[i] = c.big_c_hi_batt == c.big_c_lo_batt ? 0.0 :
+            ((float)c.big_c_hi_count - c.big_c_lo_count) / ((float)c.big_c_hi_batt - c.big_c_lo_batt);
+          small_scaled[i] = c.small_c_scaled;
+          big_scaled[i] = c.big_c_scaled;
+          min_scaled[i] = c.min_scaled;
+          max_scaled[i] = c.max_scaled;
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+          temperature[i] = slope[i] * temp_count[i] + offset[i];
+        }
+        //2x2-point calibration, as in cm_getMoistureLevel() but in floating point:
+        //find the counts of both calibration points at the current battery
+        //voltage and interpolate between their scale values.
+        for (size_t i = 0; i < n; ++i) {
+          float small_count = small_lo_count[i] + (battery[i] - small_lo_batt[i]) * small_count_per_mv[i];
+          float big_count = big_lo_count[i] + (battery[i] - big_lo_batt[i]) * big_count_per_mv[i];
+          float span = big_count - small_count;
+          float scaled = small_scaled[i] + (moisture_count[i] - small_count) *
+            (big_scaled[i] - small_scaled[i]) / (span != 0.0f ? span : 1.0f);
+          moisture[i] = std::min(std::max(scaled, min_scaled[i]), max_scaled[i]);
+        }
+
+        std::vector<CalibratedReading> results(n);
+        for (size_t i = 0; i < n; ++i) {
+          results[i] = CalibratedReading{tx_ids[i], timestamps[i],
+            (bool)has_temp[i], temperature[i], (bool)has_moisture[i], moisture[i]};
+        }
+
+        tx_ids.clear();
+        timestamps.clear();
+        calibrations.clear();
+        temp_count.clear();
+        moisture_count.clear();
+        battery.clear();
+        has_temp.clear();
+        has_moisture.clear();
+        return results;
+      }
+  };
+}
+
+#endif
+
@@ -0,0 +1,176 @@
+/*******************************************************************************
+ * Per-tag calibration tables, stored in a flat binary file that is mmap'd by
+ * the receiver. Records are sorted by tag ID so a lookup is a binary search
+ * over the mapped memory and loading the table costs nothing up front.
+ *
+ * File layout: a CalibrationFileHeader followed by the CalibrationRecords.
+ * All values are in host byte order; the file is built with pip_calibration
+ * (calibration_tool.cpp) on the machine that runs the receiver.
+ ******************************************************************************/
+#ifndef __CALIBRATION_TABLE_HPP__
+#define __CALIBRATION_TABLE_HPP__
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace pip_calibration {
+  const char file_magic[8] = {'P', 'I', 'P', 'C', 'A', 'L', '0', '1'};
+
+  //Flags for each record
+  enum RecordFlag : uint8_t {
+    //The tag sends raw ADC10 counts in its 16-bit temperature field (TEMP_RAW_MEASUREMENT)
+    raw_temp16   = 0x01,
+    //The tag sends raw comparator counts for moisture (CM_RAW_MEASUREMENT)
+    raw_moisture = 0x02};
+
+  struct CalibrationFileHeader {
+    char magic[8];
+    uint32_t count;
+    uint32_t record_size;
+  } __attribute__((packed));
+
+  /*
+   * Calibration values for one tag. The temperature values are the same as
+   * in PIPtagCode/slopeoffsetcsvcorrect.csv and the moisture values are the
+   * CM_* 2x2-point values from PIPtagCode/settings.h.
+   */
+  struct CalibrationRecord {
+    uint32_t tag_id;
+    //Degrees C = adc_slope * ADC10 count + adc_offset
+    float adc_slope;
+    float adc_offset;
+    uint16_t small_c_scaled;
+    uint16_t small_c_hi_batt;
+    uint16_t small_c_hi_count;
+    uint16_t small_c_lo_batt;
+    uint16_t small_c_lo_count;
+    uint16_t big_c_scaled;
+    uint16_t big_c_hi_batt;
+    uint16_t big_c_hi_count;
+    uint16_t big_c_lo_batt;
+    uint16_t big_c_lo_count;
+    uint16_t min_scaled;
+    uint16_t max_scaled;
+    uint8_t flags;
+    uint8_t reserved[3];
+  } __attribute__((packed));
+
+  //The moisture calibration that ships in settings.h, used for tags without their own values
+  inline CalibrationRecord defaultRecord(uint32_t tag_id) {
+    CalibrationRecord record;
+    memset(&record, 0, sizeof(record));
+    record.tag_id = tag_id;
+    record.small_c_scaled = 47;
+    record.small_c_hi_batt = 3081;
+    record.small_c_hi_count = 258;
+    record.small_c_lo_batt = 2701;
+    record.small_c_lo_count = 261;
+    record.big_c_scaled = 180;
+    record.big_c_hi_batt = 3081;
+    record.big_c_hi_count = 848;
+    record.big_c_lo_batt = 2680;
+    record.big_c_lo_count = 851;
+    record.min_scaled = 0;
+    record.max_scaled = 500;
+    record.flags = raw_moisture;
+    return record;
+  }
+
+  //Sort the records and write them out as a calibration file
+  inline void writeCalibrationFile(const std::string& path, std::vector<CalibrationRecord> records) {
+    std::sort(records.begin(), records.end(),
+        [](const CalibrationRecord& a, const CalibrationRecord& b) { return a.tag_id < b.tag_id; });
+    CalibrationFileHeader header;
+    memcpy(header.magic, file_magic, sizeof(file_magic));
+    header.count = records.size();
+    header.record_size = sizeof(CalibrationRecord);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (not out) {
+      throw std::runtime_error("Cannot open calibration file " + path + " for writing");
+    }
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)records.data(), records.size() * sizeof(CalibrationRecord));
+    if (not out) {
+      throw std::runtime_error("Failed to write calibration file " + path);
+    }
+  }
+
+  /**
+   * Read-only view of a calibration file. The file is mapped rather than
+   * read so that large fleets load instantly and several receiver processes
+   * on one machine share the same pages.
+   */
+  class CalibrationTable {
+    private:
+      void* mapping = MAP_FAILED;
+      size_t mapping_size = 0;
+      const CalibrationRecord* records = nullptr;
+      uint32_t count = 0;
+
+      //No copying or assignment, the mapping is released only once.
+      CalibrationTable& operator=(const CalibrationTable&) = delete;
+      CalibrationTable(const CalibrationTable&) = delete;
+    public:
+      ///An empty table, every lookup fails
+      CalibrationTable() = default;
+
+      ///Map the given calibration file, throws std::runtime_error on failure
+      explicit CalibrationTable(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+          throw std::runtime_error("Cannot open calibration file " + path);
+        }
+        struct stat info;
+        if (0 != fstat(fd, &info) or (size_t)info.st_size < sizeof(CalibrationFileHeader)) {
+          close(fd);
+          throw std::runtime_error("Calibration file " + path + " is too short");
+        }
+        mapping_size = info.st_size;
+        mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (MAP_FAILED == mapping) {
+          throw std::runtime_error("Cannot map calibration file " + path);
+        }
+        const CalibrationFileHeader* header = (const CalibrationFileHeader*)mapping;
+        if (0 != memcmp(header->magic, file_magic, sizeof(file_magic)) or
+            header->record_size != sizeof(CalibrationRecord) or
+            mapping_size < sizeof(CalibrationFileHeader) + header->count * sizeof(CalibrationRecord)) {
+          munmap(mapping, mapping_size);
+          mapping = MAP_FAILED;
+          throw std::runtime_error("Calibration file " + path + " is not a valid calibration table");
+        }
+        count = header->count;
+        records = (const CalibrationRecord*)(header + 1);
+      }
+
+      ~CalibrationTable() {
+        if (MAP_FAILED != mapping) {
+          munmap(mapping, mapping_size);
+        }
+      }
+
+      uint32_t size() const { return count; }
+
+      ///Find the calibration of a tag, or nullptr if the tag is not in the table
+      const CalibrationRecord* find(uint32_t tag_id) const {
+        const CalibrationRecord* end = records + count;
+        const CalibrationRecord* found = std::lower_bound(records, end, tag_id,
+            [](const CalibrationRecord& record, uint32_t id) { return record.tag_id < id; });
+        return (found != end and found->tag_id == tag_id) ? found : nullptr;
+      }
+  };
+}
+
+#endif
+
@@ -0,0 +1,143 @@
+/*******************************************************************************
+ * Build the calibration file used by the receiver from CSV files.
+ *
+ * The temperature CSV has the format of PIPtagCode/slopeoffsetcsvcorrect.csv:
+ *   id,slope,offset[,raw]
+ * The optional moisture CSV holds the 2x2-point calibration of each probe:
+ *   id,small_scaled,small_hi_batt,small_hi_count,small_lo_batt,small_lo_count,
+ *      big_scaled,big_hi_batt,big_hi_count,big_lo_batt,big_lo_count,
+ *      min_scaled,max_scaled[,raw]
+ * The trailing raw column is 1 if the tag sends raw values for that sensor.
+ * Tags without a moisture row get the calibration in PIPtagCode/settings.h.
+ ******************************************************************************/
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "calibration_table.hpp"
+
+using std::string;
+using std::vector;
+using pip_calibration::CalibrationRecord;
+
+//Split one line of a CSV file into its fields
+vector<string> splitCSV(const string& line) {
+  vector<string> fields;
+  std::istringstream stream(line);
+  string field;
+  while (std::getline(stream, field, ',')) {
+    fields.push_back(field);
+  }
+  return fields;
+}
+
+int main(int ac, char** arg_vector) {
+  if (ac != 3 and ac != 4) {
+    std::cerr<<"Usage: "<<arg_vector[0]<<" OUTPUT_FILE TEMP_CSV [MOISTURE_CSV]\n";
+    return 1;
+  }
+  std::map<uint32_t, CalibrationRecord> records;
+  //Find the record of a tag, creating it with default values if needed
+  auto recordFor = [&](uint32_t id) -> CalibrationRecord& {
+    auto found = records.find(id);
+    if (found == records.end()) {
+      found = records.insert(std::make_pair(id, pip_calibration::defaultRecord(id))).first;
+    }
+    return found->second;
+  };
+
+  std::ifstream temp_csv(arg_vector[2]);
+  if (not temp_csv) {
+    std::cerr<<"Cannot open "<<arg_vector[2]<<'\n';
+    return 1;
+  }
+  string line;
+  size_t line_num = 0;
+  while (std::getline(temp_csv, line)) {
+    ++line_num;
+    vector<string> fields = splitCSV(line);
+    if (fields.size() < 3) {
+      continue;
+    }
+    //Header rows and malformed cells are skipped
+    try {
+      uint32_t id = std::stoul(fields[0]);
+      float slope = std::stof(fields[1]);
+      float offset = std::stof(fields[2]);
+      bool raw = fields.size() > 3 and std::stoi(fields[3]);
+      CalibrationRecord& record = recordFor(id);
+      record.adc_slope = slope;
+      record.adc_offset = offset;
+      if (raw) {
+        record.flags |= pip_calibration::raw_temp16;
+      }
+    }
+    catch (std::logic_error& le) {
+      std::cerr<<"Skipping line "<<line_num<<" of "<<arg_vector[2]<<": "<<line<<'\n';
+    }
+  }
+
+  if (ac == 4) {
+    std::ifstream moisture_csv(arg_vector[3]);
+    if (not moisture_csv) {
+      std::cerr<<"Cannot open "<<arg_vector[3]<<'\n';
+      return 1;
+    }
+    line_num = 0;
+    while (std::getline(moisture_csv, line)) {
+      ++line_num;
+      vector<string> fields = splitCSV(line);
+      if (fields.size() < 13) {
+        continue;
+      }
+      uint32_t id;
+      vector<uint16_t> v;
+      bool raw = true;
+      try {
+        id = std::stoul(fields[0]);
+        for (size_t i = 1; i < 13; ++i) {
+          v.push_back(std::stoul(fields[i]));
+        }
+        raw = fields.size() <= 13 or std::stoi(fields[13]);
+      }
+      catch (std::logic_error& le) {
+        std::cerr<<"Skipping line "<<line_num<<" of "<<arg_vector[3]<<": "<<line<<'\n';
+        continue;
+      }
+      CalibrationRecord& record = recordFor(id);
+      record.small_c_scaled = v[0];
+      record.small_c_hi_batt = v[1];
+      record.small_c_hi_count = v[2];
+      record.small_c_lo_batt = v[3];
+      record.small_c_lo_count = v[4];
+      record.big_c_scaled = v[5];
+      record.big_c_hi_batt = v[6];
+      record.big_c_hi_count = v[7];
+      record.big_c_lo_batt = v[8];
+      record.big_c_lo_count = v[9];
+      record.min_scaled = v[10];
+      record.max_scaled = v[11];
+      if (not raw) {
+        record.flags &= ~pip_calibration::raw_moisture;
+      }
+    }
+  }
+
+  vector<CalibrationRecord> out;
+  for (auto& entry : records) {
+    out.push_back(entry.second);
+  }
+  try {
+    pip_calibration::writeCalibrationFile(arg_vector[1], out);
+  }
+  catch (std::runtime_error& re) {
+    std::cerr<<re.what()<<'\n';
+    return 1;
+  }
+  std::cerr<<"Wrote calibration for "<<out.size()<<" tags to "<<arg_vector[1]<<'\n';
+  return 0;
+}
@@ -0,0 +1,146 @@
+/*******************************************************************************
+ * Fleet battery tracking from the battery payload of each tag
+ * (doBatterySense() in PIPtagCode/sensing/battery.c): supply voltage in mV
+ * and the joules the tag estimates it has used since power-on.
+ *
+ * Every tag keeps the running sums of two weighted least squares fits, so an
+ * update is O(1) and the state is a flat array of small records:
+ *   used joules vs. time, giving the average power draw, and
+ *   supply voltage vs. time, which catches the knee at the end of the
+ *   discharge curve.
+ * Older samples are slowly forgotten so that the fits follow recent behavior.
+ * End of life is the earlier of running out of capacity and reaching the
+ * cut-off voltage.
+ ******************************************************************************/
+#ifndef __FLEET_HEALTH_HPP__
+#define __FLEET_HEALTH_HPP__
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace pip_sense {
+  const double ms_per_day = 86400000.0;
+
+  //Battery state and discharge fit of a single tag
+  struct TagHealth {
+    uint32_t tx_id;
+    uint16_t last_mv;
+    uint16_t last_joules;
+    //Start of the current battery's fit and the last battery report, ms since 1970
+    int64_t first_ms;
+    int64_t last_ms;
+    //Weighted sums over (t, joules) and (t, mV), t in days since first_ms
+    double w, st, stt, sj, stj, sv, stv;
+
+    //Slope of y over time from the sums of y and t*y, or 0 without enough data
+    double slope(double sy, double sty) const {
+      double denominator = w * stt - st * st;
+      return denominator > 1e-9 ? (w * sty - st * sy) / denominator : 0.0;
+    }
+    //Joules used per day
+    double joulesPerDay() const { return slope(sj, stj); }
+    //Change in supply mV per day (negative while discharging)
+    double mvPerDay() const { return slope(sv, stv); }
+  };
+
+  class FleetHealth {
+    private:
+      //Battery capacity in joules (BATTERY_CAP_UJ in PIPtagCode/sensing/battery.c)
+      double capacity_joules;
+      //Voltage at which the tag stops working reliably
+      double cutoff_mv;
+      //Weight kept by older samples each time a new one arrives
+      double forget;
+
+      std::vector<TagHealth> tags;
+      std::unordered_map<uint32_t, uint32_t> index;
+
+      void restart(TagHealth& tag, int64_t timestamp) {
+        tag.first_ms = timestamp;
+        tag.w = tag.st = tag.stt = tag.sj = tag.stj = tag.sv = tag.stv = 0.0;
+      }
+
+    public:
+      FleetHealth(double capacity_joules = 2376.0, double cutoff_mv = 2200.0, double forget = 0.995) :
+        capacity_joules(capacity_joules), cutoff_mv(cutoff_mv), forget(forget) {}
+
+      //Add a battery report from a tag
+      void addBattery(uint32_t tx_id, int64_t timestamp, uint16_t mv, uint16_t joules) {
+        auto found = index.find(tx_id);
+        if (found == index.end()) {
+          found = index.insert(std::make_pair(tx_id, (uint32_t)tags.size())).first;
+          tags.push_back(TagHealth());
+          TagHealth& tag = tags.back();
+          tag.tx_id = tx_id;
+          restart(tag, timestamp);
+        }
+        TagHealth& tag = tags[found->second];
+        //A tag that restarted counting (new battery or reset) or whose voltage
+        //jumped up by a lot was given a new battery; start a new fit.
+        if (0 < tag.w and (joules < tag.last_joules or mv > tag.last_mv + 200)) {
+          restart(tag, timestamp);
+        }
+        tag.last_mv = mv;
+        tag.last_joules = joules;
+        tag.last_ms = timestamp;
+
+        double t = (timestamp - tag.first_ms) / ms_per_day;
+        tag.w = tag.w * forget + 1.0;
+        tag.st = tag.st * forget + t;
+        tag.stt = tag.stt * forget + t * t;
+        tag.sj = tag.sj * forget + joules;
+        tag.stj = tag.stj * forget + t * joules;
+        tag.sv = tag.sv * forget + mv;
+        tag.stv = tag.stv * forget + t * mv;
+      }
+
+      /*
+       * Days of battery life left from the last report, or infinity if
+       * there is not enough history yet to estimate it.
+       */
+      double remainingDays(const TagHealth& tag) const {
+        double days = std::numeric_limits<double>::infinity();
+        double joules_per_day = tag.joulesPerDay();
+        if (joules_per_day > 0.0) {
+          days = std::max(0.0, capacity_joules - tag.last_joules) / joules_per_day;
+        }
+        double mv_per_day = tag.mvPerDay();
+        if (mv_per_day < 0.0) {
+          days = std::min(days, std::max(0.0, tag.last_mv - cutoff_mv) / -mv_per_day);
+        }
+        return days;
+      }
+
+      const TagHealth* find(uint32_t tx_id) const {
+        auto found = index.find(tx_id);
+        return found == index.end() ? nullptr : &tags[found->second];
+      }
+
+      size_t size() const { return tags.size(); }
+
+      //The k tags with the least remaining life as (tx_id, days) pairs, shortest first
+      std::vector<std::pair<uint32_t, double>> leastRemaining(size_t k) const {
+        std::vector<std::pair<uint32_t, double>> lives;
+        lives.reserve(tags.size());
+        for (const TagHealth& tag : tags) {
+          double days = remainingDays(tag);
+          if (days != std::numeric_limits<double>::infinity()) {
+            lives.push_back(std::make_pair(tag.tx_id, days));
+          }
+        }
+        k = std::min(k, lives.size());
+        std::partial_sort(lives.begin(), lives.begin() + k, lives.end(),
+            [](const std::pair<uint32_t, double>& a, const std::pair<uint32_t, double>& b) {
+              return a.second < b.second; });
+        lives.resize(k);
+        return lives;
+      }
+  };
+}
+
+#endif
+
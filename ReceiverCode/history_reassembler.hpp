@@ -0,0 +1,170 @@
+/*******************************************************************************
+ * Reassembly of the 28 hour min/max history that vivaristat tags trickle out
+ * one hour per packet (HISTORY_28 in PIPtagCode/settings.h).
+ *
+ * Live readings are rolled up per hour for every tag. When a history unit
+ * arrives for an hour in which no live packet was received it is used to
+ * back-fill that hour, so packet loss does not leave holes in the rollups.
+ *
+ * Hours are aligned to the receiver's clock. The tag counts its hours from
+ * power-on, so a history unit can straddle two of the receiver's hours; it is
+ * assigned to the receiver hour that lies as many hours before the packet as
+ * the unit lies before the tag's current hour.
+ ******************************************************************************/
+#ifndef __HISTORY_REASSEMBLER_HPP__
+#define __HISTORY_REASSEMBLER_HPP__
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <map>
+
+#include "pip_sense_data.hpp"
+#include "sample_data.hpp"
+
+namespace pip_sense {
+  //Hours kept by the tag (MAX_HISTORY_VALUES in PIPtagCode/Owl/history.h)
+  const unsigned int history_hours = 28;
+  //History broadcasts per hour (MS_ONE_HOUR / HISTORY_INTVL)
+  const unsigned int history_slots = 40;
+  const int64_t ms_per_hour = 3600000;
+
+  /*
+   * Map a history slot to the number of hours before the tag's current hour
+   * that it carries, or -1 for an invalid slot. This follows getHistory() in
+   * PIPtagCode/Owl/history.c: every third slot and the last slot carry the
+   * oldest hour, the other 26 slots step through hours 1-26. The tag advances
+   * both sequences together and 26 regular slots fit in one rotation, so the
+   * mapping is the same in every rotation.
+   */
+  inline int historySlotHoursAgo(unsigned int slot) {
+    if (slot >= history_slots) {
+      return -1;
+    }
+    if (slot % 3 == 2 or slot == history_slots - 1) {
+      return history_hours - 1;
+    }
+    return slot - (slot + 1) / 3 + 1;
+  }
+
+  //Min/max values of one hour for one tag
+  struct HourRollup {
+    //Hours since 1970, or -1 if this entry is unused
+    int64_t hour = -1;
+    float min_temp = 0.0;
+    float max_temp = 0.0;
+    float min_humid = 0.0;
+    float max_humid = 0.0;
+    unsigned char min_light = 0;
+    unsigned char max_light = 0;
+    //Number of live packets that contributed to this hour
+    unsigned int live_samples = 0;
+    //True if the values came from the tag's history rather than live packets
+    bool from_history = false;
+  };
+
+  class HistoryReassembler {
+    private:
+      //Hours are stored in a ring indexed by hour modulo its size
+      typedef std::array<HourRollup, history_hours> HourRing;
+      std::map<unsigned int, HourRing> tags;
+
+      HourRollup& rollupFor(unsigned int tx_id, int64_t hour) {
+        HourRollup& entry = tags[tx_id][hour % history_hours];
+        //Recycle the entry if it holds an hour that has since scrolled out
+        if (entry.hour != hour) {
+          entry = HourRollup();
+          entry.hour = hour;
+        }
+        return entry;
+      }
+
+    public:
+      /*
+       * Fold a live reading into the rollup of the hour it was received in.
+       * The HTU21D is preferred for temperature, as it is on the tag.
+       * Returns false if the reading has nothing that is kept in the history.
+       */
+      bool addLive(unsigned int tx_id, Timestamp rx_timestamp, const SenseReading& reading) {
+        bool has_temp = false;
+        float temp = 0.0;
+        float humid = 0.0;
+        if (reading.has(htu_sensing) and reading.htuValid()) {
+          has_temp = true;
+          temp = reading.htuTemperature();
+          humid = reading.htuHumidity();
+        }
+        else if (reading.has(temp16_fixed)) {
+          has_temp = true;
+          temp = reading.temp16;
+        }
+        else if (reading.has(temp7_binary)) {
+          has_temp = true;
+          temp = reading.temp7;
+        }
+        bool has_light = reading.has(relative_light);
+        if (not has_temp and not has_light) {
+          return false;
+        }
+
+        HourRollup& entry = rollupFor(tx_id, rx_timestamp / ms_per_hour);
+        //Live data replaces anything that was back-filled from history
+        if (entry.from_history) {
+          entry = HourRollup();
+          entry.hour = rx_timestamp / ms_per_hour;
+        }
+        bool first = 0 == entry.live_samples;
+        if (has_temp) {
+          entry.min_temp = first ? temp : std::min(entry.min_temp, temp);
+          entry.max_temp = first ? temp : std::max(entry.max_temp, temp);
+          entry.min_humid = first ? humid : std::min(entry.min_humid, humid);
+          entry.max_humid = first ? humid : std::max(entry.max_humid, humid);
+        }
+        if (has_light) {
+          entry.min_light = first ? reading.light : std::min(entry.min_light, reading.light);
+          entry.max_light = first ? reading.light : std::max(entry.max_light, reading.light);
+        }
+        ++entry.live_samples;
+        return true;
+      }
+
+      /*
+       * Use a history unit to back-fill the hour it describes. Returns the
+       * hour that was filled in, or -1 if the slot was invalid, the unit was
+       * never filled by the tag, or live packets already covered that hour.
+       */
+      int64_t addHistory(unsigned int tx_id, Timestamp rx_timestamp,
+          unsigned char slot, const HistoryUnit& unit) {
+        int hours_ago = historySlotHoursAgo(slot);
+        if (hours_ago < 0 or not unit.valid()) {
+          return -1;
+        }
+        int64_t hour = rx_timestamp / ms_per_hour - hours_ago;
+        HourRollup& entry = rollupFor(tx_id, hour);
+        if (0 < entry.live_samples) {
+          return -1;
+        }
+        entry.min_temp = unit.min_temp;
+        entry.max_temp = unit.max_temp;
+        entry.min_humid = unit.min_humid;
+        entry.max_humid = unit.max_humid;
+        entry.min_light = unit.minLight();
+        entry.max_light = unit.maxLight();
+        entry.from_history = true;
+        return hour;
+      }
+
+      //Get the rollup of an hour, or nullptr if nothing is known about it
+      const HourRollup* rollup(unsigned int tx_id, int64_t hour) const {
+        auto tag = tags.find(tx_id);
+        if (tag == tags.end()) {
+          return nullptr;
+        }
+        const HourRollup& entry = tag->second[hour % history_hours];
+        return entry.hour == hour ? &entry : nullptr;
+      }
+  };
+}
+
+#endif
+
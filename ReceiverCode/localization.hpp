@@ -0,0 +1,267 @@
+/*******************************************************************************
+ * RSS localization of tags.
+ *
+ * Every transmission is heard by the readers in range. The receptions of one
+ * transmission are grouped, their RSS values are turned into distances with a
+ * log-distance path loss model, and the tag position is the weighted least
+ * squares fit to those distances from the known reader positions. Far readers
+ * get less weight since the distance error grows with the distance.
+ *
+ * Reader positions come from a text file with one reader per line:
+ *   rx_id x y z [region_uri]
+ * Blank lines and lines starting with # are ignored. rx_id is the reader ID
+ * printed as RX: by the receiver.
+ ******************************************************************************/
+#ifndef __LOCALIZATION_HPP__
+#define __LOCALIZATION_HPP__
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "sample_data.hpp"
+
+namespace pip_localization {
+  struct ReceiverPosition {
+    float x;
+    float y;
+    float z;
+    std::u16string region_uri;
+  };
+
+  //Load reader positions, throws std::runtime_error if the file cannot be read
+  inline std::map<uint32_t, ReceiverPosition> loadReceiverPositions(const std::string& path) {
+    std::ifstream in(path);
+    if (not in) {
+      throw std::runtime_error("Cannot open receiver position file " + path);
+    }
+    std::map<uint32_t, ReceiverPosition> receivers;
+    std::string line;
+    while (std::getline(in, line)) {
+      if (line.empty() or '#' == line[0]) {
+        continue;
+      }
+      std::istringstream fields(line);
+      uint32_t rx_id;
+      ReceiverPosition position;
+      std::string region;
+      if (not (fields >> rx_id >> position.x >> position.y >> position.z)) {
+        throw std::runtime_error("Bad line in receiver position file " + path + ": " + line);
+      }
+      fields >> region;
+      position.region_uri = std::u16string(region.begin(), region.end());
+      receivers[rx_id] = position;
+    }
+    return receivers;
+  }
+
+  //RSS as a function of distance: rss = rss_1m - 10 * exponent * log10(meters)
+  struct PathLossModel {
+    float rss_1m = -40.0;
+    float exponent = 2.5;
+
+    float distance(float rss) const {
+      return std::pow(10.0f, (rss_1m - rss) / (10.0f * exponent));
+    }
+  };
+
+  //The receptions of one transmission
+  struct Transmission {
+    uint32_t tx_id;
+    Timestamp first_rx;
+    //RSS summed over the receptions of each reader and the number of receptions
+    std::vector<uint32_t> rx_ids;
+    std::vector<float> rss_sums;
+    std::vector<unsigned int> counts;
+  };
+
+  class Localizer {
+    private:
+      std::map<uint32_t, ReceiverPosition> receivers;
+      PathLossModel model;
+      //Receptions this long after the first belong to the same transmission
+      Timestamp window_ms;
+      //Height of the tags, since readers are usually mounted at one height
+      //and cannot resolve z
+      float tag_z;
+      std::unordered_map<uint32_t, Transmission> open;
+
+      //Solve the position of one transmission. DevicePosition is filled in
+      //place since TransmitterID is not cheap to copy.
+      void solve(const Transmission& t, DevicePosition& position) const {
+        position.type = mobile | transmitter;
+        position.physical_layer = 1;
+        position.device_id = t.tx_id;
+        position.z = tag_z;
+        position.valid = false;
+
+        std::vector<const ReceiverPosition*> rx;
+        std::vector<float> range, weight;
+        float best_rss = -1000.0;
+        for (size_t i = 0; i < t.rx_ids.size(); ++i) {
+          auto found = receivers.find(t.rx_ids[i]);
+          if (found == receivers.end()) {
+            continue;
+          }
+          float rss = t.rss_sums[i] / t.counts[i];
+          const ReceiverPosition* r = &found->second;
+          //Distance in the plane of the tags
+          float d = model.distance(rss);
+          float dz = r->z - tag_z;
+          rx.push_back(r);
+          range.push_back(std::sqrt(std::max(0.0f, d * d - dz * dz)));
+          weight.push_back(1.0f / std::max(1.0f, d * d));
+          if (rss > best_rss) {
+            best_rss = rss;
+            position.region_uri = r->region_uri;
+          }
+        }
+        if (rx.empty()) {
+          return;
+        }
+
+        //Start from the weighted centroid of the readers
+        double x = 0.0, y = 0.0, total = 0.0;
+        for (size_t i = 0; i < rx.size(); ++i) {
+          x += weight[i] * rx[i]->x;
+          y += weight[i] * rx[i]->y;
+          total += weight[i];
+        }
+        x /= total;
+        y /= total;
+
+        //Levenberg-Marquardt on the range residuals. The damping keeps the
+        //solution near the centroid when too few readers constrain it.
+        double lambda = 1e-3;
+        for (int iteration = 0; iteration < 20 and 3 <= rx.size(); ++iteration) {
+          double jtj_xx = 0.0, jtj_xy = 0.0, jtj_yy = 0.0, jtr_x = 0.0, jtr_y = 0.0, cost = 0.0;
+          for (size_t i = 0; i < rx.size(); ++i) {
+            double dx = x - rx[i]->x;
+            double dy = y - rx[i]->y;
+            double d = std::max(1e-3, std::sqrt(dx * dx + dy * dy));
+            double r = d - range[i];
+            double jx = dx / d;
+            double jy = dy / d;
+            jtj_xx += weight[i] * jx * jx;
+            jtj_xy += weight[i] * jx * jy;
+            jtj_yy += weight[i] * jy * jy;
+            jtr_x += weight[i] * jx * r;
+            jtr_y += weight[i] * jy * r;
+            cost += weight[i] * r * r;
+          }
+          double a = jtj_xx * (1.0 + lambda);
+          double c = jtj_yy * (1.0 + lambda);
+          double det = a * c - jtj_xy * jtj_xy;
+          if (std::fabs(det) < 1e-12) {
+            break;
+          }
+          double step_x = -(c * jtr_x - jtj_xy * jtr_y) / det;
+          double step_y = -(a * jtr_y - jtj_xy * jtr_x) / det;
+          //Accept the step only if it lowers the cost
+          double new_cost = 0.0;
+          for (size_t i = 0; i < rx.size(); ++i) {
+            double dx = x + step_x - rx[i]->x;
+            double dy = y + step_y - rx[i]->y;
+            double r = std::sqrt(dx * dx + dy * dy) - range[i];
+            new_cost += weight[i] * r * r;
+          }
+          if (new_cost < cost) {
+            x += step_x;
+            y += step_y;
+            lambda /= 10.0;
+            if (step_x * step_x + step_y * step_y < 1e-6) {
+              break;
+            }
+          }
+          else {
+            lambda *= 10.0;
+          }
+        }
+        position.x = x;
+        position.y = y;
+        position.valid = true;
+      }
+
+    public:
+      Localizer(const std::map<uint32_t, ReceiverPosition>& receivers, PathLossModel model = PathLossModel(),
+          Timestamp window_ms = 250, float tag_z = 0.0) :
+        receivers(receivers), model(model), window_ms(window_ms), tag_z(tag_z) {}
+
+      //Add one reception of a tag's transmission
+      void add(uint32_t tx_id, uint32_t rx_id, Timestamp rx_timestamp, float rss) {
+        auto found = open.find(tx_id);
+        if (found == open.end()) {
+          Transmission t;
+          t.tx_id = tx_id;
+          t.first_rx = rx_timestamp;
+          found = open.insert(std::make_pair(tx_id, t)).first;
+        }
+        Transmission& t = found->second;
+        auto rx = std::find(t.rx_ids.begin(), t.rx_ids.end(), rx_id);
+        if (rx == t.rx_ids.end()) {
+          t.rx_ids.push_back(rx_id);
+          t.rss_sums.push_back(rss);
+          t.counts.push_back(1);
+        }
+        else {
+          size_t i = rx - t.rx_ids.begin();
+          t.rss_sums[i] += rss;
+          ++t.counts[i];
+        }
+      }
+
+      /*
+       * Solve every transmission whose window closed by the given time. Large
+       * batches are split across all cores.
+       */
+      std::vector<DevicePosition> solveReady(Timestamp now) {
+        std::vector<Transmission> ready;
+        for (auto I = open.begin(); I != open.end();) {
+          if (now - I->second.first_rx >= window_ms) {
+            ready.push_back(std::move(I->second));
+            I = open.erase(I);
+          }
+          else {
+            ++I;
+          }
+        }
+
+        std::vector<DevicePosition> positions(ready.size());
+        auto solveRange = [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            solve(ready[i], positions[i]);
+          }
+        };
+        //Threads only pay off when each one gets a good amount of work
+        const size_t per_thread = 64;
+        size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()),
+            (ready.size() + per_thread - 1) / per_thread);
+        if (threads <= 1) {
+          solveRange(0, ready.size());
+        }
+        else {
+          std::vector<std::thread> workers;
+          size_t chunk = (ready.size() + threads - 1) / threads;
+          for (size_t begin = chunk; begin < ready.size(); begin += chunk) {
+            workers.push_back(std::thread(solveRange, begin, std::min(ready.size(), begin + chunk)));
+          }
+          solveRange(0, std::min(ready.size(), chunk));
+          for (std::thread& worker : workers) {
+            worker.join();
+          }
+        }
+        return positions;
+      }
+  };
+}
+
+#endif
+
@@ -0,0 +1,277 @@
+/*******************************************************************************
+ * Decoding of the sensed data that follows the ID in a PIP tag packet.
+ * The layout mirrors the transmit path in PIPtagCode/main.c: a DataHeader
+ * byte, then one big-endian field for every header bit that is set, in the
+ * order of the fields in PIPtagCode/Owl/frame.h. An ExtHeader byte follows
+ * the DataHeader if its extended bit is set. Batch packets hold several
+ * samples of the sensed fields, see PIPtagCode/Owl/batch.h. Packed packets
+ * (protocol version 3) hold the fields as a bit stream, see
+ * PIPtagCode/Owl/packed.h.
+ ******************************************************************************/
+#ifndef __PIP_SENSE_DATA_HPP__
+#define __PIP_SENSE_DATA_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pip_sense {
+  //Bits of the DataHeader byte, see PIPtagCode/main.h
+  enum HeaderBit : unsigned char {
+    temp7_binary      = 0x01,
+    temp16_fixed      = 0x02,
+    relative_light    = 0x04,
+    htu_sensing       = 0x08,
+    moisture          = 0x10,
+    vivaristat_history = 0x20,
+    battery           = 0x40,
+    extended          = 0x80};
+
+  //Bits of the ExtHeader byte, see PIPtagCode/main.h
+  enum ExtHeaderBit : unsigned char {
+    //Sent because a value changed rather than as a heartbeat
+    change_report     = 0x01,
+    batch             = 0x02,
+    packed            = 0x04,
+    //The tag's power policy stretched its intervals to save a low battery
+    low_power         = 0x08};
+
+  //Samples of a batch carry their age in units of 1024 ms
+  const unsigned int batch_age_unit_ms = 1024;
+
+  //Error codes the HTU21D driver sends instead of a fixed point value
+  const uint16_t htu_read_fail = 0x0FFE;
+  const uint16_t htu_crc_fail  = 0x0FFF;
+
+  //Packed HTU21D temperatures are offset to keep them positive, 12.4 fixed point
+  const int packed_htu_temp_offset = 47 * 16;
+
+  //One hour of min/max values as kept by PIPtagCode/Owl/history.c
+  struct HistoryUnit {
+    signed char min_temp;
+    signed char max_temp;
+    signed char min_humid;
+    signed char max_humid;
+    //Maximum light in the high nibble, minimum light in the low nibble
+    unsigned char min_max_light;
+
+    //Hours that were never filled still hold the values from initHistory()
+    bool valid() const { return min_temp <= max_temp and min_humid <= max_humid; }
+    unsigned char minLight() const { return (min_max_light & 0x0F) << 4; }
+    unsigned char maxLight() const { return min_max_light & 0xF0; }
+  };
+
+  //The decoded sense data of one packet. Only fields flagged by the header
+  //are filled in.
+  struct SenseReading {
+    unsigned char header = 0;
+    unsigned char ext_header = 0;
+    //False if the data was shorter than the header promised
+    bool valid = true;
+    //How long before the packet the sample was taken, for samples of a batch
+    unsigned int age_ms = 0;
+
+    bool binary = false;
+    //Whole degrees C
+    int temp7 = 0;
+    //Degrees C, from the 12.4 fixed point value
+    float temp16 = 0.0;
+    //The field as sent, which is an ADC10 count if the tag runs TEMP_RAW_MEASUREMENT
+    uint16_t temp16_raw = 0;
+    unsigned char light = 0;
+    //Raw 12.4 fixed point values, which may hold an htu_*_fail code
+    uint16_t htu_temp16 = 0;
+    uint16_t htu_rh16 = 0;
+    uint16_t moisture = 0;
+    //Slot in the history rotation and the hour broadcast in it
+    unsigned char history_slot = 0;
+    HistoryUnit history = HistoryUnit();
+    uint16_t battery_mv = 0;
+    uint16_t used_joules = 0;
+
+    bool has(HeaderBit bit) const { return header & bit; }
+    bool has(ExtHeaderBit bit) const { return ext_header & bit; }
+    bool htuValid() const {
+      return htu_temp16 != htu_read_fail and htu_temp16 != htu_crc_fail and
+        htu_rh16 != htu_read_fail and htu_rh16 != htu_crc_fail;
+    }
+    float htuTemperature() const { return (int16_t)htu_temp16 / 16.0; }
+    float htuHumidity() const { return (int16_t)htu_rh16 / 16.0; }
+  };
+
+  inline uint16_t readBE16(const std::vector<unsigned char>& data, size_t pos) {
+    return (uint16_t)(data[pos] << 8 | data[pos+1]);
+  }
+
+  //Reads the fields of a packet in order
+  struct FieldCursor {
+    const std::vector<unsigned char>& data;
+    size_t pos;
+    bool valid;
+
+    //Make sure that another field of the given size is present
+    bool available(size_t size) {
+      if (data.size() < pos + size) {
+        valid = false;
+      }
+      return valid;
+    }
+  };
+
+  //The sensed fields of one sample
+  inline void decodeSample(FieldCursor& in, SenseReading& reading) {
+    const std::vector<unsigned char>& data = in.data;
+    if (reading.has(temp7_binary) and in.available(1)) {
+      reading.binary = data[in.pos] & 0x01;
+      //The tag offsets temperature by 40 degrees to keep it positive
+      reading.temp7 = (data[in.pos] >> 1) - 40;
+      in.pos += 1;
+    }
+    if (reading.has(temp16_fixed) and in.available(2)) {
+      reading.temp16_raw = readBE16(data, in.pos);
+      reading.temp16 = reading.temp16_raw / 16.0 - 40.0;
+      in.pos += 2;
+    }
+    if (reading.has(relative_light) and in.available(1)) {
+      reading.light = data[in.pos];
+      in.pos += 1;
+    }
+    if (reading.has(htu_sensing) and in.available(4)) {
+      reading.htu_temp16 = readBE16(data, in.pos);
+      reading.htu_rh16 = readBE16(data, in.pos+2);
+      in.pos += 4;
+    }
+    if (reading.has(moisture) and in.available(2)) {
+      reading.moisture = readBE16(data, in.pos);
+      in.pos += 2;
+    }
+  }
+
+  //Reads the bit packed fields of a packet, least significant bit first
+  struct BitCursor {
+    const std::vector<unsigned char>& data;
+    size_t bit;
+    bool valid;
+
+    unsigned int read(unsigned int width) {
+      if (data.size() * 8 < bit + width) {
+        valid = false;
+        return 0;
+      }
+      unsigned int value = 0;
+      for (unsigned int i = 0; i < width; ++i, ++bit) {
+        value |= ((data[bit / 8] >> (bit % 8)) & 0x01) << i;
+      }
+      return value;
+    }
+  };
+
+  //The sensed fields of a packed sample, which start in the high nibble of
+  //the ExtHeader. Values are returned in the units of unpacked fields.
+  inline void decodePackedSample(FieldCursor& in, SenseReading& reading) {
+    BitCursor bits{in.data, in.pos * 8 - 4, in.valid};
+    if (reading.has(temp7_binary)) {
+      unsigned int temp7 = bits.read(8);
+      reading.binary = temp7 & 0x01;
+      reading.temp7 = (temp7 >> 1) - 40;
+    }
+    if (reading.has(temp16_fixed)) {
+      reading.temp16_raw = bits.read(12);
+      reading.temp16 = reading.temp16_raw / 16.0 - 40.0;
+    }
+    if (reading.has(relative_light)) {
+      reading.light = bits.read(8);
+    }
+    if (reading.has(htu_sensing)) {
+      //The two highest codes of each field are the error codes
+      uint16_t temp = bits.read(12);
+      uint16_t rh = bits.read(8);
+      reading.htu_temp16 = htu_read_fail <= temp ? temp : temp - packed_htu_temp_offset;
+      reading.htu_rh16 = 0xFE <= rh ? rh + 0xF00 : rh * 8;
+    }
+    if (reading.has(moisture)) {
+      reading.moisture = bits.read(16);
+    }
+    in.pos = (bits.bit + 7) / 8;
+    in.valid = bits.valid;
+  }
+
+  //The history and battery fields, sent once per packet
+  inline void decodeTrailer(FieldCursor& in, SenseReading& reading) {
+    const std::vector<unsigned char>& data = in.data;
+    if (reading.has(vivaristat_history) and in.available(1 + sizeof(HistoryUnit))) {
+      reading.history_slot = data[in.pos];
+      reading.history.min_temp = data[in.pos+1];
+      reading.history.max_temp = data[in.pos+2];
+      reading.history.min_humid = data[in.pos+3];
+      reading.history.max_humid = data[in.pos+4];
+      reading.history.min_max_light = data[in.pos+5];
+      in.pos += 1 + sizeof(HistoryUnit);
+    }
+    if (reading.has(battery) and in.available(4)) {
+      reading.battery_mv = readBE16(data, in.pos);
+      reading.used_joules = readBE16(data, in.pos+2);
+      in.pos += 4;
+    }
+  }
+
+  //Decode the sense_data vector of a SampleData into its samples, oldest
+  //first. Only batch packets have more than one. The history and battery
+  //fields go with the newest sample and are flagged only in its header.
+  inline std::vector<SenseReading> decodeSenseSamples(const std::vector<unsigned char>& data) {
+    std::vector<SenseReading> samples;
+    if (data.empty()) {
+      return samples;
+    }
+    SenseReading first;
+    first.header = data[0];
+    FieldCursor in{data, 1, true};
+    if (first.has(extended) and in.available(1)) {
+      first.ext_header = data[in.pos];
+      in.pos += 1;
+      //The high nibble of a packed ExtHeader holds the first field bits
+      if (first.has(packed)) {
+        first.ext_header &= 0x0F;
+      }
+    }
+    size_t count = 1;
+    if (first.has(batch) and in.available(1)) {
+      count = data[in.pos];
+      in.pos += 1;
+    }
+    for (size_t i = 0; i < count and in.valid; ++i) {
+      SenseReading reading = first;
+      if (reading.has(batch) and in.available(1)) {
+        reading.age_ms = data[in.pos] * batch_age_unit_ms;
+        in.pos += 1;
+      }
+      if (reading.has(packed)) {
+        decodePackedSample(in, reading);
+      }
+      else {
+        decodeSample(in, reading);
+      }
+      if (i + 1 < count) {
+        reading.header &= ~(vivaristat_history | battery);
+      }
+      samples.push_back(reading);
+    }
+    if (samples.empty()) {
+      samples.push_back(first);
+    }
+    decodeTrailer(in, samples.back());
+    for (SenseReading& reading : samples) {
+      reading.valid = in.valid;
+    }
+    return samples;
+  }
+
+  //Decode the sense_data vector of a SampleData, the newest sample of a batch
+  inline SenseReading decodeSenseData(const std::vector<unsigned char>& data) {
+    std::vector<SenseReading> samples = decodeSenseSamples(data);
+    return samples.empty() ? SenseReading() : samples.back();
+  }
+}
+
+#endif
+
@@ -14,6 +14,13 @@
 
 #include "simple_sockets.hpp"
 #include "sensor_aggregator_protocol.hpp"
+#include "pip_sense_data.hpp"
+#include "history_reassembler.hpp"
+#include "calibration_engine.hpp"
+#include "fleet_health.hpp"
+#include "binary_alerts.hpp"
+#include "localization.hpp"
+#include "reader_merge.hpp"
 
 #include <iostream>
 #include <string>
@@ -22,6 +29,7 @@
 #include <algorithm>
 #include <stdexcept>
 #include <fstream>
+#include <memory>
 
 //Handle interrupt signals to exit cleanly.
 #include <signal.h>
@@ -222,10 +230,16 @@ void attachPIPs(list<usb_dev_handle*> &pip_devs) {
 
 int main(int ac, char** arg_vector) {
   std::cerr<<"parameters are ac:"<<ac<<std::endl;
-  if (ac != 3 and ac != 4) {
+  if (ac < 3 or ac > 8) {
     std::cerr<<"This program requires 2 arguments,"<<
       " the ip address and the port number of the aggregation server to send data to.\n";
     std::cerr<<"An optional third argument specifies the minimum RSS for a packet to be reported.\n";
+    std::cerr<<"An optional fourth argument names a calibration file made with pip_calibration.\n";
+    std::cerr<<"An optional fifth argument names the shared memory file for binary alerts"<<
+      " (default "<<pip_alerts::default_ring_path<<").\n";
+    std::cerr<<"An optional sixth argument names a file of reader positions to localize tags with.\n";
+    std::cerr<<"An optional seventh argument is the number of channels the tags are split over"<<
+      " (NUM_CHANNELS of the tags, default 1).\n";
     return 0;
   }
   //Get the ip address and ports of the aggregation server
@@ -241,6 +255,55 @@ int main(int ac, char** arg_vector) {
     std::cout<<"Using min RSS "<<min_rss<<'\n';
   }
 
+  //Per-tag calibration for tags that send raw readings
+  std::unique_ptr<pip_calibration::CalibrationTable> calibration_table(new pip_calibration::CalibrationTable());
+  if (ac > 4) {
+    try {
+      calibration_table.reset(new pip_calibration::CalibrationTable(arg_vector[4]));
+      std::cerr<<"Loaded calibration for "<<calibration_table->size()<<" tags\n";
+    }
+    catch (std::runtime_error& re) {
+      std::cerr<<re.what()<<'\n';
+      return 1;
+    }
+  }
+  pip_calibration::CalibrationEngine calibration(*calibration_table);
+
+  //Binary state changes go straight to subscribers of the alert ring
+  pip_alerts::BinaryAlertDetector binary_detector;
+  std::unique_ptr<pip_alerts::AlertPublisher> alerts;
+  try {
+    alerts.reset(new pip_alerts::AlertPublisher(ac > 5 ? arg_vector[5] : pip_alerts::default_ring_path));
+  }
+  catch (std::runtime_error& re) {
+    std::cerr<<re.what()<<", binary alerts will only be printed\n";
+  }
+
+  //Tag positions from the RSS at the readers, if the reader positions are known
+  std::unique_ptr<pip_localization::Localizer> localizer;
+  if (ac > 6) {
+    try {
+      localizer.reset(new pip_localization::Localizer(pip_localization::loadReceiverPositions(arg_vector[6])));
+    }
+    catch (std::runtime_error& re) {
+      std::cerr<<re.what()<<'\n';
+      return 1;
+    }
+  }
+
+  //Readers on every channel of the site, heard packets are only used once
+  long num_channels = 1;
+  if (ac > 7) {
+    char* end;
+    num_channels = strtol(arg_vector[7], &end, 10);
+    //Tags have a one byte channel and 0xFF means none was programmed
+    if (end == arg_vector[7] or '\0' != *end or num_channels < 1 or num_channels > 254) {
+      std::cerr<<"The number of channels must be from 1 to 254, not "<<arg_vector[7]<<'\n';
+      return 1;
+    }
+  }
+  pip_sense::ReaderMerge merge(num_channels);
+
   //Set up a socket to connect to the aggregator.
   // bye -rpm ClientSocket agg(AF_INET, SOCK_STREAM, 0, server_port, server_ip);
 
@@ -252,6 +315,10 @@ int main(int ac, char** arg_vector) {
   unsigned char buf[MAX_PACKET_SIZE_READ];
   char* signed_buf = (char*)buf;
   list<usb_dev_handle*> pip_devs;
+  //Hourly rollups of every tag, back-filled from the tags' own history
+  pip_sense::HistoryReassembler history;
+  //Battery discharge of every tag, to find the batteries that need swapping first
+  pip_sense::FleetHealth fleet;
   //Set up the USB
   usb_init(); 
   usb_find_busses(); 
@@ -272,6 +339,8 @@ int main(int ac, char** arg_vector) {
       std::cerr<<"Failed to connect to the GRAIL aggregation server.\n";
     }
     long long int lastReportTime = 0;
+    //Raw readings are calibrated once a batch is queued or with the report
+    bool calibrationDue = false;
     int numPktsRcvd = 0;
     int numGoodPktsRcvd = 0;
 	int checkUSB = 0;
@@ -385,6 +454,18 @@ int main(int ac, char** arg_vector) {
                   sd.valid = true;
 		  signed_buf[1] = (unsigned char)signed_buf[1];
 
+		  //Publish binary state changes before anything else is done with the packet
+		  std::vector<pip_sense::SenseReading> samples = pip_sense::decodeSenseSamples(sd.sense_data);
+		  pip_sense::SenseReading reading = samples.empty() ? pip_sense::SenseReading() : samples.back();
+		  if (pkt->crcok and reading.valid and reading.has(pip_sense::temp7_binary) and
+		      binary_detector.observe(netID, reading.binary)) {
+		    if (alerts) {
+		      alerts->publish(unix_time, netID, baseID, sd.rss, reading.binary);
+		    }
+		    printf("TS:%'lld\tRX:%ld\tTX:%05d\tALERT binary: %d\n", unix_time, baseID, netID, reading.binary);
+		    fflush(stdout);
+		  }
+
 
 		//printf("Dropped:%u\tBrd ID:%d\tTagID:%d\t\tDatLen:%d\tRSSI:%.2f\tData[0]:%lx\n",pkt->dropped,baseID,netID,(int)signed_buf[0],sd.rss,pkt->data[0]);
 		printf("TS:%'lld\tDrop:%u\tRX:%ld\tTX:%05d\tRSSI:%.2f\t%s\tData:",unix_time,pkt->dropped,baseID,netID,sd.rss,pkt->crcok ? "    CRC":"BAD CRC");
@@ -413,13 +494,62 @@ int main(int ac, char** arg_vector) {
 		
 		//if (netID == 3377)
 		  //sendPost(hostNport, unix_time, ids, sd.rss, data );
+
+		if (localizer and pkt->crcok) {
+		  localizer->add(netID, baseID, unix_time, sd.rss);
+		}
+
+		//Roll up the reading and use any history it carries to fill gaps,
+		//once for all the readers that heard it
+		bool first_copy = pkt->crcok and merge.firstCopy(netID, unix_time, sd.sense_data);
+		if (pkt->crcok and not first_copy) {
+		  printf(" duplicate");
+		}
+		if (first_copy and reading.valid) {
+		  //Older samples of a batch, at the time they were taken
+		  for (size_t i = 0; i + 1 < samples.size(); ++i) {
+		    calibration.add(netID, unix_time - samples[i].age_ms, samples[i]);
+		    history.addLive(netID, unix_time - samples[i].age_ms, samples[i]);
+		  }
+		  if (1 < samples.size()) {
+		    printf(" batch: %zu samples", samples.size());
+		  }
+		  calibration.add(netID, unix_time - reading.age_ms, reading);
+		  history.addLive(netID, unix_time - reading.age_ms, reading);
+		  if (reading.has(pip_sense::change_report)) {
+		    printf(" change");
+		  }
+		  if (reading.has(pip_sense::low_power)) {
+		    printf(" low power");
+		  }
+		  if (reading.has(pip_sense::battery)) {
+		    fleet.addBattery(netID, unix_time, reading.battery_mv, reading.used_joules);
+		    printf(" battery: %umV %uJ", reading.battery_mv, reading.used_joules);
+		  }
+		  if (reading.has(pip_sense::vivaristat_history)) {
+		    int64_t filled = history.addHistory(netID, unix_time, reading.history_slot, reading.history);
+		    if (0 <= filled) {
+		      printf(" history: filled %lldh ago", (long long)(unix_time / pip_sense::ms_per_hour - filled));
+		    }
+		  }
+		}
 		printf("\n");
 
 		if(unix_time - lastReportTime > 10000){
 			printf("#### Received %03d packets in %03llu seconds. (%4.2f%% OK) ####\n",numPktsRcvd,(unix_time-lastReportTime)/1000,((float)numGoodPktsRcvd/numPktsRcvd)*100);
+			if (1 < merge.channels()) {
+				std::vector<unsigned long> counts = merge.takeChannelCounts();
+				for (size_t channel = 0; channel < counts.size(); ++channel) {
+					printf("#### Channel %zu: %lu packets ####\n", channel, counts[channel]);
+				}
+			}
+			for (auto& low : fleet.leastRemaining(5)) {
+				printf("#### TX:%05u battery life left: %.1f days ####\n", low.first, low.second);
+			}
 			numPktsRcvd = 0;
 			numGoodPktsRcvd = 0;
 		   lastReportTime = unix_time;
+			calibrationDue = true;
 		}
 /*
 printf("Raw packet is ");
@@ -439,6 +569,33 @@ printf("\n");
             }
           }
         }
+        //Calibrate the raw readings collected from all of the readers
+        if (calibrationDue or pip_calibration::flush_size <= calibration.pending()) {
+          calibrationDue = false;
+          for (const pip_calibration::CalibratedReading& cal : calibration.flush()) {
+            printf("TS:%'lld\tTX:%05d\tcalibrated:", (long long)cal.rx_timestamp, cal.tx_id);
+            if (cal.has_temperature) {
+              printf(" temp: %.2f", cal.temperature);
+            }
+            if (cal.has_moisture) {
+              printf(" moisture: %.1f", cal.moisture);
+            }
+            printf("\n");
+          }
+        }
+        //Locate the tags whose transmissions have been heard by every reader in range
+        if (localizer) {
+          timeval tval;
+          gettimeofday(&tval, NULL);
+          long long int now = tval.tv_sec*1000 + tval.tv_usec/1000;
+          for (const DevicePosition& position : localizer->solveReady(now)) {
+            if (position.valid) {
+              printf("TS:%'lld\tTX:%05llu\tposition: %.2f %.2f %.2f %s\n", now,
+                  (unsigned long long)position.device_id.lower, position.x, position.y, position.z,
+                  std::string(position.region_uri.begin(), position.region_uri.end()).c_str());
+            }
+          }
+        }
         //Clear dead connections
         pip_devs.remove(NULL);
       }
@@ -0,0 +1,74 @@
+/*******************************************************************************
+ * Merging of the readers of a site.
+ *
+ * A site can split its tags over several radio channels (NUM_CHANNELS in
+ * PIPtagCode/settings.h), each heard by its own readers, and neighbouring
+ * readers on one channel hear the same packets. A packet carries the ID of
+ * its tag whatever channel it was sent on, so the readers are merged by
+ * keeping the first copy of every packet, wherever it was heard, for the
+ * rollups, calibration and battery tracking. The localizer still gets every
+ * copy, it needs the RSS at each reader.
+ *
+ * A copy is a packet from the same tag with the same sensed data read within
+ * duplicate_window_ms of the first one. The repeats of a binary burst are at
+ * least SENSE_REPEAT_INTVL_0 (125 ms) apart and are kept.
+ *
+ * Tags that were not optically programmed with a channel use their ID modulo
+ * the number of channels, which gives the packet counts per channel.
+ ******************************************************************************/
+#ifndef __READER_MERGE_HPP__
+#define __READER_MERGE_HPP__
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace pip_sense {
+  const int64_t duplicate_window_ms = 100;
+
+  class ReaderMerge {
+    private:
+      struct LastPacket {
+        int64_t rx_timestamp;
+        std::vector<unsigned char> data;
+      };
+      std::unordered_map<uint32_t, LastPacket> last;
+      unsigned int num_channels;
+      //First copies per channel since the last takeChannelCounts()
+      std::vector<unsigned long> channel_counts;
+    public:
+      ReaderMerge(unsigned int num_channels = 1) :
+        num_channels(0 < num_channels ? num_channels : 1),
+        channel_counts(this->num_channels, 0) {}
+
+      unsigned int channels() const { return num_channels; }
+
+      //Channel of a tag that derives it from its ID
+      unsigned int channelOf(uint32_t tx_id) const { return tx_id % num_channels; }
+
+      /*
+       * Returns true if this is the first copy of the packet, false if
+       * another reader already delivered it.
+       */
+      bool firstCopy(uint32_t tx_id, int64_t rx_timestamp, const std::vector<unsigned char>& data) {
+        auto found = last.find(tx_id);
+        if (found != last.end() and
+            rx_timestamp - found->second.rx_timestamp < duplicate_window_ms and
+            found->second.data == data) {
+          return false;
+        }
+        last[tx_id] = LastPacket{rx_timestamp, data};
+        ++channel_counts[channelOf(tx_id)];
+        return true;
+      }
+
+      //Packets per channel since the last call
+      std::vector<unsigned long> takeChannelCounts() {
+        std::vector<unsigned long> counts(num_channels, 0);
+        counts.swap(channel_counts);
+        return counts;
+      }
+  };
+}
+
+#endif